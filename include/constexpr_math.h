@@ -0,0 +1,97 @@
+#ifndef CONSTEXPR_MATH_H_
+#define CONSTEXPR_MATH_H_
+
+#include <limits>
+
+// sqrtf, sinf, cosf and tanf usable in constant expressions, so fixed matrices can be built by the compiler.
+// They work in double and round once. sqrt is correctly rounded like sqrtf. The trig functions are meant for
+// angles within a few turns of zero, there they round correctly where libm's float versions are sometimes an ulp off.
+
+// Newton from above in double, it stops when the next step no longer decreases
+inline constexpr float constexprSqrt(float x)
+{
+	if (x != x || x < 0.0f) return std::numeric_limits<float>::quiet_NaN();
+	if (x == 0.0f || x == std::numeric_limits<float>::infinity()) return x;
+
+	double value = x;
+	double root = value > 1.0 ? value : 1.0;
+	for (int i = 0; i < 256; ++i)
+	{
+		double next = 0.5*(root + value/root);
+		if (next >= root) break;
+		root = next;
+	}
+	return static_cast<float>(root);
+}
+
+// Taylor series on [-pi/4, pi/4] after reducing by quarter turns, pi/2 is split so the reduction keeps its precision
+inline constexpr void constexprSinCos(double x, double& s, double& c)
+{
+	const double halfPiHigh = 1.5707963267341256;
+	const double halfPiLow = 6.077100506506192e-11;
+	const double quarters = x*0.63661977236758134;
+	long long k = static_cast<long long>(quarters >= 0.0 ? quarters + 0.5 : quarters - 0.5);
+	double r = (x - k*halfPiHigh) - k*halfPiLow;
+
+	double r2 = r*r;
+	double sinR = 0.0;
+	double cosR = 0.0;
+	double sinTerm = r;
+	double cosTerm = 1.0;
+	for (int n = 1; n < 12; ++n)
+	{
+		sinR += sinTerm;
+		cosR += cosTerm;
+		sinTerm *= -r2 / ((2*n)*(2*n + 1));
+		cosTerm *= -r2 / ((2*n - 1)*(2*n));
+	}
+
+	switch (k & 3)
+	{
+	case 0: s = sinR; c = cosR; break;
+	case 1: s = cosR; c = -sinR; break;
+	case 2: s = -sinR; c = -cosR; break;
+	default: s = -cosR; c = sinR; break;
+	}
+}
+
+inline constexpr float constexprSin(float x)
+{
+	double s = 0.0;
+	double c = 0.0;
+	constexprSinCos(x, s, c);
+	return static_cast<float>(s);
+}
+
+inline constexpr float constexprCos(float x)
+{
+	double s = 0.0;
+	double c = 0.0;
+	constexprSinCos(x, s, c);
+	return static_cast<float>(c);
+}
+
+inline constexpr float constexprTan(float x)
+{
+	double s = 0.0;
+	double c = 0.0;
+	constexprSinCos(x, s, c);
+	return static_cast<float>(s / c);
+}
+
+// Compile-time checks against the correctly rounded results
+static_assert(constexprSqrt(4.0f) == 2.0f, "constexprSqrt");
+static_assert(constexprSqrt(2.0f) == 1.41421354f, "constexprSqrt");
+static_assert(constexprSqrt(0.5f) == 0.707106769f, "constexprSqrt");
+static_assert(constexprSqrt(12345.6777f) == 111.111107f, "constexprSqrt");
+static_assert(constexprSqrt(1e-30f) == 1.00000000e-15f, "constexprSqrt");
+static_assert(constexprSin(0.5f) == 0.47942555f, "constexprSin");
+static_assert(constexprSin(-2.0f) == -0.909297407f, "constexprSin");
+static_assert(constexprSin(10.0f) == -0.544021130f, "constexprSin");
+static_assert(constexprCos(1.0f) == 0.540302277f, "constexprCos");
+static_assert(constexprCos(3.0f) == -0.989992499f, "constexprCos");
+static_assert(constexprTan(0.1f) == 0.100334674f, "constexprTan");
+static_assert(constexprTan(-2.0f) == 2.18503976f, "constexprTan");
+static_assert(constexprTan(0.785398185f) == 1.0f, "constexprTan");
+
+#endif // CONSTEXPR_MATH_H_
@@ -0,0 +1,124 @@
+#ifndef FLOAT8_H_
+#define FLOAT8_H_
+
+// Eight floats processed together, the lane type of vec3x8.
+// AVX keeps them in one register, SSE and AArch64 NEON in two halves, anything else in a plain array.
+// Define FLOAT8_NO_SIMD to force the scalar code.
+#if !defined(FLOAT8_NO_SIMD)
+#if defined(__AVX__)
+#define FLOAT8_AVX 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FLOAT8_SSE 1
+#elif (defined(__ARM_NEON) && defined(__aarch64__)) || defined(_M_ARM64)
+#define FLOAT8_NEON 1
+#endif
+#endif
+
+#include <stdint.h>
+
+#if defined(FLOAT8_AVX) || defined(FLOAT8_SSE)
+#include <immintrin.h>
+#elif defined(FLOAT8_NEON)
+#include <arm_neon.h>
+#endif
+
+// Per lane true/false, produced by comparisons and consumed by select() and the masked stores
+struct mask8
+{
+#if defined(FLOAT8_AVX)
+	__m256 v;
+#elif defined(FLOAT8_SSE)
+	__m128 lo, hi;
+#elif defined(FLOAT8_NEON)
+	uint32x4_t lo, hi;
+#else
+	uint32_t v[8];
+#endif
+
+	// -- Implicit basic constructors --
+	mask8() = default;
+	mask8(mask8 const& m) = default;
+
+	// -- Explicit basic constructors --
+	explicit mask8(bool b);
+
+	// Lanes below count set, the lanes a partial load filled
+	static mask8 first(int count);
+
+	// Lane i in bit i
+	int bits() const;
+	bool any() const;
+	bool all() const;
+	bool none() const;
+	bool operator[](int i) const;
+};
+
+struct alignas(32) float8
+{
+#if defined(FLOAT8_AVX)
+	__m256 v;
+#elif defined(FLOAT8_SSE)
+	__m128 lo, hi;
+#elif defined(FLOAT8_NEON)
+	float32x4_t lo, hi;
+#else
+	float v[8];
+#endif
+
+	// -- Implicit basic constructors --
+	float8() = default;
+	float8(float8 const& f) = default;
+
+	// -- Explicit basic constructors --
+	explicit float8(float s);
+	float8(float a, float b, float c, float d, float e, float f, float g, float h);
+
+	// p needs no particular alignment, the partial forms touch only count floats and zero the other lanes.
+	// Those zeros take part in hmin() and hmax(), reduce a partial load with the mask8::first(count) overloads.
+	static float8 load(const float* p);
+	static float8 load(const float* p, int count);
+	void store(float* p) const;
+	void store(float* p, int count) const;
+	void store(float* p, mask8 const& m) const;
+
+	float operator[](int i) const;
+};
+
+float8 operator-(float8 const& f);
+float8 operator+(float8 const& lhs, float8 const& rhs);
+float8 operator-(float8 const& lhs, float8 const& rhs);
+float8 operator*(float8 const& lhs, float8 const& rhs);
+float8 operator/(float8 const& lhs, float8 const& rhs);
+
+mask8 operator<(float8 const& lhs, float8 const& rhs);
+mask8 operator<=(float8 const& lhs, float8 const& rhs);
+mask8 operator>(float8 const& lhs, float8 const& rhs);
+mask8 operator>=(float8 const& lhs, float8 const& rhs);
+mask8 operator==(float8 const& lhs, float8 const& rhs);
+mask8 operator!=(float8 const& lhs, float8 const& rhs);
+
+mask8 operator&(mask8 const& lhs, mask8 const& rhs);
+mask8 operator|(mask8 const& lhs, mask8 const& rhs);
+mask8 operator^(mask8 const& lhs, mask8 const& rhs);
+mask8 operator~(mask8 const& m);
+
+float8 min(float8 const& lhs, float8 const& rhs);
+float8 max(float8 const& lhs, float8 const& rhs);
+float8 abs(float8 const& f);
+float8 sqrt(float8 const& f);
+// 1/sqrt(f) from the hardware estimate and one Newton step, about 22 bits instead of the 24 of a division
+float8 rsqrt(float8 const& f);
+// Lanes of a where m is set, of b elsewhere
+float8 select(mask8 const& m, float8 const& a, float8 const& b);
+
+float hsum(float8 const& f);
+float hmin(float8 const& f);
+float hmax(float8 const& f);
+// Over the lanes of m only, an empty mask gives 0, +inf and -inf
+float hsum(float8 const& f, mask8 const& m);
+float hmin(float8 const& f, mask8 const& m);
+float hmax(float8 const& f, mask8 const& m);
+
+#include "float8.inl"
+
+#endif // FLOAT8_H_
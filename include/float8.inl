@@ -0,0 +1,546 @@
+#include "float8.h"
+
+#include <math.h>
+#include <string.h>
+
+inline mask8::mask8(bool b)
+{
+#if defined(FLOAT8_AVX)
+	v = _mm256_castsi256_ps(_mm256_set1_epi32(b ? -1 : 0));
+#elif defined(FLOAT8_SSE)
+	lo = hi = _mm_castsi128_ps(_mm_set1_epi32(b ? -1 : 0));
+#elif defined(FLOAT8_NEON)
+	lo = hi = vdupq_n_u32(b ? 0xffffffffu : 0u);
+#else
+	for (int i = 0; i < 8; ++i) v[i] = b ? 0xffffffffu : 0u;
+#endif
+}
+
+inline int mask8::bits() const
+{
+#if defined(FLOAT8_AVX)
+	return _mm256_movemask_ps(v);
+#elif defined(FLOAT8_SSE)
+	return _mm_movemask_ps(lo) | (_mm_movemask_ps(hi) << 4);
+#elif defined(FLOAT8_NEON)
+	static const uint32_t lanes[4] = { 1, 2, 4, 8 };
+	uint32x4_t weights = vld1q_u32(lanes);
+	return (int)(vaddvq_u32(vandq_u32(lo, weights)) | (vaddvq_u32(vandq_u32(hi, weights)) << 4));
+#else
+	int result = 0;
+	for (int i = 0; i < 8; ++i) result |= (v[i] != 0) << i;
+	return result;
+#endif
+}
+
+inline bool mask8::any() const
+{
+	return bits() != 0;
+}
+
+inline bool mask8::all() const
+{
+	return bits() == 0xff;
+}
+
+inline bool mask8::none() const
+{
+	return bits() == 0;
+}
+
+inline bool mask8::operator[](int i) const
+{
+	return (bits() >> i) & 1;
+}
+
+inline float8::float8(float s)
+{
+#if defined(FLOAT8_AVX)
+	v = _mm256_set1_ps(s);
+#elif defined(FLOAT8_SSE)
+	lo = hi = _mm_set1_ps(s);
+#elif defined(FLOAT8_NEON)
+	lo = hi = vdupq_n_f32(s);
+#else
+	for (int i = 0; i < 8; ++i) v[i] = s;
+#endif
+}
+
+inline float8::float8(float a, float b, float c, float d, float e, float f, float g, float h)
+{
+	const float values[8] = { a, b, c, d, e, f, g, h };
+	*this = load(values);
+}
+
+inline float8 float8::load(const float* p)
+{
+	float8 result;
+#if defined(FLOAT8_AVX)
+	result.v = _mm256_loadu_ps(p);
+#elif defined(FLOAT8_SSE)
+	result.lo = _mm_loadu_ps(p);
+	result.hi = _mm_loadu_ps(p + 4);
+#elif defined(FLOAT8_NEON)
+	result.lo = vld1q_f32(p);
+	result.hi = vld1q_f32(p + 4);
+#else
+	for (int i = 0; i < 8; ++i) result.v[i] = p[i];
+#endif
+	return result;
+}
+
+inline float8 float8::load(const float* p, int count)
+{
+	alignas(32) float values[8] = {};
+	memcpy(values, p, count*sizeof(float));
+	return load(values);
+}
+
+inline void float8::store(float* p) const
+{
+#if defined(FLOAT8_AVX)
+	_mm256_storeu_ps(p, v);
+#elif defined(FLOAT8_SSE)
+	_mm_storeu_ps(p, lo);
+	_mm_storeu_ps(p + 4, hi);
+#elif defined(FLOAT8_NEON)
+	vst1q_f32(p, lo);
+	vst1q_f32(p + 4, hi);
+#else
+	for (int i = 0; i < 8; ++i) p[i] = v[i];
+#endif
+}
+
+inline void float8::store(float* p, int count) const
+{
+	alignas(32) float values[8];
+	store(values);
+	memcpy(p, values, count*sizeof(float));
+}
+
+inline void float8::store(float* p, mask8 const& m) const
+{
+#if defined(FLOAT8_AVX)
+	_mm256_maskstore_ps(p, _mm256_castps_si256(m.v), v);
+#else
+	alignas(32) float values[8];
+	store(values);
+	int bits = m.bits();
+	for (int i = 0; i < 8; ++i)
+	{
+		if (bits & (1 << i)) p[i] = values[i];
+	}
+#endif
+}
+
+inline float float8::operator[](int i) const
+{
+	alignas(32) float values[8];
+	store(values);
+	return values[i];
+}
+
+inline float8 operator-(float8 const& f)
+{
+	float8 result;
+#if defined(FLOAT8_AVX)
+	result.v = _mm256_xor_ps(f.v, _mm256_set1_ps(-0.0f));
+#elif defined(FLOAT8_SSE)
+	result.lo = _mm_xor_ps(f.lo, _mm_set1_ps(-0.0f));
+	result.hi = _mm_xor_ps(f.hi, _mm_set1_ps(-0.0f));
+#elif defined(FLOAT8_NEON)
+	result.lo = vnegq_f32(f.lo);
+	result.hi = vnegq_f32(f.hi);
+#else
+	for (int i = 0; i < 8; ++i) result.v[i] = -f.v[i];
+#endif
+	return result;
+}
+
+inline float8 operator+(float8 const& lhs, float8 const& rhs)
+{
+	float8 result;
+#if defined(FLOAT8_AVX)
+	result.v = _mm256_add_ps(lhs.v, rhs.v);
+#elif defined(FLOAT8_SSE)
+	result.lo = _mm_add_ps(lhs.lo, rhs.lo);
+	result.hi = _mm_add_ps(lhs.hi, rhs.hi);
+#elif defined(FLOAT8_NEON)
+	result.lo = vaddq_f32(lhs.lo, rhs.lo);
+	result.hi = vaddq_f32(lhs.hi, rhs.hi);
+#else
+	for (int i = 0; i < 8; ++i) result.v[i] = lhs.v[i] + rhs.v[i];
+#endif
+	return result;
+}
+
+inline float8 operator-(float8 const& lhs, float8 const& rhs)
+{
+	float8 result;
+#if defined(FLOAT8_AVX)
+	result.v = _mm256_sub_ps(lhs.v, rhs.v);
+#elif defined(FLOAT8_SSE)
+	result.lo = _mm_sub_ps(lhs.lo, rhs.lo);
+	result.hi = _mm_sub_ps(lhs.hi, rhs.hi);
+#elif defined(FLOAT8_NEON)
+	result.lo = vsubq_f32(lhs.lo, rhs.lo);
+	result.hi = vsubq_f32(lhs.hi, rhs.hi);
+#else
+	for (int i = 0; i < 8; ++i) result.v[i] = lhs.v[i] - rhs.v[i];
+#endif
+	return result;
+}
+
+inline float8 operator*(float8 const& lhs, float8 const& rhs)
+{
+	float8 result;
+#if defined(FLOAT8_AVX)
+	result.v = _mm256_mul_ps(lhs.v, rhs.v);
+#elif defined(FLOAT8_SSE)
+	result.lo = _mm_mul_ps(lhs.lo, rhs.lo);
+	result.hi = _mm_mul_ps(lhs.hi, rhs.hi);
+#elif defined(FLOAT8_NEON)
+	result.lo = vmulq_f32(lhs.lo, rhs.lo);
+	result.hi = vmulq_f32(lhs.hi, rhs.hi);
+#else
+	for (int i = 0; i < 8; ++i) result.v[i] = lhs.v[i] * rhs.v[i];
+#endif
+	return result;
+}
+
+inline float8 operator/(float8 const& lhs, float8 const& rhs)
+{
+	float8 result;
+#if defined(FLOAT8_AVX)
+	result.v = _mm256_div_ps(lhs.v, rhs.v);
+#elif defined(FLOAT8_SSE)
+	result.lo = _mm_div_ps(lhs.lo, rhs.lo);
+	result.hi = _mm_div_ps(lhs.hi, rhs.hi);
+#elif defined(FLOAT8_NEON)
+	result.lo = vdivq_f32(lhs.lo, rhs.lo);
+	result.hi = vdivq_f32(lhs.hi, rhs.hi);
+#else
+	for (int i = 0; i < 8; ++i) result.v[i] = lhs.v[i] / rhs.v[i];
+#endif
+	return result;
+}
+
+#if defined(FLOAT8_AVX)
+#define FLOAT8_COMPARE(avx, sse, neon, op) \
+	mask8 result; \
+	result.v = _mm256_cmp_ps(lhs.v, rhs.v, avx); \
+	return result;
+#elif defined(FLOAT8_SSE)
+#define FLOAT8_COMPARE(avx, sse, neon, op) \
+	mask8 result; \
+	result.lo = sse(lhs.lo, rhs.lo); \
+	result.hi = sse(lhs.hi, rhs.hi); \
+	return result;
+#elif defined(FLOAT8_NEON)
+#define FLOAT8_COMPARE(avx, sse, neon, op) \
+	mask8 result; \
+	result.lo = neon(lhs.lo, rhs.lo); \
+	result.hi = neon(lhs.hi, rhs.hi); \
+	return result;
+#else
+#define FLOAT8_COMPARE(avx, sse, neon, op) \
+	mask8 result; \
+	for (int i = 0; i < 8; ++i) result.v[i] = lhs.v[i] op rhs.v[i] ? 0xffffffffu : 0u; \
+	return result;
+#endif
+
+inline mask8 operator<(float8 const& lhs, float8 const& rhs)
+{
+	FLOAT8_COMPARE(_CMP_LT_OQ, _mm_cmplt_ps, vcltq_f32, <)
+}
+
+inline mask8 operator<=(float8 const& lhs, float8 const& rhs)
+{
+	FLOAT8_COMPARE(_CMP_LE_OQ, _mm_cmple_ps, vcleq_f32, <=)
+}
+
+inline mask8 operator>(float8 const& lhs, float8 const& rhs)
+{
+	FLOAT8_COMPARE(_CMP_GT_OQ, _mm_cmpgt_ps, vcgtq_f32, >)
+}
+
+inline mask8 operator>=(float8 const& lhs, float8 const& rhs)
+{
+	FLOAT8_COMPARE(_CMP_GE_OQ, _mm_cmpge_ps, vcgeq_f32, >=)
+}
+
+inline mask8 operator==(float8 const& lhs, float8 const& rhs)
+{
+	FLOAT8_COMPARE(_CMP_EQ_OQ, _mm_cmpeq_ps, vceqq_f32, ==)
+}
+
+inline mask8 operator!=(float8 const& lhs, float8 const& rhs)
+{
+	// NEON only compares for equality, negating it keeps NaN lanes true as with the scalar !=
+#if defined(FLOAT8_NEON)
+	return ~(lhs == rhs);
+#else
+	FLOAT8_COMPARE(_CMP_NEQ_UQ, _mm_cmpneq_ps, vceqq_f32, !=)
+#endif
+}
+
+#undef FLOAT8_COMPARE
+
+inline mask8 operator&(mask8 const& lhs, mask8 const& rhs)
+{
+	mask8 result;
+#if defined(FLOAT8_AVX)
+	result.v = _mm256_and_ps(lhs.v, rhs.v);
+#elif defined(FLOAT8_SSE)
+	result.lo = _mm_and_ps(lhs.lo, rhs.lo);
+	result.hi = _mm_and_ps(lhs.hi, rhs.hi);
+#elif defined(FLOAT8_NEON)
+	result.lo = vandq_u32(lhs.lo, rhs.lo);
+	result.hi = vandq_u32(lhs.hi, rhs.hi);
+#else
+	for (int i = 0; i < 8; ++i) result.v[i] = lhs.v[i] & rhs.v[i];
+#endif
+	return result;
+}
+
+inline mask8 operator|(mask8 const& lhs, mask8 const& rhs)
+{
+	mask8 result;
+#if defined(FLOAT8_AVX)
+	result.v = _mm256_or_ps(lhs.v, rhs.v);
+#elif defined(FLOAT8_SSE)
+	result.lo = _mm_or_ps(lhs.lo, rhs.lo);
+	result.hi = _mm_or_ps(lhs.hi, rhs.hi);
+#elif defined(FLOAT8_NEON)
+	result.lo = vorrq_u32(lhs.lo, rhs.lo);
+	result.hi = vorrq_u32(lhs.hi, rhs.hi);
+#else
+	for (int i = 0; i < 8; ++i) result.v[i] = lhs.v[i] | rhs.v[i];
+#endif
+	return result;
+}
+
+inline mask8 operator^(mask8 const& lhs, mask8 const& rhs)
+{
+	mask8 result;
+#if defined(FLOAT8_AVX)
+	result.v = _mm256_xor_ps(lhs.v, rhs.v);
+#elif defined(FLOAT8_SSE)
+	result.lo = _mm_xor_ps(lhs.lo, rhs.lo);
+	result.hi = _mm_xor_ps(lhs.hi, rhs.hi);
+#elif defined(FLOAT8_NEON)
+	result.lo = veorq_u32(lhs.lo, rhs.lo);
+	result.hi = veorq_u32(lhs.hi, rhs.hi);
+#else
+	for (int i = 0; i < 8; ++i) result.v[i] = lhs.v[i] ^ rhs.v[i];
+#endif
+	return result;
+}
+
+inline mask8 operator~(mask8 const& m)
+{
+	return m ^ mask8(true);
+}
+
+inline float8 min(float8 const& lhs, float8 const& rhs)
+{
+	float8 result;
+#if defined(FLOAT8_AVX)
+	result.v = _mm256_min_ps(lhs.v, rhs.v);
+#elif defined(FLOAT8_SSE)
+	result.lo = _mm_min_ps(lhs.lo, rhs.lo);
+	result.hi = _mm_min_ps(lhs.hi, rhs.hi);
+#elif defined(FLOAT8_NEON)
+	result.lo = vminq_f32(lhs.lo, rhs.lo);
+	result.hi = vminq_f32(lhs.hi, rhs.hi);
+#else
+	for (int i = 0; i < 8; ++i) result.v[i] = lhs.v[i] < rhs.v[i] ? lhs.v[i] : rhs.v[i];
+#endif
+	return result;
+}
+
+inline float8 max(float8 const& lhs, float8 const& rhs)
+{
+	float8 result;
+#if defined(FLOAT8_AVX)
+	result.v = _mm256_max_ps(lhs.v, rhs.v);
+#elif defined(FLOAT8_SSE)
+	result.lo = _mm_max_ps(lhs.lo, rhs.lo);
+	result.hi = _mm_max_ps(lhs.hi, rhs.hi);
+#elif defined(FLOAT8_NEON)
+	result.lo = vmaxq_f32(lhs.lo, rhs.lo);
+	result.hi = vmaxq_f32(lhs.hi, rhs.hi);
+#else
+	for (int i = 0; i < 8; ++i) result.v[i] = lhs.v[i] > rhs.v[i] ? lhs.v[i] : rhs.v[i];
+#endif
+	return result;
+}
+
+inline float8 abs(float8 const& f)
+{
+	float8 result;
+#if defined(FLOAT8_AVX)
+	result.v = _mm256_andnot_ps(_mm256_set1_ps(-0.0f), f.v);
+#elif defined(FLOAT8_SSE)
+	result.lo = _mm_andnot_ps(_mm_set1_ps(-0.0f), f.lo);
+	result.hi = _mm_andnot_ps(_mm_set1_ps(-0.0f), f.hi);
+#elif defined(FLOAT8_NEON)
+	result.lo = vabsq_f32(f.lo);
+	result.hi = vabsq_f32(f.hi);
+#else
+	for (int i = 0; i < 8; ++i) result.v[i] = fabsf(f.v[i]);
+#endif
+	return result;
+}
+
+inline float8 sqrt(float8 const& f)
+{
+	float8 result;
+#if defined(FLOAT8_AVX)
+	result.v = _mm256_sqrt_ps(f.v);
+#elif defined(FLOAT8_SSE)
+	result.lo = _mm_sqrt_ps(f.lo);
+	result.hi = _mm_sqrt_ps(f.hi);
+#elif defined(FLOAT8_NEON)
+	result.lo = vsqrtq_f32(f.lo);
+	result.hi = vsqrtq_f32(f.hi);
+#else
+	for (int i = 0; i < 8; ++i) result.v[i] = sqrtf(f.v[i]);
+#endif
+	return result;
+}
+
+inline float8 rsqrt(float8 const& f)
+{
+#if defined(FLOAT8_AVX) || defined(FLOAT8_SSE)
+	float8 y;
+#if defined(FLOAT8_AVX)
+	y.v = _mm256_rsqrt_ps(f.v);
+#else
+	y.lo = _mm_rsqrt_ps(f.lo);
+	y.hi = _mm_rsqrt_ps(f.hi);
+#endif
+	// y*(1.5 - 0.5*f*y*y)
+	return y*(float8(1.5f) - float8(0.5f)*f*y*y);
+#elif defined(FLOAT8_NEON)
+	float8 result;
+	float32x4_t lo = vrsqrteq_f32(f.lo);
+	float32x4_t hi = vrsqrteq_f32(f.hi);
+	result.lo = vmulq_f32(lo, vrsqrtsq_f32(vmulq_f32(f.lo, lo), lo));
+	result.hi = vmulq_f32(hi, vrsqrtsq_f32(vmulq_f32(f.hi, hi), hi));
+	return result;
+#else
+	float8 result;
+	for (int i = 0; i < 8; ++i) result.v[i] = 1.0f / sqrtf(f.v[i]);
+	return result;
+#endif
+}
+
+inline float8 select(mask8 const& m, float8 const& a, float8 const& b)
+{
+	float8 result;
+#if defined(FLOAT8_AVX)
+	result.v = _mm256_blendv_ps(b.v, a.v, m.v);
+#elif defined(FLOAT8_SSE)
+	result.lo = _mm_or_ps(_mm_and_ps(m.lo, a.lo), _mm_andnot_ps(m.lo, b.lo));
+	result.hi = _mm_or_ps(_mm_and_ps(m.hi, a.hi), _mm_andnot_ps(m.hi, b.hi));
+#elif defined(FLOAT8_NEON)
+	result.lo = vbslq_f32(m.lo, a.lo, b.lo);
+	result.hi = vbslq_f32(m.hi, a.hi, b.hi);
+#else
+	for (int i = 0; i < 8; ++i) result.v[i] = m.v[i] ? a.v[i] : b.v[i];
+#endif
+	return result;
+}
+
+#if defined(FLOAT8_AVX) || defined(FLOAT8_SSE)
+// Folds the upper four lanes onto the lower four, then two onto two and one onto one
+#define FLOAT8_REDUCE(op) \
+	__m128 r = op(lo, hi); \
+	r = op(r, _mm_movehl_ps(r, r)); \
+	return _mm_cvtss_f32(op(r, _mm_shuffle_ps(r, r, 1)));
+
+inline float hsum(float8 const& f)
+{
+#if defined(FLOAT8_AVX)
+	__m128 lo = _mm256_castps256_ps128(f.v);
+	__m128 hi = _mm256_extractf128_ps(f.v, 1);
+#else
+	__m128 lo = f.lo;
+	__m128 hi = f.hi;
+#endif
+	FLOAT8_REDUCE(_mm_add_ps)
+}
+
+inline float hmin(float8 const& f)
+{
+#if defined(FLOAT8_AVX)
+	__m128 lo = _mm256_castps256_ps128(f.v);
+	__m128 hi = _mm256_extractf128_ps(f.v, 1);
+#else
+	__m128 lo = f.lo;
+	__m128 hi = f.hi;
+#endif
+	FLOAT8_REDUCE(_mm_min_ps)
+}
+
+inline float hmax(float8 const& f)
+{
+#if defined(FLOAT8_AVX)
+	__m128 lo = _mm256_castps256_ps128(f.v);
+	__m128 hi = _mm256_extractf128_ps(f.v, 1);
+#else
+	__m128 lo = f.lo;
+	__m128 hi = f.hi;
+#endif
+	FLOAT8_REDUCE(_mm_max_ps)
+}
+
+#undef FLOAT8_REDUCE
+#else
+// Same pairing as the SIMD reductions: lane i with i + 4, then i + 2, then i + 1
+inline float hsum(float8 const& f)
+{
+	alignas(32) float v[8];
+	f.store(v);
+	return ((v[0] + v[4]) + (v[2] + v[6])) + ((v[1] + v[5]) + (v[3] + v[7]));
+}
+
+inline float hmin(float8 const& f)
+{
+	alignas(32) float v[8];
+	f.store(v);
+	float result = v[0];
+	for (int i = 1; i < 8; ++i) result = v[i] < result ? v[i] : result;
+	return result;
+}
+
+inline float hmax(float8 const& f)
+{
+	alignas(32) float v[8];
+	f.store(v);
+	float result = v[0];
+	for (int i = 1; i < 8; ++i) result = v[i] > result ? v[i] : result;
+	return result;
+}
+#endif
+
+inline mask8 mask8::first(int count)
+{
+	return float8(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f) < float8((float)count);
+}
+
+inline float hsum(float8 const& f, mask8 const& m)
+{
+	return hsum(select(m, f, float8(0.0f)));
+}
+
+inline float hmin(float8 const& f, mask8 const& m)
+{
+	return hmin(select(m, f, float8(INFINITY)));
+}
+
+inline float hmax(float8 const& f, mask8 const& m)
+{
+	return hmax(select(m, f, float8(-INFINITY)));
+}
@@ -1,27 +1,84 @@
 #ifndef MAT4_H_
 #define MAT4_H_
 
+#include <stddef.h>
+
+#include "vec3.h"
 #include "vec4.h"
+#include "constexpr_math.h"
+
+// Runtime math uses SSE, AVX or NEON when the target has them, define MAT4_NO_SIMD to keep the scalar code.
+// mat4 * mat4 has an AVX kernel only, elsewhere the scalar expressions are as fast once the compiler vectorizes them.
+// mat4 * vec4, transpose and the batched transforms also use NEON, the inverses and normalMatrix
+// only AArch64 NEON, 32-bit ARM keeps the scalar cofactors for them.
+// Constant evaluation always takes the scalar path, so the builtin telling the two apart is required.
+#if defined(__clang__) && defined(__has_builtin)
+#if __has_builtin(__builtin_is_constant_evaluated)
+#define MAT4_CONSTANT_EVALUATED() __builtin_is_constant_evaluated()
+#endif
+#elif (defined(__GNUC__) && __GNUC__ >= 9) || (defined(_MSC_VER) && _MSC_VER >= 1925)
+#define MAT4_CONSTANT_EVALUATED() __builtin_is_constant_evaluated()
+#endif
+
+#if !defined(MAT4_NO_SIMD) && defined(MAT4_CONSTANT_EVALUATED)
+#if defined(__AVX__)
+#define MAT4_SIMD_AVX 1
+#define MAT4_SIMD_SSE 1
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define MAT4_SIMD_SSE 1
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define MAT4_SIMD_NEON 1
+#if defined(__aarch64__) || defined(_M_ARM64)
+#define MAT4_SIMD_NEON64 1 // the inverses need the AArch64 permutes and division
+#endif
+#endif
+#endif
+
+// Builders call sqrtf and the trig functions at runtime and the constexpr_math.h versions in constant expressions.
+// Both give the same bits unless the trig functions differ by an ulp or the compiler fuses multiply-adds at runtime,
+// mat4_benchmark checks it. Compilers without the builtin always take the constexpr versions.
+#if defined(MAT4_CONSTANT_EVALUATED)
+#define MAT4_RUNTIME() (!MAT4_CONSTANT_EVALUATED())
+#else
+#define MAT4_RUNTIME() false
+#endif
 
 struct mat4
 {
 	float m[16];
 
-	static mat4 identity;
+	static const mat4 identity;
 
-	static mat4 translate(float x, float y, float z);
-	static mat4 rotate(float x, float y, float z, float angle);
-	static mat4 scale(float x, float y, float z);
+	static constexpr mat4 translate(float x, float y, float z);
+	static constexpr mat4 rotate(float x, float y, float z, float angle);
+	static constexpr mat4 scale(float x, float y, float z);
 
-	static mat4 lookAt(vec3 pos, vec3 target, vec3 up);
-	static mat4 perspective(float fov, float aspect, float near, float far);
-	static mat4 ortho(float width, float height, float near, float far);
+	static constexpr mat4 lookAt(vec3 pos, vec3 target, vec3 up);
+	static constexpr mat4 perspective(float fov, float aspect, float near, float far);
+	static constexpr mat4 ortho(float width, float height, float near, float far);
 
+	constexpr mat4 transpose() const;
+	// General inverse by cofactors, a singular matrix gives infinities or NaN
+	constexpr mat4 inverse() const;
+	// Rotation, scale and translation only, m[3], m[7] and m[11] must be zero
+	constexpr mat4 inverseAffine() const;
+	// Rotation and translation only, the linear part is transposed instead of inverted
+	constexpr mat4 inverseRigid() const;
+	// Inverse transpose of the linear part with no translation, for normals. Shaders take mat3(normalMatrix)
+	constexpr mat4 normalMatrix() const;
+	// Affine matrix as mat4::scale(scale) * rotation * mat4::translate(translation), a mirroring goes into scale.x.
+	// Shear is not recovered, returns false when an axis has zero length
+	bool decompose(vec3& translation, mat4& rotation, vec3& scale) const;
 };
 
 constexpr mat4 operator*(mat4 const& lhs, mat4 const& rhs);
 constexpr vec4 operator*(mat4 const& lhs, vec4 const& rhs);
 
+// Points with w = 1 and vectors with w = 0, the way a shader transforms them after the column-major upload:
+// x' = m[0]*x + m[4]*y + m[8]*z + m[12]*w and so on, so translate() moves points. in and out may be the same array.
+void transform_points(const mat4& m, const vec3* in, vec3* out, size_t count);
+void transform_vectors(const mat4& m, const vec3* in, vec3* out, size_t count);
+
 #include "mat4.inl"
 
 #endif // MAT4_H_
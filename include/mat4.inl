@@ -4,7 +4,13 @@
 
 #include "vec3.h"
 
-mat4 mat4::identity = mat4
+#if defined(MAT4_SIMD_SSE)
+#include <immintrin.h>
+#elif defined(MAT4_SIMD_NEON)
+#include <arm_neon.h>
+#endif
+
+inline constexpr mat4 mat4::identity = mat4
 {
 	1.0f, 0.0f, 0.0f, 0.0f,
 	0.0f, 1.0f, 0.0f, 0.0f,
@@ -12,7 +18,7 @@ mat4 mat4::identity = mat4
 	0.0f, 0.0f, 0.0f, 1.0f
 };
 
-inline mat4 mat4::translate(float x, float y, float z)
+inline constexpr mat4 mat4::translate(float x, float y, float z)
 {
 	return mat4
 	{
@@ -23,13 +29,13 @@ inline mat4 mat4::translate(float x, float y, float z)
 	};
 }
 
-inline mat4 mat4::rotate(float x, float y, float z, float angle)
+inline constexpr mat4 mat4::rotate(float x, float y, float z, float angle)
 {
-	float s = sinf(angle / 2.0f);
+	float s = MAT4_RUNTIME() ? sinf(angle / 2.0f) : constexprSin(angle / 2.0f);
 	float qx = x * s;
 	float qy = y * s;
 	float qz = z * s;
-	float qw = cosf(angle / 2.0f);
+	float qw = MAT4_RUNTIME() ? cosf(angle / 2.0f) : constexprCos(angle / 2.0f);
 
 	float xx = qx * qx;
 	float xy = qx * qy;
@@ -52,7 +58,7 @@ inline mat4 mat4::rotate(float x, float y, float z, float angle)
 	};
 }
 
-inline mat4 mat4::scale(float x, float y, float z)
+inline constexpr mat4 mat4::scale(float x, float y, float z)
 {
 	return mat4
 	{
@@ -63,10 +69,17 @@ inline mat4 mat4::scale(float x, float y, float z)
 	};
 }
 
-inline mat4 mat4::lookAt(vec3 pos, vec3 target, vec3 up)
+// vec3::normalize() that can run in constant expressions, same operations so the same bits
+inline constexpr vec3 mat4Normalize(vec3 const& v)
+{
+	float length = MAT4_RUNTIME() ? sqrtf(vec3::dot(v, v)) : constexprSqrt(vec3::dot(v, v));
+	return vec3(v.x/length, v.y/length, v.z/length);
+}
+
+inline constexpr mat4 mat4::lookAt(vec3 pos, vec3 target, vec3 up)
 {
-	vec3 zaxis = (target - pos).normalize();
-	vec3 xaxis = vec3::cross(zaxis, up).normalize();
+	vec3 zaxis = mat4Normalize(target - pos);
+	vec3 xaxis = mat4Normalize(vec3::cross(zaxis, up));
 	vec3 yaxis = vec3::cross(xaxis, zaxis);
 
 	zaxis = -zaxis;
@@ -80,9 +93,9 @@ inline mat4 mat4::lookAt(vec3 pos, vec3 target, vec3 up)
 	};
 }
 
-inline mat4 mat4::perspective(float fov, float aspect, float near, float far)
+inline constexpr mat4 mat4::perspective(float fov, float aspect, float near, float far)
 {
-	float t = tanf(fov / 2.0f) * near;
+	float t = (MAT4_RUNTIME() ? tanf(fov / 2.0f) : constexprTan(fov / 2.0f)) * near;
 	float b = -t;
 	float r = t * aspect;
 	float l = -r;
@@ -96,7 +109,7 @@ inline mat4 mat4::perspective(float fov, float aspect, float near, float far)
 	};
 }
 
-inline mat4 mat4::ortho(float width, float height, float near, float far)
+inline constexpr mat4 mat4::ortho(float width, float height, float near, float far)
 {
 	return mat4
 	{
@@ -107,8 +120,37 @@ inline mat4 mat4::ortho(float width, float height, float near, float far)
 	};
 }
 
+// Row i of the product is the sum over k of lhs[i][k] times row k of rhs, accumulated in the same order as the scalar expressions
+// and without fused multiply-adds, so SIMD and scalar builds give the same bits.
+// AVX only: mat4_benchmark measured an SSE kernel slower than the compiler's own vectorization of the scalar expressions
+#if defined(MAT4_SIMD_AVX)
+inline mat4 mat4MultiplySimd(mat4 const& lhs, mat4 const& rhs)
+{
+	// Two rows of lhs per register, each 128 bit lane broadcasts its own row's elements
+	__m256 b0 = _mm256_broadcast_ps((const __m128*)&rhs.m[0]);
+	__m256 b1 = _mm256_broadcast_ps((const __m128*)&rhs.m[4]);
+	__m256 b2 = _mm256_broadcast_ps((const __m128*)&rhs.m[8]);
+	__m256 b3 = _mm256_broadcast_ps((const __m128*)&rhs.m[12]);
+
+	mat4 result;
+	for (int i = 0; i < 16; i += 8)
+	{
+		__m256 a = _mm256_loadu_ps(&lhs.m[i]);
+		__m256 r = _mm256_mul_ps(_mm256_shuffle_ps(a, a, 0x00), b0);
+		r = _mm256_add_ps(r, _mm256_mul_ps(_mm256_shuffle_ps(a, a, 0x55), b1));
+		r = _mm256_add_ps(r, _mm256_mul_ps(_mm256_shuffle_ps(a, a, 0xaa), b2));
+		r = _mm256_add_ps(r, _mm256_mul_ps(_mm256_shuffle_ps(a, a, 0xff), b3));
+		_mm256_storeu_ps(&result.m[i], r);
+	}
+	return result;
+}
+#endif
+
 inline constexpr mat4 operator*(mat4 const& lhs, mat4 const& rhs)
 {
+#if defined(MAT4_SIMD_AVX)
+	if (!MAT4_CONSTANT_EVALUATED()) return mat4MultiplySimd(lhs, rhs);
+#endif
 	return mat4
 	{
 		lhs.m[0] * rhs.m[0] + lhs.m[1] * rhs.m[4] + lhs.m[2] * rhs.m[8] +  lhs.m[3] * rhs.m[12],
@@ -133,8 +175,43 @@ inline constexpr mat4 operator*(mat4 const& lhs, mat4 const& rhs)
 	};
 }
 
+// Element i is row i of m dotted with v. The columns are broadcast-multiplied by x, y, z and w and summed in the scalar order
+#if defined(MAT4_SIMD_SSE)
+inline vec4 mat4MultiplySimd(mat4 const& lhs, vec4 const& rhs)
+{
+	__m128 c0 = _mm_loadu_ps(&lhs.m[0]);
+	__m128 c1 = _mm_loadu_ps(&lhs.m[4]);
+	__m128 c2 = _mm_loadu_ps(&lhs.m[8]);
+	__m128 c3 = _mm_loadu_ps(&lhs.m[12]);
+	_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+
+	__m128 r = _mm_mul_ps(c0, _mm_set1_ps(rhs.x));
+	r = _mm_add_ps(r, _mm_mul_ps(c1, _mm_set1_ps(rhs.y)));
+	r = _mm_add_ps(r, _mm_mul_ps(c2, _mm_set1_ps(rhs.z)));
+	r = _mm_add_ps(r, _mm_mul_ps(c3, _mm_set1_ps(rhs.w)));
+	vec4 result;
+	_mm_storeu_ps(&result.x, r);
+	return result;
+}
+#elif defined(MAT4_SIMD_NEON)
+inline vec4 mat4MultiplySimd(mat4 const& lhs, vec4 const& rhs)
+{
+	float32x4x4_t c = vld4q_f32(lhs.m);
+	float32x4_t r = vmulq_n_f32(c.val[0], rhs.x);
+	r = vaddq_f32(r, vmulq_n_f32(c.val[1], rhs.y));
+	r = vaddq_f32(r, vmulq_n_f32(c.val[2], rhs.z));
+	r = vaddq_f32(r, vmulq_n_f32(c.val[3], rhs.w));
+	vec4 result;
+	vst1q_f32(&result.x, r);
+	return result;
+}
+#endif
+
 inline constexpr vec4 operator*(mat4 const& lhs, vec4 const& rhs)
 {
+#if defined(MAT4_SIMD_SSE) || defined(MAT4_SIMD_NEON)
+	if (!MAT4_CONSTANT_EVALUATED()) return mat4MultiplySimd(lhs, rhs);
+#endif
 	return vec4
 	{
 		lhs.m[0] * rhs.x + lhs.m[1] * rhs.y + lhs.m[2] * rhs.z +  lhs.m[3] * rhs.w,
@@ -146,3 +223,538 @@ inline constexpr vec4 operator*(mat4 const& lhs, vec4 const& rhs)
 		lhs.m[12] * rhs.x + lhs.m[13] * rhs.y + lhs.m[14] * rhs.z +  lhs.m[15] * rhs.w
 	};
 }
+
+// Each point is the sum of the rows of m scaled by x, y, z and w: three broadcasts and multiply-adds.
+// The sums run in the scalar order, so every path gives the same bits.
+inline void mat4Transform(const mat4& m, const vec3* in, vec3* out, size_t count, float w)
+{
+#if defined(MAT4_SIMD_SSE)
+	__m128 r0 = _mm_loadu_ps(&m.m[0]);
+	__m128 r1 = _mm_loadu_ps(&m.m[4]);
+	__m128 r2 = _mm_loadu_ps(&m.m[8]);
+	__m128 r3 = _mm_mul_ps(_mm_loadu_ps(&m.m[12]), _mm_set1_ps(w));
+	for (size_t i = 0; i < count; ++i)
+	{
+		__m128 r = _mm_mul_ps(r0, _mm_set1_ps(in[i].x));
+		r = _mm_add_ps(r, _mm_mul_ps(r1, _mm_set1_ps(in[i].y)));
+		r = _mm_add_ps(r, _mm_mul_ps(r2, _mm_set1_ps(in[i].z)));
+		r = _mm_add_ps(r, r3);
+		_mm_storel_pi((__m64*)&out[i].x, r);
+		_mm_store_ss(&out[i].z, _mm_movehl_ps(r, r));
+	}
+#elif defined(MAT4_SIMD_NEON)
+	float32x4_t r0 = vld1q_f32(&m.m[0]);
+	float32x4_t r1 = vld1q_f32(&m.m[4]);
+	float32x4_t r2 = vld1q_f32(&m.m[8]);
+	float32x4_t r3 = vmulq_n_f32(vld1q_f32(&m.m[12]), w);
+	for (size_t i = 0; i < count; ++i)
+	{
+		float32x4_t r = vmulq_n_f32(r0, in[i].x);
+		r = vaddq_f32(r, vmulq_n_f32(r1, in[i].y));
+		r = vaddq_f32(r, vmulq_n_f32(r2, in[i].z));
+		r = vaddq_f32(r, r3);
+		vst1_f32(&out[i].x, vget_low_f32(r));
+		vst1q_lane_f32(&out[i].z, r, 2);
+	}
+#else
+	float tx = m.m[12] * w;
+	float ty = m.m[13] * w;
+	float tz = m.m[14] * w;
+	for (size_t i = 0; i < count; ++i)
+	{
+		vec3 p = in[i];
+		out[i] = vec3(m.m[0]*p.x + m.m[4]*p.y + m.m[8]*p.z + tx,
+					  m.m[1]*p.x + m.m[5]*p.y + m.m[9]*p.z + ty,
+					  m.m[2]*p.x + m.m[6]*p.y + m.m[10]*p.z + tz);
+	}
+#endif
+}
+
+inline void transform_points(const mat4& m, const vec3* in, vec3* out, size_t count)
+{
+	mat4Transform(m, in, out, count, 1.0f);
+}
+
+inline void transform_vectors(const mat4& m, const vec3* in, vec3* out, size_t count)
+{
+	mat4Transform(m, in, out, count, 0.0f);
+}
+
+#if defined(MAT4_SIMD_SSE)
+inline mat4 mat4TransposeSimd(mat4 const& a)
+{
+	__m128 r0 = _mm_loadu_ps(&a.m[0]);
+	__m128 r1 = _mm_loadu_ps(&a.m[4]);
+	__m128 r2 = _mm_loadu_ps(&a.m[8]);
+	__m128 r3 = _mm_loadu_ps(&a.m[12]);
+	_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+	mat4 result;
+	_mm_storeu_ps(&result.m[0], r0);
+	_mm_storeu_ps(&result.m[4], r1);
+	_mm_storeu_ps(&result.m[8], r2);
+	_mm_storeu_ps(&result.m[12], r3);
+	return result;
+}
+#elif defined(MAT4_SIMD_NEON)
+inline mat4 mat4TransposeSimd(mat4 const& a)
+{
+	// The de-interleaving load reads the columns
+	float32x4x4_t c = vld4q_f32(a.m);
+
+	mat4 result;
+	vst1q_f32(&result.m[0], c.val[0]);
+	vst1q_f32(&result.m[4], c.val[1]);
+	vst1q_f32(&result.m[8], c.val[2]);
+	vst1q_f32(&result.m[12], c.val[3]);
+	return result;
+}
+#endif
+
+inline constexpr mat4 mat4::transpose() const
+{
+#if defined(MAT4_SIMD_SSE) || defined(MAT4_SIMD_NEON)
+	if (!MAT4_CONSTANT_EVALUATED()) return mat4TransposeSimd(*this);
+#endif
+	return mat4
+	{
+		m[0], m[4], m[8], m[12],
+		m[1], m[5], m[9], m[13],
+		m[2], m[6], m[10], m[14],
+		m[3], m[7], m[11], m[15]
+	};
+}
+
+#if defined(MAT4_SIMD_SSE)
+// Lanes x, y, z and w of the result come from lanes x, y, z and w of a and b
+#define MAT4_SHUFFLE(a, b, x, y, z, w) _mm_shuffle_ps(a, b, _MM_SHUFFLE(w, z, y, x))
+
+// The 2x2 blocks are kept as a00 a01 a10 a11 in one register.
+// A * B
+inline __m128 mat4Mul2x2(__m128 a, __m128 b)
+{
+	return _mm_add_ps(_mm_mul_ps(a, MAT4_SHUFFLE(b, b, 0, 3, 0, 3)), _mm_mul_ps(MAT4_SHUFFLE(a, a, 1, 0, 3, 2), MAT4_SHUFFLE(b, b, 2, 1, 2, 1)));
+}
+
+// adj(A) * B
+inline __m128 mat4AdjMul2x2(__m128 a, __m128 b)
+{
+	return _mm_sub_ps(_mm_mul_ps(MAT4_SHUFFLE(a, a, 3, 3, 0, 0), b), _mm_mul_ps(MAT4_SHUFFLE(a, a, 1, 1, 2, 2), MAT4_SHUFFLE(b, b, 2, 3, 0, 1)));
+}
+
+// A * adj(B)
+inline __m128 mat4MulAdj2x2(__m128 a, __m128 b)
+{
+	return _mm_sub_ps(_mm_mul_ps(a, MAT4_SHUFFLE(b, b, 3, 0, 3, 0)), _mm_mul_ps(MAT4_SHUFFLE(a, a, 1, 0, 3, 2), MAT4_SHUFFLE(b, b, 2, 1, 2, 1)));
+}
+
+// Block inverse of [A B; C D], every product is between 2x2 blocks so four of them fit a register
+inline mat4 mat4InverseSimd(mat4 const& a)
+{
+	__m128 r0 = _mm_loadu_ps(&a.m[0]);
+	__m128 r1 = _mm_loadu_ps(&a.m[4]);
+	__m128 r2 = _mm_loadu_ps(&a.m[8]);
+	__m128 r3 = _mm_loadu_ps(&a.m[12]);
+
+	__m128 A = _mm_movelh_ps(r0, r1);
+	__m128 B = _mm_movehl_ps(r1, r0);
+	__m128 C = _mm_movelh_ps(r2, r3);
+	__m128 D = _mm_movehl_ps(r3, r2);
+
+	// |A| |B| |C| |D|
+	__m128 detSub = _mm_sub_ps(_mm_mul_ps(MAT4_SHUFFLE(r0, r2, 0, 2, 0, 2), MAT4_SHUFFLE(r1, r3, 1, 3, 1, 3)),
+							   _mm_mul_ps(MAT4_SHUFFLE(r0, r2, 1, 3, 1, 3), MAT4_SHUFFLE(r1, r3, 0, 2, 0, 2)));
+	__m128 detA = MAT4_SHUFFLE(detSub, detSub, 0, 0, 0, 0);
+	__m128 detB = MAT4_SHUFFLE(detSub, detSub, 1, 1, 1, 1);
+	__m128 detC = MAT4_SHUFFLE(detSub, detSub, 2, 2, 2, 2);
+	__m128 detD = MAT4_SHUFFLE(detSub, detSub, 3, 3, 3, 3);
+
+	// The inverse is [X Y; Z W] / |M|, these are the adjugates of X, Y, Z and W
+	__m128 DC = mat4AdjMul2x2(D, C);
+	__m128 AB = mat4AdjMul2x2(A, B);
+	__m128 X = _mm_sub_ps(_mm_mul_ps(detD, A), mat4Mul2x2(B, DC));
+	__m128 W = _mm_sub_ps(_mm_mul_ps(detA, D), mat4Mul2x2(C, AB));
+	__m128 Y = _mm_sub_ps(_mm_mul_ps(detB, C), mat4MulAdj2x2(D, AB));
+	__m128 Z = _mm_sub_ps(_mm_mul_ps(detC, B), mat4MulAdj2x2(A, DC));
+
+	// |M| = |A||D| + |B||C| - tr(adj(A) B adj(D) C)
+	__m128 trace = _mm_mul_ps(AB, MAT4_SHUFFLE(DC, DC, 0, 2, 1, 3));
+	trace = _mm_add_ps(trace, MAT4_SHUFFLE(trace, trace, 1, 0, 3, 2));
+	trace = _mm_add_ps(trace, MAT4_SHUFFLE(trace, trace, 2, 3, 0, 1));
+	__m128 detM = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(detA, detD), _mm_mul_ps(detB, detC)), trace);
+
+	// Adjugate signs folded into the reciprocal, the lane swaps into the stores
+	__m128 rcpDet = _mm_div_ps(_mm_setr_ps(1.0f, -1.0f, -1.0f, 1.0f), detM);
+	X = _mm_mul_ps(X, rcpDet);
+	Y = _mm_mul_ps(Y, rcpDet);
+	Z = _mm_mul_ps(Z, rcpDet);
+	W = _mm_mul_ps(W, rcpDet);
+
+	mat4 result;
+	_mm_storeu_ps(&result.m[0], MAT4_SHUFFLE(X, Y, 3, 1, 3, 1));
+	_mm_storeu_ps(&result.m[4], MAT4_SHUFFLE(X, Y, 2, 0, 2, 0));
+	_mm_storeu_ps(&result.m[8], MAT4_SHUFFLE(Z, W, 3, 1, 3, 1));
+	_mm_storeu_ps(&result.m[12], MAT4_SHUFFLE(Z, W, 2, 0, 2, 0));
+	return result;
+}
+
+inline __m128 mat4Cross(__m128 a, __m128 b)
+{
+	__m128 c = _mm_sub_ps(_mm_mul_ps(a, MAT4_SHUFFLE(b, b, 1, 2, 0, 3)), _mm_mul_ps(MAT4_SHUFFLE(a, a, 1, 2, 0, 3), b));
+	return MAT4_SHUFFLE(c, c, 1, 2, 0, 3);
+}
+
+// Writes the three axes with w cleared, or with cofactors their cross products over the determinant.
+// Those are the rows of the inverse of the linear part and the columns of its inverse transpose.
+inline void mat4Axes(mat4 const& a, bool cofactors, __m128& c0, __m128& c1, __m128& c2)
+{
+	const __m128 xyz = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+	c0 = _mm_and_ps(_mm_loadu_ps(&a.m[0]), xyz);
+	c1 = _mm_and_ps(_mm_loadu_ps(&a.m[4]), xyz);
+	c2 = _mm_and_ps(_mm_loadu_ps(&a.m[8]), xyz);
+	if (cofactors == false) return;
+
+	__m128 n0 = mat4Cross(c1, c2);
+	__m128 n1 = mat4Cross(c2, c0);
+	__m128 n2 = mat4Cross(c0, c1);
+
+	// x + y then + z, the order of the scalar dot product
+	__m128 det = _mm_mul_ps(c0, n0);
+	det = _mm_add_ss(_mm_add_ss(det, MAT4_SHUFFLE(det, det, 1, 1, 1, 1)), MAT4_SHUFFLE(det, det, 2, 2, 2, 2));
+	__m128 rcpDet = _mm_div_ps(_mm_set1_ps(1.0f), MAT4_SHUFFLE(det, det, 0, 0, 0, 0));
+	c0 = _mm_mul_ps(n0, rcpDet);
+	c1 = _mm_mul_ps(n1, rcpDet);
+	c2 = _mm_mul_ps(n2, rcpDet);
+}
+
+// Stores the inverse whose linear part has rows r0 r1 r2, the translation is moved through it
+inline mat4 mat4InverseAffineSimd(mat4 const& a, __m128 r0, __m128 r1, __m128 r2)
+{
+	// r3 comes back as 0 0 0 1, subtracting it sets w of the translation without touching the signs of zeros
+	__m128 r3 = _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f);
+	_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+	__m128 t = _mm_loadu_ps(&a.m[12]);
+	t = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r0, MAT4_SHUFFLE(t, t, 0, 0, 0, 0)), _mm_mul_ps(r1, MAT4_SHUFFLE(t, t, 1, 1, 1, 1))),
+				   _mm_mul_ps(r2, MAT4_SHUFFLE(t, t, 2, 2, 2, 2)));
+	t = _mm_xor_ps(_mm_sub_ps(t, r3), _mm_set1_ps(-0.0f));
+
+	mat4 result;
+	_mm_storeu_ps(&result.m[0], r0);
+	_mm_storeu_ps(&result.m[4], r1);
+	_mm_storeu_ps(&result.m[8], r2);
+	_mm_storeu_ps(&result.m[12], t);
+	return result;
+}
+
+inline mat4 mat4InverseAffineSimd(mat4 const& a, bool rigid)
+{
+	__m128 r0, r1, r2;
+	mat4Axes(a, rigid == false, r0, r1, r2);
+	return mat4InverseAffineSimd(a, r0, r1, r2);
+}
+
+inline mat4 mat4NormalMatrixSimd(mat4 const& a)
+{
+	__m128 c0, c1, c2;
+	mat4Axes(a, true, c0, c1, c2);
+
+	mat4 result;
+	_mm_storeu_ps(&result.m[0], c0);
+	_mm_storeu_ps(&result.m[4], c1);
+	_mm_storeu_ps(&result.m[8], c2);
+	_mm_storeu_ps(&result.m[12], _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f));
+	return result;
+}
+
+#undef MAT4_SHUFFLE
+#elif defined(MAT4_SIMD_NEON64)
+// The SSE code above with its shuffles spelled as NEON permutes, operations and their order are the same
+
+inline float32x4_t mat4Twice(float32x2_t p)
+{
+	return vcombine_f32(p, p);
+}
+
+// Lanes i, j, i, j of v
+#define MAT4_PAIR(v, i, j) mat4Twice(vset_lane_f32(vgetq_lane_f32(v, j), vdup_laneq_f32(v, i), 1))
+
+inline float32x4_t mat4Mul2x2(float32x4_t a, float32x4_t b)
+{
+	return vaddq_f32(vmulq_f32(a, MAT4_PAIR(b, 0, 3)), vmulq_f32(vrev64q_f32(a), MAT4_PAIR(b, 2, 1)));
+}
+
+inline float32x4_t mat4AdjMul2x2(float32x4_t a, float32x4_t b)
+{
+	float32x4_t a3300 = vcombine_f32(vdup_laneq_f32(a, 3), vdup_laneq_f32(a, 0));
+	float32x4_t a1122 = vcombine_f32(vdup_laneq_f32(a, 1), vdup_laneq_f32(a, 2));
+	return vsubq_f32(vmulq_f32(a3300, b), vmulq_f32(a1122, vextq_f32(b, b, 2)));
+}
+
+inline float32x4_t mat4MulAdj2x2(float32x4_t a, float32x4_t b)
+{
+	return vsubq_f32(vmulq_f32(a, MAT4_PAIR(b, 3, 0)), vmulq_f32(vrev64q_f32(a), MAT4_PAIR(b, 2, 1)));
+}
+
+inline mat4 mat4InverseSimd(mat4 const& a)
+{
+	float32x4_t r0 = vld1q_f32(&a.m[0]);
+	float32x4_t r1 = vld1q_f32(&a.m[4]);
+	float32x4_t r2 = vld1q_f32(&a.m[8]);
+	float32x4_t r3 = vld1q_f32(&a.m[12]);
+
+	float32x4_t A = vcombine_f32(vget_low_f32(r0), vget_low_f32(r1));
+	float32x4_t B = vcombine_f32(vget_high_f32(r0), vget_high_f32(r1));
+	float32x4_t C = vcombine_f32(vget_low_f32(r2), vget_low_f32(r3));
+	float32x4_t D = vcombine_f32(vget_high_f32(r2), vget_high_f32(r3));
+
+	float32x4_t detSub = vsubq_f32(vmulq_f32(vuzp1q_f32(r0, r2), vuzp2q_f32(r1, r3)), vmulq_f32(vuzp2q_f32(r0, r2), vuzp1q_f32(r1, r3)));
+	float32x4_t detA = vdupq_laneq_f32(detSub, 0);
+	float32x4_t detB = vdupq_laneq_f32(detSub, 1);
+	float32x4_t detC = vdupq_laneq_f32(detSub, 2);
+	float32x4_t detD = vdupq_laneq_f32(detSub, 3);
+
+	float32x4_t DC = mat4AdjMul2x2(D, C);
+	float32x4_t AB = mat4AdjMul2x2(A, B);
+	float32x4_t X = vsubq_f32(vmulq_f32(detD, A), mat4Mul2x2(B, DC));
+	float32x4_t W = vsubq_f32(vmulq_f32(detA, D), mat4Mul2x2(C, AB));
+	float32x4_t Y = vsubq_f32(vmulq_f32(detB, C), mat4MulAdj2x2(D, AB));
+	float32x4_t Z = vsubq_f32(vmulq_f32(detC, B), mat4MulAdj2x2(A, DC));
+
+	float32x4_t trace = vmulq_f32(AB, vcombine_f32(vget_low_f32(vuzp1q_f32(DC, DC)), vget_low_f32(vuzp2q_f32(DC, DC))));
+	trace = vaddq_f32(trace, vrev64q_f32(trace));
+	trace = vaddq_f32(trace, vextq_f32(trace, trace, 2));
+	float32x4_t detM = vsubq_f32(vaddq_f32(vmulq_f32(detA, detD), vmulq_f32(detB, detC)), trace);
+
+	static const float signs[4] = { 1.0f, -1.0f, -1.0f, 1.0f };
+	float32x4_t rcpDet = vdivq_f32(vld1q_f32(signs), detM);
+	X = vmulq_f32(X, rcpDet);
+	Y = vmulq_f32(Y, rcpDet);
+	Z = vmulq_f32(Z, rcpDet);
+	W = vmulq_f32(W, rcpDet);
+
+	mat4 result;
+	vst1q_f32(&result.m[0], vrev64q_f32(vuzp2q_f32(X, Y)));
+	vst1q_f32(&result.m[4], vrev64q_f32(vuzp1q_f32(X, Y)));
+	vst1q_f32(&result.m[8], vrev64q_f32(vuzp2q_f32(Z, W)));
+	vst1q_f32(&result.m[12], vrev64q_f32(vuzp1q_f32(Z, W)));
+	return result;
+}
+
+// (v.y, v.z, v.x, v.w)
+inline float32x4_t mat4YZX(float32x4_t v)
+{
+	return vcopyq_laneq_f32(vcopyq_laneq_f32(vextq_f32(v, v, 1), 2, v, 0), 3, v, 3);
+}
+
+inline float32x4_t mat4Cross(float32x4_t a, float32x4_t b)
+{
+	return mat4YZX(vsubq_f32(vmulq_f32(a, mat4YZX(b)), vmulq_f32(mat4YZX(a), b)));
+}
+
+inline void mat4Axes(mat4 const& a, bool cofactors, float32x4_t& c0, float32x4_t& c1, float32x4_t& c2)
+{
+	c0 = vsetq_lane_f32(0.0f, vld1q_f32(&a.m[0]), 3);
+	c1 = vsetq_lane_f32(0.0f, vld1q_f32(&a.m[4]), 3);
+	c2 = vsetq_lane_f32(0.0f, vld1q_f32(&a.m[8]), 3);
+	if (cofactors == false) return;
+
+	float32x4_t n0 = mat4Cross(c1, c2);
+	float32x4_t n1 = mat4Cross(c2, c0);
+	float32x4_t n2 = mat4Cross(c0, c1);
+
+	float32x4_t det = vmulq_f32(c0, n0);
+	float32x4_t rcpDet = vdupq_n_f32(1.0f / ((vgetq_lane_f32(det, 0) + vgetq_lane_f32(det, 1)) + vgetq_lane_f32(det, 2)));
+	c0 = vmulq_f32(n0, rcpDet);
+	c1 = vmulq_f32(n1, rcpDet);
+	c2 = vmulq_f32(n2, rcpDet);
+}
+
+inline mat4 mat4InverseAffineSimd(mat4 const& a, float32x4_t r0, float32x4_t r1, float32x4_t r2)
+{
+	static const float w[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+	float32x4_t r3 = vld1q_f32(w);
+	float32x4_t t0 = vtrn1q_f32(r0, r1);
+	float32x4_t t1 = vtrn2q_f32(r0, r1);
+	float32x4_t t2 = vtrn1q_f32(r2, r3);
+	float32x4_t t3 = vtrn2q_f32(r2, r3);
+	r0 = vcombine_f32(vget_low_f32(t0), vget_low_f32(t2));
+	r1 = vcombine_f32(vget_low_f32(t1), vget_low_f32(t3));
+	r2 = vcombine_f32(vget_high_f32(t0), vget_high_f32(t2));
+	r3 = vcombine_f32(vget_high_f32(t1), vget_high_f32(t3));
+	float32x4_t t = vld1q_f32(&a.m[12]);
+	t = vaddq_f32(vaddq_f32(vmulq_laneq_f32(r0, t, 0), vmulq_laneq_f32(r1, t, 1)), vmulq_laneq_f32(r2, t, 2));
+	t = vnegq_f32(vsubq_f32(t, r3));
+
+	mat4 result;
+	vst1q_f32(&result.m[0], r0);
+	vst1q_f32(&result.m[4], r1);
+	vst1q_f32(&result.m[8], r2);
+	vst1q_f32(&result.m[12], t);
+	return result;
+}
+
+inline mat4 mat4InverseAffineSimd(mat4 const& a, bool rigid)
+{
+	float32x4_t r0, r1, r2;
+	mat4Axes(a, rigid == false, r0, r1, r2);
+	return mat4InverseAffineSimd(a, r0, r1, r2);
+}
+
+inline mat4 mat4NormalMatrixSimd(mat4 const& a)
+{
+	float32x4_t c0, c1, c2;
+	mat4Axes(a, true, c0, c1, c2);
+
+	static const float w[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+	mat4 result;
+	vst1q_f32(&result.m[0], c0);
+	vst1q_f32(&result.m[4], c1);
+	vst1q_f32(&result.m[8], c2);
+	vst1q_f32(&result.m[12], vld1q_f32(w));
+	return result;
+}
+
+#undef MAT4_PAIR
+#endif
+
+// Cofactor expansion, the SIMD block inverse can differ from it in the last bits
+inline constexpr mat4 mat4::inverse() const
+{
+#if defined(MAT4_SIMD_SSE) || defined(MAT4_SIMD_NEON64)
+	if (!MAT4_CONSTANT_EVALUATED()) return mat4InverseSimd(*this);
+#endif
+	mat4 r
+	{
+		m[5]*m[10]*m[15] - m[5]*m[11]*m[14] - m[9]*m[6]*m[15] + m[9]*m[7]*m[14] + m[13]*m[6]*m[11] - m[13]*m[7]*m[10],
+		-m[1]*m[10]*m[15] + m[1]*m[11]*m[14] + m[9]*m[2]*m[15] - m[9]*m[3]*m[14] - m[13]*m[2]*m[11] + m[13]*m[3]*m[10],
+		m[1]*m[6]*m[15] - m[1]*m[7]*m[14] - m[5]*m[2]*m[15] + m[5]*m[3]*m[14] + m[13]*m[2]*m[7] - m[13]*m[3]*m[6],
+		-m[1]*m[6]*m[11] + m[1]*m[7]*m[10] + m[5]*m[2]*m[11] - m[5]*m[3]*m[10] - m[9]*m[2]*m[7] + m[9]*m[3]*m[6],
+
+		-m[4]*m[10]*m[15] + m[4]*m[11]*m[14] + m[8]*m[6]*m[15] - m[8]*m[7]*m[14] - m[12]*m[6]*m[11] + m[12]*m[7]*m[10],
+		m[0]*m[10]*m[15] - m[0]*m[11]*m[14] - m[8]*m[2]*m[15] + m[8]*m[3]*m[14] + m[12]*m[2]*m[11] - m[12]*m[3]*m[10],
+		-m[0]*m[6]*m[15] + m[0]*m[7]*m[14] + m[4]*m[2]*m[15] - m[4]*m[3]*m[14] - m[12]*m[2]*m[7] + m[12]*m[3]*m[6],
+		m[0]*m[6]*m[11] - m[0]*m[7]*m[10] - m[4]*m[2]*m[11] + m[4]*m[3]*m[10] + m[8]*m[2]*m[7] - m[8]*m[3]*m[6],
+
+		m[4]*m[9]*m[15] - m[4]*m[11]*m[13] - m[8]*m[5]*m[15] + m[8]*m[7]*m[13] + m[12]*m[5]*m[11] - m[12]*m[7]*m[9],
+		-m[0]*m[9]*m[15] + m[0]*m[11]*m[13] + m[8]*m[1]*m[15] - m[8]*m[3]*m[13] - m[12]*m[1]*m[11] + m[12]*m[3]*m[9],
+		m[0]*m[5]*m[15] - m[0]*m[7]*m[13] - m[4]*m[1]*m[15] + m[4]*m[3]*m[13] + m[12]*m[1]*m[7] - m[12]*m[3]*m[5],
+		-m[0]*m[5]*m[11] + m[0]*m[7]*m[9] + m[4]*m[1]*m[11] - m[4]*m[3]*m[9] - m[8]*m[1]*m[7] + m[8]*m[3]*m[5],
+
+		-m[4]*m[9]*m[14] + m[4]*m[10]*m[13] + m[8]*m[5]*m[14] - m[8]*m[6]*m[13] - m[12]*m[5]*m[10] + m[12]*m[6]*m[9],
+		m[0]*m[9]*m[14] - m[0]*m[10]*m[13] - m[8]*m[1]*m[14] + m[8]*m[2]*m[13] + m[12]*m[1]*m[10] - m[12]*m[2]*m[9],
+		-m[0]*m[5]*m[14] + m[0]*m[6]*m[13] + m[4]*m[1]*m[14] - m[4]*m[2]*m[13] - m[12]*m[1]*m[6] + m[12]*m[2]*m[5],
+		m[0]*m[5]*m[10] - m[0]*m[6]*m[9] - m[4]*m[1]*m[10] + m[4]*m[2]*m[9] + m[8]*m[1]*m[6] - m[8]*m[2]*m[5]
+	};
+
+	float det = m[0]*r.m[0] + m[1]*r.m[4] + m[2]*r.m[8] + m[3]*r.m[12];
+	float rcpDet = 1.0f / det;
+	for (int i = 0; i < 16; ++i)
+	{
+		r.m[i] *= rcpDet;
+	}
+	return r;
+}
+
+// The axes m[0..2], m[4..6] and m[8..10] crossed pairwise over the determinant, the rows of the inverse linear part
+inline constexpr void mat4InverseAxes(mat4 const& a, vec3& r0, vec3& r1, vec3& r2)
+{
+	vec3 c0(a.m[0], a.m[1], a.m[2]);
+	vec3 c1(a.m[4], a.m[5], a.m[6]);
+	vec3 c2(a.m[8], a.m[9], a.m[10]);
+	vec3 n0 = vec3::cross(c1, c2);
+	float rcpDet = 1.0f / vec3::dot(c0, n0);
+	r0 = n0*rcpDet;
+	r1 = vec3::cross(c2, c0)*rcpDet;
+	r2 = vec3::cross(c0, c1)*rcpDet;
+}
+
+// Affine matrix with linear part rows r0 r1 r2 and the translation of a taken through them
+inline constexpr mat4 mat4AffineFromRows(mat4 const& a, vec3 const& r0, vec3 const& r1, vec3 const& r2)
+{
+	vec3 t(a.m[12], a.m[13], a.m[14]);
+	return mat4
+	{
+		r0.x, r1.x, r2.x, 0.0f,
+		r0.y, r1.y, r2.y, 0.0f,
+		r0.z, r1.z, r2.z, 0.0f,
+		-(r0.x*t.x + r0.y*t.y + r0.z*t.z), -(r1.x*t.x + r1.y*t.y + r1.z*t.z), -(r2.x*t.x + r2.y*t.y + r2.z*t.z), 1.0f
+	};
+}
+
+inline constexpr mat4 mat4::inverseAffine() const
+{
+#if defined(MAT4_SIMD_SSE) || defined(MAT4_SIMD_NEON64)
+	if (!MAT4_CONSTANT_EVALUATED()) return mat4InverseAffineSimd(*this, false);
+#endif
+	vec3 r0, r1, r2;
+	mat4InverseAxes(*this, r0, r1, r2);
+	return mat4AffineFromRows(*this, r0, r1, r2);
+}
+
+inline constexpr mat4 mat4::inverseRigid() const
+{
+#if defined(MAT4_SIMD_SSE) || defined(MAT4_SIMD_NEON64)
+	if (!MAT4_CONSTANT_EVALUATED()) return mat4InverseAffineSimd(*this, true);
+#endif
+	return mat4AffineFromRows(*this, vec3(m[0], m[1], m[2]), vec3(m[4], m[5], m[6]), vec3(m[8], m[9], m[10]));
+}
+
+inline constexpr mat4 mat4::normalMatrix() const
+{
+#if defined(MAT4_SIMD_SSE) || defined(MAT4_SIMD_NEON64)
+	if (!MAT4_CONSTANT_EVALUATED()) return mat4NormalMatrixSimd(*this);
+#endif
+	vec3 c0, c1, c2;
+	mat4InverseAxes(*this, c0, c1, c2);
+	return mat4
+	{
+		c0.x, c0.y, c0.z, 0.0f,
+		c1.x, c1.y, c1.z, 0.0f,
+		c2.x, c2.y, c2.z, 0.0f,
+		0.0f, 0.0f, 0.0f, 1.0f
+	};
+}
+
+inline bool mat4::decompose(vec3& translation, mat4& rotation, vec3& scale) const
+{
+	vec3 c0(m[0], m[1], m[2]);
+	vec3 c1(m[4], m[5], m[6]);
+	vec3 c2(m[8], m[9], m[10]);
+	scale = vec3(sqrtf(vec3::dot(c0, c0)), sqrtf(vec3::dot(c1, c1)), sqrtf(vec3::dot(c2, c2)));
+	if (scale.x == 0.0f || scale.y == 0.0f || scale.z == 0.0f) return false;
+
+	// A mirrored basis keeps a proper rotation by flipping the first axis
+	if (vec3::dot(c0, vec3::cross(c1, c2)) < 0.0f) scale.x = -scale.x;
+
+	c0 = c0/scale.x;
+	c1 = c1/scale.y;
+	c2 = c2/scale.z;
+	rotation = mat4
+	{
+		c0.x, c0.y, c0.z, 0.0f,
+		c1.x, c1.y, c1.z, 0.0f,
+		c2.x, c2.y, c2.z, 0.0f,
+		0.0f, 0.0f, 0.0f, 1.0f
+	};
+	translation = vec3(m[12], m[13], m[14]);
+	return true;
+}
+
+// Compile-time checks, lookAt matches the runtime result exactly because constexprSqrt rounds like sqrtf
+static_assert((mat4::identity * mat4::translate(1.0f, 2.0f, 3.0f)).m[13] == 2.0f, "mat4 identity");
+static_assert((mat4::scale(2.0f, 3.0f, 4.0f) * vec4(1.0f, 1.0f, 1.0f, 1.0f)).z == 4.0f, "mat4::scale");
+static_assert(mat4::ortho(4.0f, 8.0f, 1.0f, 3.0f).m[5] == 0.25f && mat4::ortho(4.0f, 8.0f, 1.0f, 3.0f).m[14] == -2.0f, "mat4::ortho");
+static_assert(mat4::perspective(1.57079637f, 1.0f, 0.1f, 10.0f).m[0] == 1.0f && mat4::perspective(1.57079637f, 1.0f, 0.1f, 10.0f).m[11] == -1.0f, "mat4::perspective");
+static_assert(mat4::lookAt(vec3(0.0f, 0.0f, 0.0f), vec3(1.0f, 0.0f, 0.0f), vec3(0.0f, -1.0f, 0.0f)).m[2] == -1.0f
+			  && mat4::lookAt(vec3(0.0f, 0.0f, 0.0f), vec3(1.0f, 0.0f, 0.0f), vec3(0.0f, -1.0f, 0.0f)).m[5] == -1.0f
+			  && mat4::lookAt(vec3(0.0f, 0.0f, 0.0f), vec3(1.0f, 0.0f, 0.0f), vec3(0.0f, -1.0f, 0.0f)).m[8] == -1.0f, "mat4::lookAt cube face");
+static_assert(mat4::lookAt(vec3(0.0f, 3.0f, 3.0f), vec3(0.0f, 0.0f, 0.0f), vec3(0.0f, 1.0f, 0.0f)).m[6] == 0.707106829f
+			  && mat4::lookAt(vec3(0.0f, 3.0f, 3.0f), vec3(0.0f, 0.0f, 0.0f), vec3(0.0f, 1.0f, 0.0f)).m[14] == -4.24264097f, "mat4::lookAt");
+static_assert(mat4::rotate(0.0f, 0.0f, 1.0f, 1.57079637f).m[4] > 0.9999999f && mat4::rotate(0.0f, 0.0f, 1.0f, 1.57079637f).m[0] < 1e-7f, "mat4::rotate");
+static_assert(mat4::translate(1.0f, 2.0f, 3.0f).transpose().m[3] == 1.0f && mat4::translate(1.0f, 2.0f, 3.0f).transpose().m[12] == 0.0f, "mat4::transpose");
+static_assert(mat4::translate(1.0f, 2.0f, 3.0f).inverseRigid().m[13] == -2.0f, "mat4::inverseRigid");
+static_assert((mat4::scale(2.0f, 4.0f, 8.0f)*mat4::translate(1.0f, 2.0f, 3.0f)).inverseAffine().m[10] == 0.125f
+			  && (mat4::scale(2.0f, 4.0f, 8.0f)*mat4::translate(1.0f, 2.0f, 3.0f)).inverseAffine().m[14] == -0.375f, "mat4::inverseAffine");
+static_assert((mat4::scale(2.0f, 4.0f, 8.0f)*mat4::translate(1.0f, 2.0f, 3.0f)).inverse().m[5] == 0.25f
+			  && (mat4::scale(2.0f, 4.0f, 8.0f)*mat4::translate(1.0f, 2.0f, 3.0f)).inverse().m[12] == -0.5f, "mat4::inverse");
+static_assert(mat4::scale(2.0f, 4.0f, 8.0f).normalMatrix().m[0] == 0.5f && mat4::translate(1.0f, 2.0f, 3.0f).normalMatrix().m[12] == 0.0f, "mat4::normalMatrix");
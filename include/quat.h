@@ -0,0 +1,56 @@
+#ifndef QUAT_H_
+#define QUAT_H_
+
+#include <stddef.h>
+
+#include "vec3.h"
+#include "mat4.h"
+
+// Unit quaternion rotations, 4 floats until a matrix is needed for upload.
+// Products follow mat4: to_mat4(a * b) is mat4 a * mat4 b, and q * v rotates like to_mat4(q) * vec4(v, 0).
+struct quat
+{
+	float x{};
+	float y{};
+	float z{};
+	float w{ 1.0f }; // identity by default
+
+	static const quat identity;
+
+	// -- Implicit basic constructors --
+	constexpr quat() = default;
+	constexpr quat(quat const& q) = default;
+
+	// -- Explicit basic constructors --
+	constexpr quat(float x, float y, float z, float w);
+
+	// Same rotation as mat4::rotate, the axis must be normalized
+	static constexpr quat rotate(float x, float y, float z, float angle);
+
+	static constexpr float dot(quat const& lhs, quat const& rhs);
+
+	// The inverse rotation of a unit quaternion
+	constexpr quat conjugate() const;
+	constexpr quat normalize() const;
+};
+
+constexpr quat operator-(quat const& q);
+constexpr quat operator*(quat const& lhs, quat const& rhs);
+constexpr vec3 operator*(quat const& lhs, vec3 const& rhs);
+
+// Both take the shorter arc. nlerp is cheaper and its speed varies slightly over t,
+// slerp keeps a constant angular speed and falls back to nlerp for nearly equal rotations.
+quat nlerp(quat const& a, quat const& b, float t);
+quat slerp(quat const& a, quat const& b, float t);
+
+// Bit for bit the matrix mat4::rotate builds for the same rotation
+constexpr mat4 to_mat4(quat const& q);
+
+// mat4::scale(scale) * to_mat4(rotation) * mat4::translate(translation) without the products.
+// The batch works on four objects at a time with SSE, the results match the single version.
+constexpr mat4 compose_transform(vec3 const& translation, quat const& rotation, vec3 const& scale);
+void compose_transforms(const vec3* translations, const quat* rotations, const vec3* scales, mat4* out, size_t count);
+
+#include "quat.inl"
+
+#endif // QUAT_H_
@@ -0,0 +1,184 @@
+#include "quat.h"
+
+#include <math.h>
+
+inline constexpr quat::quat(float x, float y, float z, float w) :
+	x(x), y(y), z(z), w(w)
+{
+}
+
+inline constexpr quat quat::identity = quat(0.0f, 0.0f, 0.0f, 1.0f);
+
+inline constexpr quat quat::rotate(float x, float y, float z, float angle)
+{
+	float s = MAT4_RUNTIME() ? sinf(angle / 2.0f) : constexprSin(angle / 2.0f);
+	float c = MAT4_RUNTIME() ? cosf(angle / 2.0f) : constexprCos(angle / 2.0f);
+	return quat(x * s, y * s, z * s, c);
+}
+
+inline constexpr float quat::dot(quat const& lhs, quat const& rhs)
+{
+	return lhs.x*rhs.x + lhs.y*rhs.y + lhs.z*rhs.z + lhs.w*rhs.w;
+}
+
+inline constexpr quat quat::conjugate() const
+{
+	return quat(-x, -y, -z, w);
+}
+
+inline constexpr quat quat::normalize() const
+{
+	float length = MAT4_RUNTIME() ? sqrtf(dot(*this, *this)) : constexprSqrt(dot(*this, *this));
+	return quat(x/length, y/length, z/length, w/length);
+}
+
+inline constexpr quat operator-(quat const& q)
+{
+	return quat(-q.x, -q.y, -q.z, -q.w);
+}
+
+inline constexpr quat operator*(quat const& lhs, quat const& rhs)
+{
+	return quat
+	(
+		lhs.w*rhs.x + lhs.x*rhs.w + lhs.y*rhs.z - lhs.z*rhs.y,
+		lhs.w*rhs.y - lhs.x*rhs.z + lhs.y*rhs.w + lhs.z*rhs.x,
+		lhs.w*rhs.z + lhs.x*rhs.y - lhs.y*rhs.x + lhs.z*rhs.w,
+		lhs.w*rhs.w - lhs.x*rhs.x - lhs.y*rhs.y - lhs.z*rhs.z
+	);
+}
+
+// v + w t + u x t with t = 2 u x v, u the vector part
+inline constexpr vec3 operator*(quat const& lhs, vec3 const& rhs)
+{
+	vec3 u(lhs.x, lhs.y, lhs.z);
+	vec3 t = vec3::cross(u, rhs) * 2.0f;
+	return rhs + t * lhs.w + vec3::cross(u, t);
+}
+
+inline quat nlerp(quat const& a, quat const& b, float t)
+{
+	quat to = quat::dot(a, b) < 0.0f ? -b : b;
+	return quat(a.x + (to.x - a.x)*t, a.y + (to.y - a.y)*t, a.z + (to.z - a.z)*t, a.w + (to.w - a.w)*t).normalize();
+}
+
+inline quat slerp(quat const& a, quat const& b, float t)
+{
+	float cosAngle = quat::dot(a, b);
+	quat to = cosAngle < 0.0f ? -b : b;
+	cosAngle = fabsf(cosAngle);
+
+	// sin(angle) is too small to divide by, the arc is a straight line at this precision
+	if (cosAngle > 0.9995f) return nlerp(a, to, t);
+
+	float angle = acosf(cosAngle);
+	float sinAngle = sinf(angle);
+	float wa = sinf((1.0f - t)*angle) / sinAngle;
+	float wb = sinf(t*angle) / sinAngle;
+	return quat(a.x*wa + to.x*wb, a.y*wa + to.y*wb, a.z*wa + to.z*wb, a.w*wa + to.w*wb);
+}
+
+inline constexpr mat4 to_mat4(quat const& q)
+{
+	return compose_transform(vec3(0.0f, 0.0f, 0.0f), q, vec3(1.0f, 1.0f, 1.0f));
+}
+
+// The rotation terms are the ones mat4::rotate uses, each row then scaled
+inline constexpr mat4 compose_transform(vec3 const& translation, quat const& rotation, vec3 const& scale)
+{
+	float xx = rotation.x * rotation.x;
+	float xy = rotation.x * rotation.y;
+	float xz = rotation.x * rotation.z;
+	float xw = rotation.x * rotation.w;
+
+	float yy = rotation.y * rotation.y;
+	float yz = rotation.y * rotation.z;
+	float yw = rotation.y * rotation.w;
+
+	float zz = rotation.z * rotation.z;
+	float zw = rotation.z * rotation.w;
+
+	return mat4
+	{
+		(1.0f - 2.0f * (yy + zz)) * scale.x, (2.0f * (xy - zw)) * scale.x, (2.0f * (xz + yw)) * scale.x, 0.0f,
+		(2.0f * (xy + zw)) * scale.y, (1.0f - 2.0f * (xx + zz)) * scale.y, (2.0f * (yz - xw)) * scale.y, 0.0f,
+		(2.0f * (xz - yw)) * scale.z, (2.0f * (yz + xw)) * scale.z, (1.0f - 2.0f * (xx + yy)) * scale.z, 0.0f,
+		translation.x, translation.y, translation.z, 1.0f
+	};
+}
+
+// Four objects per step with SSE: the quaternions are transposed into one register per component, the rotation
+// terms are computed for all four at once and transposed back into matrix rows
+inline void compose_transforms(const vec3* translations, const quat* rotations, const vec3* scales, mat4* out, size_t count)
+{
+	size_t batched = 0;
+#if defined(MAT4_SIMD_SSE)
+	batched = count & ~(size_t)3;
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 two = _mm_set1_ps(2.0f);
+	for (size_t i = 0; i < batched; i += 4)
+	{
+		__m128 x = _mm_loadu_ps(&rotations[i + 0].x);
+		__m128 y = _mm_loadu_ps(&rotations[i + 1].x);
+		__m128 z = _mm_loadu_ps(&rotations[i + 2].x);
+		__m128 w = _mm_loadu_ps(&rotations[i + 3].x);
+		_MM_TRANSPOSE4_PS(x, y, z, w);
+		__m128 sx = _mm_setr_ps(scales[i].x, scales[i + 1].x, scales[i + 2].x, scales[i + 3].x);
+		__m128 sy = _mm_setr_ps(scales[i].y, scales[i + 1].y, scales[i + 2].y, scales[i + 3].y);
+		__m128 sz = _mm_setr_ps(scales[i].z, scales[i + 1].z, scales[i + 2].z, scales[i + 3].z);
+
+		__m128 xx = _mm_mul_ps(x, x);
+		__m128 xy = _mm_mul_ps(x, y);
+		__m128 xz = _mm_mul_ps(x, z);
+		__m128 xw = _mm_mul_ps(x, w);
+
+		__m128 yy = _mm_mul_ps(y, y);
+		__m128 yz = _mm_mul_ps(y, z);
+		__m128 yw = _mm_mul_ps(y, w);
+
+		__m128 zz = _mm_mul_ps(z, z);
+		__m128 zw = _mm_mul_ps(z, w);
+
+		__m128 r0 = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx);
+		__m128 r1 = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, zw)), sx);
+		__m128 r2 = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, yw)), sx);
+		__m128 r3 = _mm_setzero_ps();
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+		__m128 u0 = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, zw)), sy);
+		__m128 u1 = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy);
+		__m128 u2 = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, xw)), sy);
+		__m128 u3 = _mm_setzero_ps();
+		_MM_TRANSPOSE4_PS(u0, u1, u2, u3);
+
+		__m128 f0 = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, yw)), sz);
+		__m128 f1 = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, xw)), sz);
+		__m128 f2 = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz);
+		__m128 f3 = _mm_setzero_ps();
+		_MM_TRANSPOSE4_PS(f0, f1, f2, f3);
+
+		// Row by row, each register holds one row of one matrix
+		__m128 rows[12] = { r0, u0, f0, r1, u1, f1, r2, u2, f2, r3, u3, f3 };
+		for (int k = 0; k < 4; ++k)
+		{
+			const vec3& t = translations[i + k];
+			_mm_storeu_ps(&out[i + k].m[0], rows[k*3 + 0]);
+			_mm_storeu_ps(&out[i + k].m[4], rows[k*3 + 1]);
+			_mm_storeu_ps(&out[i + k].m[8], rows[k*3 + 2]);
+			_mm_storeu_ps(&out[i + k].m[12], _mm_setr_ps(t.x, t.y, t.z, 1.0f));
+		}
+	}
+#endif
+	for (size_t i = batched; i < count; ++i)
+	{
+		out[i] = compose_transform(translations[i], rotations[i], scales[i]);
+	}
+}
+
+// Compile-time checks
+static_assert(to_mat4(quat::rotate(0.0f, 0.0f, 1.0f, 1.57079637f)).m[1] == mat4::rotate(0.0f, 0.0f, 1.0f, 1.57079637f).m[1]
+			  && to_mat4(quat::rotate(0.0f, 0.0f, 1.0f, 1.57079637f)).m[4] == mat4::rotate(0.0f, 0.0f, 1.0f, 1.57079637f).m[4], "to_mat4");
+static_assert((quat::rotate(0.0f, 1.0f, 0.0f, 0.5f) * quat::rotate(0.0f, 1.0f, 0.0f, 0.5f)).y == quat::rotate(0.0f, 1.0f, 0.0f, 1.0f).y, "quat product");
+static_assert((quat::rotate(0.0f, 0.0f, 1.0f, 3.14159274f) * vec3(1.0f, 0.0f, 0.0f)).x == -1.0f, "quat rotation");
+static_assert(compose_transform(vec3(1.0f, 2.0f, 3.0f), quat::identity, vec3(2.0f, 3.0f, 4.0f)).m[10] == 4.0f
+			  && compose_transform(vec3(1.0f, 2.0f, 3.0f), quat::identity, vec3(2.0f, 3.0f, 4.0f)).m[13] == 2.0f, "compose_transform");
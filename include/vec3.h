@@ -14,8 +14,8 @@ struct vec3
 	// -- Explicit basic constructors --
 	constexpr vec3(float x, float y, float z);
 
-	static vec3 cross(vec3 const& lhs, vec3 const& rhs);
-	static float dot(vec3 const& lhs, vec3 const& rhs);
+	static constexpr vec3 cross(vec3 const& lhs, vec3 const& rhs);
+	static constexpr float dot(vec3 const& lhs, vec3 const& rhs);
 
 	vec3 normalize() const;
 };
@@ -7,7 +7,7 @@ inline constexpr vec3::vec3(float x, float y, float z) :
 {
 }
 
-inline vec3 vec3::cross(vec3 const& lhs, vec3 const& rhs)
+inline constexpr vec3 vec3::cross(vec3 const& lhs, vec3 const& rhs)
 {
 	return vec3
 	(
@@ -17,7 +17,7 @@ inline vec3 vec3::cross(vec3 const& lhs, vec3 const& rhs)
 	);
 }
 
-inline float vec3::dot(vec3 const& lhs, vec3 const& rhs)
+inline constexpr float vec3::dot(vec3 const& lhs, vec3 const& rhs)
 {
 	return lhs.x*rhs.x + lhs.y*rhs.y + lhs.z*rhs.z;
 }
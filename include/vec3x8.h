@@ -0,0 +1,67 @@
+#ifndef VEC3X8_H_
+#define VEC3X8_H_
+
+#include <stddef.h>
+#include <vector>
+
+#include "vec3.h"
+#include "float8.h"
+
+// Eight vec3 in structure of arrays layout, one float8 per component.
+// Loads and stores transpose to and from the 12 byte vec3 arrays the rest of the code keeps.
+struct vec3x8
+{
+	float8 x;
+	float8 y;
+	float8 z;
+
+	// -- Implicit basic constructors --
+	vec3x8() = default;
+	vec3x8(vec3x8 const& v) = default;
+
+	// -- Explicit basic constructors --
+	vec3x8(float8 const& x, float8 const& y, float8 const& z);
+	explicit vec3x8(vec3 const& v);
+
+	// The partial forms touch only count vectors and zero the other lanes, see the masked reductions below
+	static vec3x8 load(const vec3* p);
+	static vec3x8 load(const vec3* p, int count);
+	static vec3x8 load(std::vector<vec3> const& v, size_t first);
+	void store(vec3* p) const;
+	void store(vec3* p, int count) const;
+	void store(vec3* p, mask8 const& m) const;
+	void store(std::vector<vec3>& v, size_t first) const;
+
+	static vec3x8 cross(vec3x8 const& lhs, vec3x8 const& rhs);
+	static float8 dot(vec3x8 const& lhs, vec3x8 const& rhs);
+
+	float8 length() const;
+	// rsqrt based, zero vectors come out as NaN like vec3::normalize()
+	vec3x8 normalize() const;
+
+	vec3 operator[](int i) const;
+};
+
+vec3x8 operator-(vec3x8 const& v);
+vec3x8 operator+(vec3x8 const& lhs, vec3x8 const& rhs);
+vec3x8 operator-(vec3x8 const& lhs, vec3x8 const& rhs);
+vec3x8 operator*(vec3x8 const& lhs, vec3x8 const& rhs);
+
+vec3x8 operator*(vec3x8 const& lhs, float8 const& rhs);
+vec3x8 operator/(vec3x8 const& lhs, float8 const& rhs);
+
+vec3x8 min(vec3x8 const& lhs, vec3x8 const& rhs);
+vec3x8 max(vec3x8 const& lhs, vec3x8 const& rhs);
+vec3x8 select(mask8 const& m, vec3x8 const& a, vec3x8 const& b);
+
+// Component-wise over the eight lanes
+vec3 hsum(vec3x8 const& v);
+vec3 hmin(vec3x8 const& v);
+vec3 hmax(vec3x8 const& v);
+vec3 hsum(vec3x8 const& v, mask8 const& m);
+vec3 hmin(vec3x8 const& v, mask8 const& m);
+vec3 hmax(vec3x8 const& v, mask8 const& m);
+
+#include "vec3x8.inl"
+
+#endif // VEC3X8_H_
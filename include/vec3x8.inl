@@ -0,0 +1,184 @@
+#include "vec3x8.h"
+
+#include <algorithm>
+
+inline vec3x8::vec3x8(float8 const& x, float8 const& y, float8 const& z) :
+	x(x), y(y), z(z)
+{
+}
+
+inline vec3x8::vec3x8(vec3 const& v) :
+	x(v.x), y(v.y), z(v.z)
+{
+}
+
+inline vec3x8 vec3x8::load(const vec3* p)
+{
+	alignas(32) float x[8];
+	alignas(32) float y[8];
+	alignas(32) float z[8];
+	for (int i = 0; i < 8; ++i)
+	{
+		x[i] = p[i].x;
+		y[i] = p[i].y;
+		z[i] = p[i].z;
+	}
+	return vec3x8(float8::load(x), float8::load(y), float8::load(z));
+}
+
+inline vec3x8 vec3x8::load(const vec3* p, int count)
+{
+	vec3 values[8];
+	std::copy(p, p + count, values);
+	return load(values);
+}
+
+inline vec3x8 vec3x8::load(std::vector<vec3> const& v, size_t first)
+{
+	size_t count = std::min<size_t>(8, v.size() - first);
+	return count == 8 ? load(&v[first]) : load(&v[first], (int)count);
+}
+
+inline void vec3x8::store(vec3* p) const
+{
+	alignas(32) float xs[8];
+	alignas(32) float ys[8];
+	alignas(32) float zs[8];
+	x.store(xs);
+	y.store(ys);
+	z.store(zs);
+	for (int i = 0; i < 8; ++i)
+	{
+		p[i] = vec3(xs[i], ys[i], zs[i]);
+	}
+}
+
+inline void vec3x8::store(vec3* p, int count) const
+{
+	vec3 values[8];
+	store(values);
+	std::copy(values, values + count, p);
+}
+
+inline void vec3x8::store(vec3* p, mask8 const& m) const
+{
+	vec3 values[8];
+	store(values);
+	int bits = m.bits();
+	for (int i = 0; i < 8; ++i)
+	{
+		if (bits & (1 << i)) p[i] = values[i];
+	}
+}
+
+inline void vec3x8::store(std::vector<vec3>& v, size_t first) const
+{
+	size_t count = std::min<size_t>(8, v.size() - first);
+	if (count == 8) store(&v[first]);
+	else store(&v[first], (int)count);
+}
+
+inline vec3x8 vec3x8::cross(vec3x8 const& lhs, vec3x8 const& rhs)
+{
+	return vec3x8
+	(
+		lhs.y*rhs.z - lhs.z*rhs.y,
+		lhs.z*rhs.x - lhs.x*rhs.z,
+		lhs.x*rhs.y - lhs.y*rhs.x
+	);
+}
+
+inline float8 vec3x8::dot(vec3x8 const& lhs, vec3x8 const& rhs)
+{
+	return lhs.x*rhs.x + lhs.y*rhs.y + lhs.z*rhs.z;
+}
+
+inline float8 vec3x8::length() const
+{
+	return sqrt(dot(*this, *this));
+}
+
+inline vec3x8 vec3x8::normalize() const
+{
+	return *this*rsqrt(dot(*this, *this));
+}
+
+inline vec3 vec3x8::operator[](int i) const
+{
+	return vec3(x[i], y[i], z[i]);
+}
+
+inline vec3x8 operator-(vec3x8 const& v)
+{
+	return vec3x8(-v.x, -v.y, -v.z);
+}
+
+inline vec3x8 operator+(vec3x8 const& lhs, vec3x8 const& rhs)
+{
+	return vec3x8(lhs.x + rhs.x, lhs.y + rhs.y, lhs.z + rhs.z);
+}
+
+inline vec3x8 operator-(vec3x8 const& lhs, vec3x8 const& rhs)
+{
+	return vec3x8(lhs.x - rhs.x, lhs.y - rhs.y, lhs.z - rhs.z);
+}
+
+inline vec3x8 operator*(vec3x8 const& lhs, vec3x8 const& rhs)
+{
+	return vec3x8(lhs.x * rhs.x, lhs.y * rhs.y, lhs.z * rhs.z);
+}
+
+inline vec3x8 operator*(vec3x8 const& lhs, float8 const& rhs)
+{
+	return vec3x8(lhs.x * rhs, lhs.y * rhs, lhs.z * rhs);
+}
+
+inline vec3x8 operator/(vec3x8 const& lhs, float8 const& rhs)
+{
+	return vec3x8(lhs.x / rhs, lhs.y / rhs, lhs.z / rhs);
+}
+
+inline vec3x8 min(vec3x8 const& lhs, vec3x8 const& rhs)
+{
+	return vec3x8(min(lhs.x, rhs.x), min(lhs.y, rhs.y), min(lhs.z, rhs.z));
+}
+
+inline vec3x8 max(vec3x8 const& lhs, vec3x8 const& rhs)
+{
+	return vec3x8(max(lhs.x, rhs.x), max(lhs.y, rhs.y), max(lhs.z, rhs.z));
+}
+
+inline vec3x8 select(mask8 const& m, vec3x8 const& a, vec3x8 const& b)
+{
+	return vec3x8(select(m, a.x, b.x), select(m, a.y, b.y), select(m, a.z, b.z));
+}
+
+inline vec3 hsum(vec3x8 const& v)
+{
+	return vec3(hsum(v.x), hsum(v.y), hsum(v.z));
+}
+
+inline vec3 hmin(vec3x8 const& v)
+{
+	return vec3(hmin(v.x), hmin(v.y), hmin(v.z));
+}
+
+inline vec3 hmax(vec3x8 const& v)
+{
+	return vec3(hmax(v.x), hmax(v.y), hmax(v.z));
+}
+
+inline vec3 hsum(vec3x8 const& v, mask8 const& m)
+{
+	return vec3(hsum(v.x, m), hsum(v.y, m), hsum(v.z, m));
+}
+
+inline vec3 hmin(vec3x8 const& v, mask8 const& m)
+{
+	return vec3(hmin(v.x, m), hmin(v.y, m), hmin(v.z, m));
+}
+
+inline vec3 hmax(vec3x8 const& v, mask8 const& m)
+{
+	return vec3(hmax(v.x, m), hmax(v.y, m), hmax(v.z, m));
+}
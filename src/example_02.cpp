@@ -5,6 +5,7 @@
 
 #include "vec3.h"
 #include "mat4.h"
+#include "quat.h"
 
 const float PI = 3.14159265358979f;
 
@@ -79,6 +80,12 @@ GLint gViewLoc;
 
 GLuint gCubeQuery[400] = {0};
 
+// Cube placements, composed into world matrices once per update
+vec3 gCubePosition[400];
+quat gCubeRotation[400];
+vec3 gCubeScale[400];
+mat4 gCubeWorld[400];
+
 auto init() -> bool
 {
 	//std::cout << "init " << gWidth << " " << gHeight << std::endl;
@@ -117,6 +124,16 @@ auto init() -> bool
 
 	glGenQueries(400, gCubeQuery);
 
+	for(int i=0; i<20; i++)
+	{
+		for(int j=0; j<20; j++)
+		{
+			gCubePosition[i*20 + j] = vec3(static_cast<float>(j - 10), 0.0f, static_cast<float>(10 - i));
+			gCubeScale[i*20 + j] = vec3(0.6f, 0.6f, 0.6f);
+		}
+	}
+	compose_transforms(gCubePosition, gCubeRotation, gCubeScale, gCubeWorld, 400);
+
 	on_size();
 
 	return 0;
@@ -155,6 +172,13 @@ auto on_mouse(double xpos, double ypos) -> void
 auto update() -> void
 {
 	gAngle++;
+
+	quat rotation = quat::rotate(0.0f, 1.0f, 0.0f, gAngle * (PI/180.0f));
+	for(int i=0; i<400; i++)
+	{
+		gCubeRotation[i] = rotation;
+	}
+	compose_transforms(gCubePosition, gCubeRotation, gCubeScale, gCubeWorld, 400);
 }
 
 auto draw() -> void
@@ -175,8 +199,7 @@ auto draw() -> void
 	{
 		for(int j=0; j<20; j++)
 		{
-			mat4 world = mat4::scale(0.6f, 0.6f, 0.6f) * mat4::rotate(0.0f, 1.0f, 0.0f, gAngle * (PI/180.0f)) * mat4::translate(static_cast<float>(j - 10), 0.0f, static_cast<float>(10 - i));
-			glUniformMatrix4fv(gWorldLoc, 1, false, world.m);
+			glUniformMatrix4fv(gWorldLoc, 1, false, gCubeWorld[i*20 + j].m);
 			GL_CHECK(glBeginQuery(GL_ANY_SAMPLES_PASSED, gCubeQuery[i*20 + j]));
 				glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
 			GL_CHECK(glEndQuery(GL_ANY_SAMPLES_PASSED));
@@ -202,8 +225,7 @@ auto draw() -> void
 			GL_CHECK(glGetQueryObjectuiv(gCubeQuery[i*20 + j], GL_QUERY_RESULT, &queryResult));
 			if (queryResult == GL_FALSE) continue;
 
-			mat4 world = mat4::scale(0.6f, 0.6f, 0.6f) * mat4::rotate(0.0f, 1.0f, 0.0f, gAngle * (PI/180.0f)) * mat4::translate(static_cast<float>(j - 10), 0.0f, static_cast<float>(10 - i));
-			glUniformMatrix4fv(gWorldLoc, 1, false, world.m);
+			glUniformMatrix4fv(gWorldLoc, 1, false, gCubeWorld[i*20 + j].m);
 			glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
 		}
 	}
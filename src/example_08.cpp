@@ -22,6 +22,7 @@ layout (location = 2) in vec3 aNormal;
 uniform mat4 world;
 uniform mat4 view;
 uniform mat4 proj;
+uniform mat4 normalWorld;
 
 out vec3 vFragPos;
 out vec2 vUV;
@@ -31,7 +32,7 @@ void main()
 {
 	vFragPos = vec3(world * vec4(aPos, 1.0));
 	vUV = aUV;
-	vNormal = mat3(transpose(inverse(world))) * aNormal;
+	vNormal = mat3(normalWorld) * aNormal;
 	gl_Position = proj * view * world * vec4(aPos, 1.0);
 }
 )";
@@ -148,6 +149,7 @@ void on_size()
 	GLint worldLoc = glGetUniformLocation(gProgram, "world");
 	GLint viewLoc = glGetUniformLocation(gProgram, "view");
 	GLint projLoc = glGetUniformLocation(gProgram, "proj");
+	GLint normalWorldLoc = glGetUniformLocation(gProgram, "normalWorld");
 
 	mat4 world = mat4::identity;
 	mat4 view = mat4::lookAt(vec3(0.0f, 3.0f, 3.0f), vec3(0.0f, 0.0f, 0.0f), vec3(0.0f, 1.0f, 0.0f));
@@ -155,6 +157,7 @@ void on_size()
 	glUniformMatrix4fv(worldLoc, 1, false, world.m);
 	glUniformMatrix4fv(viewLoc, 1, false, view.m);
 	glUniformMatrix4fv(projLoc, 1, false, proj.m);
+	glUniformMatrix4fv(normalWorldLoc, 1, false, world.normalMatrix().m);
 
 	//glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 	glEnable(GL_MULTISAMPLE);
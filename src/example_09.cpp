@@ -29,6 +29,7 @@ layout (location = 3) in vec3 aTangent;
 uniform mat4 world;
 uniform mat4 view;
 uniform mat4 proj;
+uniform mat4 normalWorld;
 
 out vec3 vFragPos;
 out vec2 vUV;
@@ -41,7 +42,7 @@ void main()
 	vFragPos = vec3(world * vec4(aPos, 1.0));
 	vUV = aUV;
 
-	mat3 normalMatrix = transpose(inverse(mat3(world)));
+	mat3 normalMatrix = mat3(normalWorld);
 	vec3 N = normalize(normalMatrix * aNormal);
 	vec3 T = normalize(normalMatrix * aTangent);
 	T = normalize(T - dot(T, N) * N);
@@ -201,6 +202,7 @@ void on_size()
 	GLint worldLoc = glGetUniformLocation(gProgram, "world");
 	GLint viewLoc = glGetUniformLocation(gProgram, "view");
 	GLint projLoc = glGetUniformLocation(gProgram, "proj");
+	GLint normalWorldLoc = glGetUniformLocation(gProgram, "normalWorld");
 
 	mat4 world = mat4::identity;
 	mat4 view = mat4::lookAt(vec3(0.0f, 3.0f, 3.0f), vec3(0.0f, 0.0f, 0.0f), vec3(0.0f, 1.0f, 0.0f));
@@ -208,6 +210,7 @@ void on_size()
 	glUniformMatrix4fv(worldLoc, 1, false, world.m);
 	glUniformMatrix4fv(viewLoc, 1, false, view.m);
 	glUniformMatrix4fv(projLoc, 1, false, proj.m);
+	glUniformMatrix4fv(normalWorldLoc, 1, false, world.normalMatrix().m);
 }
 
 void on_key(int key, int action)
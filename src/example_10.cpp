@@ -10,6 +10,7 @@
 
 #include "vec3.h"
 #include "mat4.h"
+#include "quat.h"
 
 #include "nanojpeg.h"
 
@@ -294,8 +295,7 @@ auto update() -> void
 	gRotX += 0.05 * (gTargetRotX - gRotX);
 	gRotY += 0.05 * (gTargetRotY - gRotY);
 
-	vec4 eyePos = mat4::rotate(0.0f, 1.0f, 0.0f, -gRotX) * mat4::rotate(1.0f, 0.0f, 0.0f, -gRotY) * vec4(0.0f, 0.0f, 3.0f, 1.0f);
-	gEyePos = vec3(eyePos.x, eyePos.y, eyePos.z);
+	gEyePos = (quat::rotate(0.0f, 1.0f, 0.0f, -gRotX) * quat::rotate(1.0f, 0.0f, 0.0f, -gRotY)) * vec3(0.0f, 0.0f, 3.0f);
 	gView = mat4::lookAt(gEyePos, vec3(0.0f, 0.0f, 0.0f), vec3(0.0f, 1.0f, 0.0f));
 
 }
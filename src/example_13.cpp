@@ -11,6 +11,7 @@
 
 #include "vec3.h"
 #include "mat4.h"
+#include "quat.h"
 
 #include "nanojpeg.h"
 
@@ -27,6 +28,7 @@ layout (location = 3) in vec3 aTangent;
 uniform mat4 world;
 uniform mat4 view;
 uniform mat4 proj;
+uniform mat4 normalWorld;
 
 out vec3 vFragPos;
 out vec2 vUV;
@@ -38,7 +40,7 @@ void main()
 	vFragPos = vec3(world * vec4(aPos, 1.0));
 	vUV = aUV;
 
-	mat3 normalMatrix = transpose(inverse(mat3(world)));
+	mat3 normalMatrix = mat3(normalWorld);
 	vNormal = normalize(normalMatrix * aNormal);
 	vec3 T = normalize(normalMatrix * aTangent);
 	T = normalize(T - dot(T, vNormal) * vNormal);
@@ -167,6 +169,7 @@ GLuint gProgram;
 GLuint gVAO;
 GLint gWorldLoc;
 GLint gViewLoc;
+GLint gNormalWorldLoc;
 GLint gEyePosLoc;
 
 GLsizei gIndexCount;
@@ -184,6 +187,7 @@ vec3 gEyePos;
 mat4 gView;
 
 std::vector<mat4> gWorls;
+std::vector<mat4> gNormalWorlds; // normal matrix of each world, computed once instead of per vertex
 
 GLuint gFrameBuffer;
 GLuint gPositionTexture;
@@ -211,6 +215,7 @@ auto init() -> bool
 	for (size_t i = 0; i < 100; i++)
 	{
 		gWorls.push_back(mat4::translate(ball_pos_real_dist(re), ball_pos_real_dist(re), ball_pos_real_dist(re)));
+		gNormalWorlds.push_back(gWorls.back().normalMatrix());
 	}
 
 	{
@@ -389,6 +394,7 @@ auto init() -> bool
 	glUseProgram(gProgram);
 	gWorldLoc = glGetUniformLocation(gProgram, "world");
 	gViewLoc = glGetUniformLocation(gProgram, "view");
+	gNormalWorldLoc = glGetUniformLocation(gProgram, "normalWorld");
 	glUniform1i(glGetUniformLocation(gProgram, "diffuseMap"), 0);
 	glUniform1i(glGetUniformLocation(gProgram, "normalMap"), 1);
 	glActiveTexture(GL_TEXTURE0);
@@ -483,8 +489,7 @@ auto update() -> void
 	gRotX += 0.05 * (gTargetRotX - gRotX);
 	gRotY += 0.05 * (gTargetRotY - gRotY);
 
-	vec4 eyePos = mat4::rotate(0.0f, 1.0f, 0.0f, -gRotX) * mat4::rotate(1.0f, 0.0f, 0.0f, -gRotY) * vec4(0.0f, 0.0f, 30.0f, 1.0f);
-	gEyePos = vec3(eyePos.x, eyePos.y, eyePos.z);
+	gEyePos = (quat::rotate(0.0f, 1.0f, 0.0f, -gRotX) * quat::rotate(1.0f, 0.0f, 0.0f, -gRotY)) * vec3(0.0f, 0.0f, 30.0f);
 	gView = mat4::lookAt(gEyePos, vec3(0.0f, 0.0f, 0.0f), vec3(0.0f, 1.0f, 0.0f));
 }
 
@@ -502,6 +507,7 @@ auto draw() -> void
 		for (size_t i = 0; i < gWorls.size(); i++)
 		{
 			glUniformMatrix4fv(gWorldLoc, 1, false, gWorls[i].m);
+			glUniformMatrix4fv(gNormalWorldLoc, 1, false, gNormalWorlds[i].m);
 			glDrawElements(GL_TRIANGLES, gIndexCount, GL_UNSIGNED_INT, 0);
 		}
 
@@ -14,8 +14,9 @@
 
 #include "vec3.h"
 #include "mat4.h"
+#include "quat.h"
 
-const float PI = 3.14159265358979f;
+constexpr float PI = 3.14159265358979f;
 
 float cubeVertices[] =
 {
@@ -1022,7 +1023,8 @@ auto init() -> bool
 	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, 512, 512);
 	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, captureRBO);
 
-	mat4 captureProj = mat4::perspective(90.0f * (PI/180.0f), 1.0f, 0.1f, 10.0f);
+	// Fixed cubemap face camera, built by the compiler
+	constexpr mat4 captureProj = mat4::perspective(90.0f * (PI/180.0f), 1.0f, 0.1f, 10.0f);
 	glUseProgram(equirectangularProgram);
 	GLint equirectangularViewLoc = glGetUniformLocation(equirectangularProgram, "view");
 	glUniformMatrix4fv(glGetUniformLocation(equirectangularProgram, "proj"), 1, false, captureProj.m);
@@ -1033,7 +1035,7 @@ auto init() -> bool
 	glViewport(0, 0, 512, 512);
 	glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
 	glBindVertexArray(gCubeVAO);
-	mat4 captureViews[] =
+	constexpr mat4 captureViews[] =
 	{
 		mat4::lookAt(vec3(0.0f, 0.0f, 0.0f), vec3(1.0f, 0.0f, 0.0f), vec3(0.0f, -1.0f,  0.0f)),
 		mat4::lookAt(vec3(0.0f, 0.0f, 0.0f), vec3(-1.0f,  0.0f,  0.0f), vec3(0.0f, -1.0f,  0.0f)),
@@ -1218,8 +1220,7 @@ auto update() -> void
 	gRotX += 0.05 * (gTargetRotX - gRotX);
 	gRotY += 0.05 * (gTargetRotY - gRotY);
 
-	vec4 eyePos = mat4::rotate(0.0f, 1.0f, 0.0f, -gRotX) * mat4::rotate(1.0f, 0.0f, 0.0f, -gRotY) * vec4(0.0f, 0.0f, 10.0f, 0.0f);
-	gEyePos = vec3(eyePos.x, eyePos.y, eyePos.z);
+	gEyePos = (quat::rotate(0.0f, 1.0f, 0.0f, -gRotX) * quat::rotate(1.0f, 0.0f, 0.0f, -gRotY)) * vec3(0.0f, 0.0f, 10.0f);
 	gView = mat4::lookAt(gEyePos, vec3(0.0f, 0.0f, 0.0f), vec3(0.0f, 1.0f, 0.0f));
 }
 
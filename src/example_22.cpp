@@ -5,6 +5,7 @@
 
 #include "vec3.h"
 #include "mat4.h"
+#include "quat.h"
 
 const float PI = 3.14159265358979f;
 
@@ -246,8 +247,8 @@ void update()
 	g_rotX += 0.05 * (g_targetRotX - g_rotX);
 	g_rotY += 0.05 * (g_targetRotY - g_rotY);
 
-	vec4 eyePos = mat4::rotate(0.0f, 1.0f, 0.0f, -g_rotX) * mat4::rotate(1.0f, 0.0f, 0.0f, -g_rotY) * vec4(0.0f, 0.0f, g_eyePosZ, 0.0f);
-	g_view = mat4::lookAt(vec3(eyePos.x, eyePos.y, eyePos.z), vec3(0.0f, 0.0f, 0.0f), vec3(0.0f, 1.0f, 0.0f));
+	vec3 eyePos = (quat::rotate(0.0f, 1.0f, 0.0f, -g_rotX) * quat::rotate(1.0f, 0.0f, 0.0f, -g_rotY)) * vec3(0.0f, 0.0f, g_eyePosZ);
+	g_view = mat4::lookAt(eyePos, vec3(0.0f, 0.0f, 0.0f), vec3(0.0f, 1.0f, 0.0f));
 }
 
 void draw()
@@ -4,7 +4,15 @@
 #include "entry.h"
 
 #include <vector>
-#include <random>
+#include <deque>
+#include <cstdint>
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <cstring>
+#include <string>
+#include <fstream>
+#include <unordered_map>
 
 #include "vec3.h"
 #include "vec4.h"
@@ -15,14 +23,82 @@
 using namespace std::chrono;
 
 #include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define TRACER_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_AVX2 __attribute__((target("avx2,fma")))
+#else
+#define TARGET_AVX2
+#endif
 
 #define MAX_SAMPLES_PER_PIXEL 200
 #define RAY_DEPTH 6
+#define RUSSIAN_ROULETTE_DEPTH 3
 #define SAMPLES_PER_PIXEL_NEXT_LEVEL 20
 #define MAX_LEVEL 4
+#define TILE_SIZE 16
+
+#define NOISE_THRESHOLD 0.01f
+#define ADAPTIVE_MIN_SAMPLES 16
+#define ADAPTIVE_MAX_BATCH 4
+
+#define REPROJECTION_TOLERANCE 0.02f
+#define REPROJECTION_MAX_HISTORY 32
+
+#define PASS_SAMPLE 0
+#define PASS_FIRST_HIT 1
+#define PASS_DENOISE_INPUT 2
+#define PASS_DENOISE 3
+#define PASS_RESOLVE 4
+#define PASS_RESOLVE_DENOISED 5
+
+#define PIXEL_ORDER_ROWS 0
+#define PIXEL_ORDER_MORTON 1
+#define PIXEL_ORDER_HILBERT 2
+
+#define TONEMAP_NONE 0
+#define TONEMAP_REINHARD 1
+#define TONEMAP_ACES 2
+
+#define DENOISE_ITERATIONS 5
+#define DENOISE_SIGMA_LUMINANCE 4.0f
+#define DENOISE_SIGMA_DEPTH 0.02f
+#define DENOISE_NORMAL_POWER 32
+#define DENOISE_EMPTY -2 // guide material of pixels without samples
+
+#define PBO_COUNT 3
+#define FRAME_FRESH 4
+
+#define BVH_BINS 16
+#define BVH_MAX_LEAF_SIZE 4
+#define BVH_STACK_SIZE 64
+#define BVH_MAX_DEPTH (BVH_STACK_SIZE - 1) // deeper nodes become leaves, so no traversal stack can overflow
+#define BVH_PARALLEL_TASK 4096 // smaller subtrees are built on the thread that split them
+#define BVH_PARALLEL_BINNING 65536 // larger nodes bin and bound their primitives on the free cores
+#define BVH_REFIT_DEGRADATION 1.5f // rebuild once refitting made the SAH cost this much worse than the last build
+#define ANIMATION_MAX_STEP 0.1f // seconds, a stalled pass does not make objects jump
+
+#define MATERIAL_LAMBERTIAN 1
+#define MATERIAL_METAL 2
+
+#define SIMD_NONE 0
+#define SIMD_SSE 1
+#define SIMD_AVX2 2
 
 #define M_PI  3.1415926536f
 #define M_2PI 6.2831853072f
+#define M_INV_PI 0.3183098862f
 
 const char * renderVertexShaderSource = R"(
 #version 410 core
@@ -89,6 +165,7 @@ vec4 smartDeNoise(sampler2D tex, vec2 uv, float sigma, float kSigma, float thres
 }
 
 uniform sampler2D texture0;
+uniform int denoise;
 
 in vec2 vTexCoord;
 
@@ -96,2128 +173,145 @@ out vec4 FragColor;
 
 void main()
 {
-	// FragColor = texture(texture0, vTexCoord);
-	FragColor = smartDeNoise(texture0, vTexCoord, 2.0, 2.0, 0.08);
+	if (denoise == 0)
+	{
+		// Already denoised on the CPU
+		FragColor = texture(texture0, vTexCoord);
+	}
+	else
+	{
+		FragColor = smartDeNoise(texture0, vTexCoord, 2.0, 2.0, 0.08);
+	}
 }
 )";
 
-std::random_device rd;
-std::default_random_engine re(rd());
-std::uniform_real_distribution<float> two_pi_real_dist(0.0f, M_2PI);
-std::uniform_real_distribution<float> real_dist(0.0f, 1.0f);
-std::uniform_int_distribution<int> axis_int_dist(0, 2);
-std::uniform_int_distribution<int> metal_int_dist(0, 1);
-
-const std::vector<vec3> teapotVertices =
-{
-	vec3(0.4537252, 0.26190555, -0.01237479),
-	vec3(0.44752464, 0.28534314, -0.01237479),
-	vec3(0.45471805, 0.29315528, -0.01237479),
-	vec3(0.4693506, 0.28534314, -0.01237479),
-	vec3(0.48547187, 0.26190555, -0.01237479),
-	vec3(0.41928142, 0.26190555, 0.16206928),
-	vec3(0.41356108, 0.28534314, 0.15963574),
-	vec3(0.42019612, 0.29315528, 0.16245906),
-	vec3(0.43369508, 0.28534314, 0.16820285),
-	vec3(0.44856662, 0.26190555, 0.17452963),
-	vec3(0.32483658, 0.26190555, 0.30318037),
-	vec3(0.3204341, 0.28534314, 0.29877898),
-	vec3(0.3255413, 0.29315528, 0.30388507),
-	vec3(0.33592993, 0.28534314, 0.31427482),
-	vec3(0.3473762, 0.26190555, 0.32571998),
-	vec3(0.1837255, 0.26190555, 0.3976252),
-	vec3(0.18129197, 0.28534314, 0.39190486),
-	vec3(0.18411528, 0.29315528, 0.39853987),
-	vec3(0.18985796, 0.28534314, 0.41203886),
-	vec3(0.19618584, 0.26190555, 0.4269104),
-	vec3(0.009281037, 0.26190555, 0.43207008),
-	vec3(0.009281037, 0.28534314, 0.42586952),
-	vec3(0.009281037, 0.29315528, 0.43306184),
-	vec3(0.009281037, 0.28534314, 0.4476944),
-	vec3(0.009281037, 0.26190555, 0.46381566),
-	vec3(-0.1772167, 0.26190555, 0.3976252),
-	vec3(-0.16781531, 0.28534314, 0.39190486),
-	vec3(-0.16705923, 0.29315528, 0.39853987),
-	vec3(-0.17148407, 0.28534314, 0.41203886),
-	vec3(-0.17762321, 0.26190555, 0.4269104),
-	vec3(-0.3169887, 0.26190555, 0.30318037),
-	vec3(-0.30639234, 0.28534314, 0.29877898),
-	vec3(-0.30831772, 0.29315528, 0.30388507),
-	vec3(-0.31753594, 0.28534314, 0.31427482),
-	vec3(-0.3288147, 0.26190555, 0.32571998),
-	vec3(-0.4047371, 0.26190555, 0.16206928),
-	vec3(-0.39669377, 0.28534314, 0.15963574),
-	vec3(-0.40213603, 0.29315528, 0.16245906),
-	vec3(-0.4151961, 0.28534314, 0.16820285),
-	vec3(-0.4300051, 0.26190555, 0.17452963),
-	vec3(-0.43516368, 0.26190555, -0.01237479),
-	vec3(-0.42896312, 0.28534314, -0.01237479),
-	vec3(-0.4361554, 0.29315528, -0.01237479),
-	vec3(-0.450788, 0.28534314, -0.01237479),
-	vec3(-0.46690923, 0.26190555, -0.01237479),
-	vec3(-0.4007188, 0.26190555, -0.18681909),
-	vec3(-0.39499956, 0.28534314, -0.18438554),
-	vec3(-0.40163454, 0.29315528, -0.18720885),
-	vec3(-0.41513357, 0.28534314, -0.19295153),
-	vec3(-0.4300051, 0.26190555, -0.19927943),
-	vec3(-0.30627394, 0.26190555, -0.32793015),
-	vec3(-0.30187255, 0.28534314, -0.32352766),
-	vec3(-0.30697867, 0.29315528, -0.3286349),
-	vec3(-0.31736842, 0.28534314, -0.3390235),
-	vec3(-0.3288147, 0.26190555, -0.3504698),
-	vec3(-0.16516288, 0.26190555, -0.422375),
-	vec3(-0.16272932, 0.28534314, -0.41665468),
-	vec3(-0.16555263, 0.29315528, -0.4232897),
-	vec3(-0.17129643, 0.28534314, -0.43678865),
-	vec3(-0.17762321, 0.26190555, -0.45166022),
-	vec3(0.009281037, 0.26190555, -0.4568188),
-	vec3(0.009281037, 0.28534314, -0.4506182),
-	vec3(0.009281037, 0.29315528, -0.45781165),
-	vec3(0.009281037, 0.28534314, -0.47244418),
-	vec3(0.009281037, 0.26190555, -0.48856547),
-	vec3(0.1837255, 0.26190555, -0.422375),
-	vec3(0.18129197, 0.28534314, -0.41665468),
-	vec3(0.18411528, 0.29315528, -0.4232897),
-	vec3(0.18985796, 0.28534314, -0.43678865),
-	vec3(0.19618584, 0.26190555, -0.45166022),
-	vec3(0.32483658, 0.26190555, -0.32793015),
-	vec3(0.3204341, 0.28534314, -0.32352766),
-	vec3(0.3255413, 0.29315528, -0.3286349),
-	vec3(0.33592993, 0.28534314, -0.3390235),
-	vec3(0.3473762, 0.26190555, -0.3504698),
-	vec3(0.41928142, 0.26190555, -0.18681909),
-	vec3(0.41356108, 0.28534314, -0.18438554),
-	vec3(0.42019612, 0.29315528, -0.18720885),
-	vec3(0.43369508, 0.28534314, -0.19295153),
-	vec3(0.44856662, 0.26190555, -0.19927943),
-	vec3(0.54375523, 0.13727762, -0.01237479),
-	vec3(0.59459835, 0.014881478, -0.01237479),
-	vec3(0.63056105, -0.10305001, -0.01237479),
-	vec3(0.6442019, -0.21428554, -0.01237479),
-	vec3(0.5023336, 0.13727762, 0.19740653),
-	vec3(0.5492366, 0.014881478, 0.21736184),
-	vec3(0.5824117, -0.10305001, 0.23147729),
-	vec3(0.5949949, -0.21428554, 0.23683132),
-	vec3(0.38875765, 0.13727762, 0.36710146),
-	vec3(0.42485654, 0.014881478, 0.40320036),
-	vec3(0.45038927, -0.10305001, 0.42873418),
-	vec3(0.4600743, -0.21428554, 0.4384192),
-	vec3(0.21906163, 0.13727762, 0.4806774),
-	vec3(0.23901804, 0.014881478, 0.5275804),
-	vec3(0.2531335, -0.10305001, 0.56075543),
-	vec3(0.25848755, -0.21428554, 0.57333976),
-	vec3(0.009281037, 0.13727762, 0.522099),
-	vec3(0.009281037, 0.014881478, 0.5729422),
-	vec3(0.009281037, -0.10305001, 0.60890484),
-	vec3(0.009281037, -0.21428554, 0.62254566),
-	vec3(-0.20050012, 0.13727762, 0.4806774),
-	vec3(-0.22045654, 0.014881478, 0.5275804),
-	vec3(-0.23457088, -0.10305001, 0.56075543),
-	vec3(-0.23992491, -0.21428554, 0.57333976),
-	vec3(-0.37019613, 0.13727762, 0.36710146),
-	vec3(-0.40629396, 0.014881478, 0.40320036),
-	vec3(-0.43182775, -0.10305001, 0.42873418),
-	vec3(-0.4415128, -0.21428554, 0.4384192),
-	vec3(-0.48377094, 0.13727762, 0.19740653),
-	vec3(-0.530674, 0.014881478, 0.21736184),
-	vec3(-0.56384903, -0.10305001, 0.23147729),
-	vec3(-0.57643336, -0.21428554, 0.23683132),
-	vec3(-0.5251926, 0.13727762, -0.01237479),
-	vec3(-0.5760369, 0.014881478, -0.01237479),
-	vec3(-0.61199844, -0.10305001, -0.01237479),
-	vec3(-0.6256392, -0.21428554, -0.01237479),
-	vec3(-0.48377094, 0.13727762, -0.22215632),
-	vec3(-0.530674, 0.014881478, -0.24211162),
-	vec3(-0.56384903, -0.10305001, -0.2562271),
-	vec3(-0.57643336, -0.21428554, -0.26158112),
-	vec3(-0.37019613, 0.13727762, -0.39185125),
-	vec3(-0.40629396, 0.014881478, -0.42795014),
-	vec3(-0.43182775, -0.10305001, -0.45348287),
-	vec3(-0.4415128, -0.21428554, -0.46316788),
-	vec3(-0.20050012, 0.13727762, -0.5054272),
-	vec3(-0.22045654, 0.014881478, -0.5523302),
-	vec3(-0.23457088, -0.10305001, -0.58550525),
-	vec3(-0.23992491, -0.21428554, -0.59808844),
-	vec3(0.009281037, 0.13727762, -0.54684883),
-	vec3(0.009281037, 0.014881478, -0.59769195),
-	vec3(0.009281037, -0.10305001, -0.63365465),
-	vec3(0.009281037, -0.21428554, -0.6472955),
-	vec3(0.21906163, 0.13727762, -0.5054272),
-	vec3(0.23901804, 0.014881478, -0.5523302),
-	vec3(0.2531335, -0.10305001, -0.58550525),
-	vec3(0.25848755, -0.21428554, -0.59808844),
-	vec3(0.38875765, 0.13727762, -0.39185125),
-	vec3(0.42485654, 0.014881478, -0.42795014),
-	vec3(0.45038927, -0.10305001, -0.45348287),
-	vec3(0.4600743, -0.21428554, -0.46316788),
-	vec3(0.5023336, 0.13727762, -0.22215632),
-	vec3(0.5492366, 0.014881478, -0.24211162),
-	vec3(0.5824117, -0.10305001, -0.2562271),
-	vec3(0.5949949, -0.21428554, -0.26158112),
-	vec3(0.6193996, -0.3084076, -0.01237479),
-	vec3(0.5648363, -0.3779753, -0.01237479),
-	vec3(0.51027304, -0.4252223, -0.01237479),
-	vec3(0.48547187, -0.45238, -0.01237479),
-	vec3(0.5721157, -0.3084076, 0.22709712),
-	vec3(0.5217807, -0.3779753, 0.20568104),
-	vec3(0.47144574, -0.4252223, 0.18426493),
-	vec3(0.44856662, -0.45238, 0.17452963),
-	vec3(0.44246545, -0.3084076, 0.4208092),
-	vec3(0.40372527, -0.3779753, 0.38207018),
-	vec3(0.36498508, -0.4252223, 0.34332997),
-	vec3(0.3473762, -0.45238, 0.32571998),
-	vec3(0.24875224, -0.3084076, 0.5504595),
-	vec3(0.22733612, -0.3779753, 0.50012565),
-	vec3(0.20592004, -0.4252223, 0.44979066),
-	vec3(0.19618584, -0.45238, 0.4269104),
-	vec3(0.009281037, -0.3084076, 0.59774446),
-	vec3(0.009281037, -0.3779753, 0.54318124),
-	vec3(0.009281037, -0.4252223, 0.48861685),
-	vec3(0.009281037, -0.45238, 0.46381566),
-	vec3(-0.23019071, -0.3084076, 0.5504595),
-	vec3(-0.20877463, -0.3779753, 0.50012565),
-	vec3(-0.18735851, -0.4252223, 0.44979066),
-	vec3(-0.17762321, -0.45238, 0.4269104),
-	vec3(-0.42390394, -0.3084076, 0.4208092),
-	vec3(-0.38516372, -0.3779753, 0.38207018),
-	vec3(-0.34642357, -0.4252223, 0.34332997),
-	vec3(-0.3288147, -0.45238, 0.32571998),
-	vec3(-0.55355424, -0.3084076, 0.22709712),
-	vec3(-0.50321925, -0.3779753, 0.20568104),
-	vec3(-0.45288423, -0.4252223, 0.18426493),
-	vec3(-0.4300051, -0.45238, 0.17452963),
-	vec3(-0.60083807, -0.3084076, -0.01237479),
-	vec3(-0.54627484, -0.3779753, -0.01237479),
-	vec3(-0.49171156, -0.4252223, -0.01237479),
-	vec3(-0.46690923, -0.45238, -0.01237479),
-	vec3(-0.55355424, -0.3084076, -0.25184694),
-	vec3(-0.50321925, -0.3779753, -0.23042972),
-	vec3(-0.45288423, -0.4252223, -0.20901361),
-	vec3(-0.4300051, -0.45238, -0.19927943),
-	vec3(-0.42390394, -0.3084076, -0.44555902),
-	vec3(-0.38516372, -0.3779753, -0.40681887),
-	vec3(-0.34642357, -0.4252223, -0.36807868),
-	vec3(-0.3288147, -0.45238, -0.3504698),
-	vec3(-0.23019071, -0.3084076, -0.5752093),
-	vec3(-0.20877463, -0.3779753, -0.5248743),
-	vec3(-0.18735851, -0.4252223, -0.47453934),
-	vec3(-0.17762321, -0.45238, -0.45166022),
-	vec3(0.009281037, -0.3084076, -0.6224943),
-	vec3(0.009281037, -0.3779753, -0.5679299),
-	vec3(0.009281037, -0.4252223, -0.51336664),
-	vec3(0.009281037, -0.45238, -0.48856547),
-	vec3(0.24875224, -0.3084076, -0.5752093),
-	vec3(0.22733612, -0.3779753, -0.5248743),
-	vec3(0.20592004, -0.4252223, -0.47453934),
-	vec3(0.19618584, -0.45238, -0.45166022),
-	vec3(0.44246545, -0.3084076, -0.44555902),
-	vec3(0.40372527, -0.3779753, -0.40681887),
-	vec3(0.36498508, -0.4252223, -0.36807868),
-	vec3(0.3473762, -0.45238, -0.3504698),
-	vec3(0.5721157, -0.3084076, -0.25184694),
-	vec3(0.5217807, -0.3779753, -0.23042972),
-	vec3(0.47144574, -0.4252223, -0.20901361),
-	vec3(0.44856662, -0.45238, -0.19927943),
-	vec3(0.4746823, -0.469866, -0.01237479),
-	vec3(0.41701874, -0.4851184, -0.01237479),
-	vec3(0.274534, -0.49590686, -0.01237479),
-	vec3(0.009281037, -0.5, -0.01237479),
-	vec3(0.43861467, -0.469866, 0.17029576),
-	vec3(0.38541952, -0.4851184, 0.14766233),
-	vec3(0.2539767, -0.49590686, 0.091736995),
-	vec3(0.33971596, -0.469866, 0.31806085),
-	vec3(0.2987745, -0.4851184, 0.2771194),
-	vec3(0.1976109, -0.49590686, 0.17595468),
-	vec3(0.19195087, -0.469866, 0.41695842),
-	vec3(0.16931856, -0.4851184, 0.36376327),
-	vec3(0.11339277, -0.49590686, 0.2323216),
-	vec3(0.009281037, -0.469866, 0.45302716),
-	vec3(0.009281037, -0.4851184, 0.39536366),
-	vec3(0.009281037, -0.49590686, 0.25287777),
-	vec3(-0.17338936, -0.469866, 0.41695842),
-	vec3(-0.15075593, -0.4851184, 0.36376327),
-	vec3(-0.09483069, -0.49590686, 0.2323216),
-	vec3(-0.32115445, -0.469866, 0.31806085),
-	vec3(-0.280213, -0.4851184, 0.2771194),
-	vec3(-0.17904827, -0.49590686, 0.17595468),
-	vec3(-0.42005202, -0.469866, 0.17029576),
-	vec3(-0.36685687, -0.4851184, 0.14766233),
-	vec3(-0.23541519, -0.49590686, 0.091736995),
-	vec3(-0.45612076, -0.469866, -0.01237479),
-	vec3(-0.3984572, -0.4851184, -0.01237479),
-	vec3(-0.25597247, -0.49590686, -0.01237479),
-	vec3(-0.42005202, -0.469866, -0.19504446),
-	vec3(-0.36685687, -0.4851184, -0.17241214),
-	vec3(-0.23541519, -0.49590686, -0.116486356),
-	vec3(-0.32115445, -0.469866, -0.34280953),
-	vec3(-0.280213, -0.4851184, -0.3018692),
-	vec3(-0.17904827, -0.49590686, -0.20070449),
-	vec3(-0.17338936, -0.469866, -0.4417082),
-	vec3(-0.15075593, -0.4851184, -0.38851306),
-	vec3(-0.09483069, -0.49590686, -0.2570703),
-	vec3(0.009281037, -0.469866, -0.477777),
-	vec3(0.009281037, -0.4851184, -0.42011234),
-	vec3(0.009281037, -0.49590686, -0.2776276),
-	vec3(0.19195087, -0.469866, -0.4417082),
-	vec3(0.16931856, -0.4851184, -0.38851306),
-	vec3(0.11339277, -0.49590686, -0.2570703),
-	vec3(0.33971596, -0.469866, -0.34280953),
-	vec3(0.2987745, -0.4851184, -0.3018692),
-	vec3(0.1976109, -0.49590686, -0.20070449),
-	vec3(0.43861467, -0.469866, -0.19504446),
-	vec3(0.38541952, -0.4851184, -0.17241214),
-	vec3(0.2539767, -0.49590686, -0.116486356),
-	vec3(-0.49865592, 0.14285722, -0.01237479),
-	vec3(-0.6469693, 0.14174153, -0.01237479),
-	vec3(-0.75659174, 0.13392939, -0.01237479),
-	vec3(-0.8245479, 0.11272324, -0.01237479),
-	vec3(-0.84786147, 0.07142891, -0.01237479),
-	vec3(-0.49369502, 0.15401867, 0.041196737),
-	vec3(-0.6513864, 0.15272768, 0.041196737),
-	vec3(-0.7671323, 0.14369485, 0.041196737),
-	vec3(-0.8384221, 0.119176224, 0.041196737),
-	vec3(-0.8627431, 0.07142891, 0.041196737),
-	vec3(-0.48278257, 0.17857194, 0.05905388),
-	vec3(-0.66110605, 0.17689784, 0.05905388),
-	vec3(-0.7903219, 0.16517906, 0.05905388),
-	vec3(-0.86894363, 0.13337098, 0.05905388),
-	vec3(-0.89548033, 0.07142891, 0.05905388),
-	vec3(-0.47187015, 0.20312521, 0.041196737),
-	vec3(-0.6708246, 0.20106801, 0.041196737),
-	vec3(-0.81351155, 0.18666331, 0.041196737),
-	vec3(-0.8994641, 0.14756574, 0.041196737),
-	vec3(-0.9282188, 0.07142891, 0.041196737),
-	vec3(-0.46690923, 0.21428666, -0.01237479),
-	vec3(-0.6752427, 0.21205416, -0.01237479),
-	vec3(-0.824052, 0.19642875, -0.01237479),
-	vec3(-0.9133383, 0.15401867, -0.01237479),
-	vec3(-0.94310033, 0.07142891, -0.01237479),
-	vec3(-0.47187015, 0.20312521, -0.06594621),
-	vec3(-0.6708246, 0.20106801, -0.06594621),
-	vec3(-0.81351155, 0.18666331, -0.06594621),
-	vec3(-0.8994641, 0.14756574, -0.06594621),
-	vec3(-0.9282188, 0.07142891, -0.06594621),
-	vec3(-0.48278257, 0.17857194, -0.08380335),
-	vec3(-0.66110605, 0.17689784, -0.08380335),
-	vec3(-0.7903219, 0.16517906, -0.08380335),
-	vec3(-0.86894363, 0.13337098, -0.08380335),
-	vec3(-0.89548033, 0.07142891, -0.08380335),
-	vec3(-0.49369502, 0.15401867, -0.06594621),
-	vec3(-0.6513864, 0.15272768, -0.06594621),
-	vec3(-0.7671323, 0.14369485, -0.06594621),
-	vec3(-0.8384221, 0.119176224, -0.06594621),
-	vec3(-0.8627431, 0.07142891, -0.06594621),
-	vec3(-0.8354614, 0.0066970144, -0.01237479),
-	vec3(-0.79627454, -0.071428105, -0.01237479),
-	vec3(-0.72732556, -0.14955299, -0.01237479),
-	vec3(-0.6256392, -0.21428554, -0.01237479),
-	vec3(-0.84898615, 0.00044805816, 0.041196737),
-	vec3(-0.8058847, -0.08096113, 0.041196737),
-	vec3(-0.73069715, -0.16132416, 0.041196737),
-	vec3(-0.62067944, -0.22916605, 0.041196737),
-	vec3(-0.8787393, -0.013299279, 0.05905388),
-	vec3(-0.82702833, -0.10193397, 0.05905388),
-	vec3(-0.7381151, -0.18722056, 0.05905388),
-	vec3(-0.609767, -0.26190442, 0.05905388),
-	vec3(-0.9084936, -0.027046744, 0.041196737),
-	vec3(-0.8481719, -0.12290682, 0.041196737),
-	vec3(-0.74553186, -0.21311626, 0.041196737),
-	vec3(-0.59885347, -0.29464284, 0.041196737),
-	vec3(-0.9220182, -0.03329557, -0.01237479),
-	vec3(-0.8577822, -0.13243997, -0.01237479),
-	vec3(-0.7489036, -0.2248875, -0.01237479),
-	vec3(-0.5938937, -0.30952334, -0.01237479),
-	vec3(-0.9084936, -0.027046744, -0.06594621),
-	vec3(-0.8481719, -0.12290682, -0.06594621),
-	vec3(-0.74553186, -0.21311626, -0.06594621),
-	vec3(-0.59885347, -0.29464284, -0.06594621),
-	vec3(-0.8787393, -0.013299279, -0.08380335),
-	vec3(-0.82702833, -0.10193397, -0.08380335),
-	vec3(-0.7381151, -0.18722056, -0.08380335),
-	vec3(-0.609767, -0.26190442, -0.08380335),
-	vec3(-0.84898615, 0.00044805816, -0.06594621),
-	vec3(-0.8058847, -0.08096113, -0.06594621),
-	vec3(-0.73069715, -0.16132416, -0.06594621),
-	vec3(-0.62067944, -0.22916605, -0.06594621),
-	vec3(0.5489641, -0.047618523, -0.01237479),
-	vec3(0.7012456, -0.012648302, -0.01237479),
-	vec3(0.76721716, 0.07142891, -0.01237479),
-	vec3(0.80342776, 0.1733631, -0.01237479),
-	vec3(0.8664241, 0.26190555, -0.01237479),
-	vec3(0.5489641, -0.0885411, 0.10548234),
-	vec3(0.71287054, -0.04299147, 0.09404267),
-	vec3(0.7820987, 0.053757947, 0.06887528),
-	vec3(0.8215637, 0.16696933, 0.043707903),
-	vec3(0.8961862, 0.26190555, 0.032268114),
-	vec3(0.5489641, -0.17857084, 0.14476866),
-	vec3(0.7384479, -0.10974647, 0.12951516),
-	vec3(0.8148361, 0.014881478, 0.095958576),
-	vec3(0.8614632, 0.15290187, 0.0624021),
-	vec3(0.9616619, 0.26190555, 0.047149044),
-	vec3(0.5489641, -0.26860088, 0.10548234),
-	vec3(0.76402414, -0.17650136, 0.09404267),
-	vec3(0.8475744, -0.023994947, 0.06887528),
-	vec3(0.9013626, 0.13883556, 0.043707903),
-	vec3(1.0271375, 0.26190555, 0.032268114),
-	vec3(0.5489641, -0.30952334, -0.01237479),
-	vec3(0.7756502, -0.20684418, -0.01237479),
-	vec3(0.8624561, -0.041666128, -0.01237479),
-	vec3(0.91949975, 0.13244066, -0.01237479),
-	vec3(1.0568997, 0.26190555, -0.01237479),
-	vec3(0.5489641, -0.26860088, -0.13023216),
-	vec3(0.76402414, -0.17650136, -0.11879258),
-	vec3(0.8475744, -0.023994947, -0.093624756),
-	vec3(0.9013626, 0.13883556, -0.06845737),
-	vec3(1.0271375, 0.26190555, -0.057017583),
-	vec3(0.5489641, -0.17857084, -0.16951735),
-	vec3(0.7384479, -0.10974647, -0.15426496),
-	vec3(0.8148361, 0.014881478, -0.12070793),
-	vec3(0.8614632, 0.15290187, -0.087151565),
-	vec3(0.9616619, 0.26190555, -0.07189851),
-	vec3(0.5489641, -0.0885411, -0.13023216),
-	vec3(0.71287054, -0.04299147, -0.11879258),
-	vec3(0.7820987, 0.053757947, -0.093624756),
-	vec3(0.8215637, 0.16696933, -0.06845737),
-	vec3(0.8961862, 0.26190555, -0.057017583),
-	vec3(0.88924074, 0.27529848, -0.01237479),
-	vec3(0.9061068, 0.27976236, -0.01237479),
-	vec3(0.9110667, 0.27529848, -0.01237479),
-	vec3(0.8981697, 0.26190555, -0.01237479),
-	vec3(0.9211147, 0.27595174, 0.029477967),
-	vec3(0.93602306, 0.28080878, 0.023339598),
-	vec3(0.9364687, 0.27621308, 0.01720112),
-	vec3(0.918011, 0.26190555, 0.0144109735),
-	vec3(0.99123746, 0.2773903, 0.04342881),
-	vec3(1.0018406, 0.28311056, 0.035244323),
-	vec3(0.9923543, 0.27822787, 0.02705983),
-	vec3(0.9616619, 0.26190555, 0.023339598),
-	vec3(1.0613602, 0.27882978, 0.029477967),
-	vec3(1.067658, 0.2854123, 0.023339598),
-	vec3(1.0482388, 0.2802415, 0.01720112),
-	vec3(1.0053127, 0.26190555, 0.0144109735),
-	vec3(1.0932342, 0.27948314, -0.01237479),
-	vec3(1.0975741, 0.28645882, -0.01237479),
-	vec3(1.0736408, 0.28115728, -0.01237479),
-	vec3(1.025154, 0.26190555, -0.01237479),
-	vec3(1.0613602, 0.27882978, -0.054227434),
-	vec3(1.067658, 0.2854123, -0.04808907),
-	vec3(1.0482388, 0.2802415, -0.041950587),
-	vec3(1.0053127, 0.26190555, -0.03916044),
-	vec3(0.99123746, 0.2773903, -0.06817828),
-	vec3(1.0018406, 0.28311056, -0.059993792),
-	vec3(0.9923543, 0.27822787, -0.0518093),
-	vec3(0.9616619, 0.26190555, -0.04808907),
-	vec3(0.9211147, 0.27595174, -0.054227434),
-	vec3(0.93602306, 0.28080878, -0.04808907),
-	vec3(0.9364687, 0.27621308, -0.041950587),
-	vec3(0.918011, 0.26190555, -0.03916044),
-	vec3(0.009281037, 0.5, -0.01237479),
-	vec3(0.11741555, 0.4843757, -0.01237479),
-	vec3(0.112455755, 0.44642958, -0.01237479),
-	vec3(0.071781024, 0.39955455, -0.01237479),
-	vec3(0.07277309, 0.35714337, -0.01237479),
-	vec3(0.10907315, 0.4843757, 0.030181225),
-	vec3(0.104493074, 0.44642958, 0.028221767),
-	vec3(0.06694989, 0.39955455, 0.0121942),
-	vec3(0.067852505, 0.35714337, 0.012545887),
-	vec3(0.08615726, 0.4843757, 0.06450149),
-	vec3(0.08262432, 0.44642958, 0.060968548),
-	vec3(0.053689465, 0.39955455, 0.032033693),
-	vec3(0.05436045, 0.35714337, 0.032704677),
-	vec3(0.051836997, 0.4843757, 0.08741737),
-	vec3(0.049877543, 0.44642958, 0.0828373),
-	vec3(0.033849973, 0.39955455, 0.04529412),
-	vec3(0.03420166, 0.35714337, 0.04619673),
-	vec3(0.009281037, 0.4843757, 0.095760226),
-	vec3(0.009281037, 0.44642958, 0.090799876),
-	vec3(0.009281037, 0.39955455, 0.050125252),
-	vec3(0.009281037, 0.35714337, 0.051117323),
-	vec3(-0.033274923, 0.4843757, 0.08741737),
-	vec3(-0.031315465, 0.44642958, 0.0828373),
-	vec3(-0.015287899, 0.39955455, 0.04529412),
-	vec3(-0.015639585, 0.35714337, 0.04619673),
-	vec3(-0.06759519, 0.4843757, 0.06450149),
-	vec3(-0.064062245, 0.44642958, 0.060968548),
-	vec3(-0.03512739, 0.39955455, 0.032033693),
-	vec3(-0.035798375, 0.35714337, 0.032704677),
-	vec3(-0.09051107, 0.4843757, 0.030181225),
-	vec3(-0.085930996, 0.44642958, 0.028221767),
-	vec3(-0.048387818, 0.39955455, 0.0121942),
-	vec3(-0.049290426, 0.35714337, 0.012545887),
-	vec3(-0.09885392, 0.4843757, -0.01237479),
-	vec3(-0.09389357, 0.44642958, -0.01237479),
-	vec3(-0.05321895, 0.39955455, -0.01237479),
-	vec3(-0.05421102, 0.35714337, -0.01237479),
-	vec3(-0.09051107, 0.4843757, -0.054930694),
-	vec3(-0.085930996, 0.44642958, -0.05297124),
-	vec3(-0.048387818, 0.39955455, -0.03694367),
-	vec3(-0.049290426, 0.35714337, -0.037295356),
-	vec3(-0.06759519, 0.4843757, -0.08925096),
-	vec3(-0.064062245, 0.44642958, -0.08571802),
-	vec3(-0.03512739, 0.39955455, -0.056783162),
-	vec3(-0.035798375, 0.35714337, -0.057454146),
-	vec3(-0.033274923, 0.4843757, -0.1121665),
-	vec3(-0.031315465, 0.44642958, -0.10758677),
-	vec3(-0.015287899, 0.39955455, -0.070043586),
-	vec3(-0.015639585, 0.35714337, -0.0709462),
-	vec3(0.009281037, 0.4843757, -0.12050913),
-	vec3(0.009281037, 0.44642958, -0.11554935),
-	vec3(0.009281037, 0.39955455, -0.07487472),
-	vec3(0.009281037, 0.35714337, -0.07586679),
-	vec3(0.051836997, 0.4843757, -0.1121665),
-	vec3(0.049877543, 0.44642958, -0.10758677),
-	vec3(0.033849973, 0.39955455, -0.070043586),
-	vec3(0.03420166, 0.35714337, -0.0709462),
-	vec3(0.08615726, 0.4843757, -0.08925096),
-	vec3(0.08262432, 0.44642958, -0.08571802),
-	vec3(0.053689465, 0.39955455, -0.056783162),
-	vec3(0.05436045, 0.35714337, -0.057454146),
-	vec3(0.10907315, 0.4843757, -0.054930694),
-	vec3(0.104493074, 0.44642958, -0.05297124),
-	vec3(0.06694989, 0.39955455, -0.03694367),
-	vec3(0.067852505, 0.35714337, -0.037295356),
-	vec3(0.15412201, 0.32887, -0.01237479),
-	vec3(0.27118576, 0.30952448, -0.01237479),
-	vec3(0.3763442, 0.29017892, -0.01237479),
-	vec3(0.42197964, 0.26190555, -0.01237479),
-	vec3(0.14289688, 0.32887, 0.044475492),
-	vec3(0.2508887, 0.30952448, 0.09042284),
-	vec3(0.34789664, 0.29017892, 0.13169742),
-	vec3(0.3899951, 0.26190555, 0.14960894),
-	vec3(0.112118475, 0.32887, 0.090462595),
-	vec3(0.1952332, 0.30952448, 0.1735781),
-	vec3(0.26989582, 0.29017892, 0.24824074),
-	vec3(0.30229697, 0.26190555, 0.28064072),
-	vec3(0.066131264, 0.32887, 0.12124176),
-	vec3(0.11207827, 0.30952448, 0.22923248),
-	vec3(0.15335365, 0.29017892, 0.32624155),
-	vec3(0.17126517, 0.26190555, 0.36834002),
-	vec3(0.009281037, 0.32887, 0.13246691),
-	vec3(0.009281037, 0.30952448, 0.24952953),
-	vec3(0.009281037, 0.29017892, 0.35468912),
-	vec3(0.009281037, 0.26190555, 0.40032345),
-	vec3(-0.04756919, 0.32887, 0.12124176),
-	vec3(-0.093516536, 0.30952448, 0.22923248),
-	vec3(-0.134791, 0.29017892, 0.32624155),
-	vec3(-0.15270254, 0.26190555, 0.36834002),
-	vec3(-0.09355629, 0.32887, 0.090462595),
-	vec3(-0.17667167, 0.30952448, 0.1735781),
-	vec3(-0.2513343, 0.29017892, 0.24824074),
-	vec3(-0.28373432, 0.26190555, 0.28064072),
-	vec3(-0.124335356, 0.32887, 0.044475492),
-	vec3(-0.23232608, 0.30952448, 0.09042284),
-	vec3(-0.32933512, 0.29017892, 0.13169742),
-	vec3(-0.3714336, 0.26190555, 0.14960894),
-	vec3(-0.13556048, 0.32887, -0.01237479),
-	vec3(-0.25262424, 0.30952448, -0.01237479),
-	vec3(-0.35778272, 0.29017892, -0.01237479),
-	vec3(-0.40341702, 0.26190555, -0.01237479),
-	vec3(-0.124335356, 0.32887, -0.06922496),
-	vec3(-0.23232608, 0.30952448, -0.115171865),
-	vec3(-0.32933512, 0.29017892, -0.15644722),
-	vec3(-0.3714336, 0.26190555, -0.17435874),
-	vec3(-0.09355629, 0.32887, -0.11521207),
-	vec3(-0.17667167, 0.30952448, -0.19832678),
-	vec3(-0.2513343, 0.29017892, -0.27298942),
-	vec3(-0.28373432, 0.26190555, -0.30539054),
-	vec3(-0.04756919, 0.32887, -0.14599045),
-	vec3(-0.093516536, 0.30952448, -0.2539823),
-	vec3(-0.134791, 0.29017892, -0.35099024),
-	vec3(-0.15270254, 0.26190555, -0.3930887),
-	vec3(0.009281037, 0.32887, -0.1572156),
-	vec3(0.009281037, 0.30952448, -0.27427936),
-	vec3(0.009281037, 0.29017892, -0.3794378),
-	vec3(0.009281037, 0.26190555, -0.42507324),
-	vec3(0.066131264, 0.32887, -0.14599045),
-	vec3(0.11207827, 0.30952448, -0.2539823),
-	vec3(0.15335365, 0.29017892, -0.35099024),
-	vec3(0.17126517, 0.26190555, -0.3930887),
-	vec3(0.112118475, 0.32887, -0.11521207),
-	vec3(0.1952332, 0.30952448, -0.19832678),
-	vec3(0.26989582, 0.29017892, -0.27298942),
-	vec3(0.30229697, 0.26190555, -0.30539054),
-	vec3(0.14289688, 0.32887, -0.06922496),
-	vec3(0.2508887, 0.30952448, -0.115171865),
-	vec3(0.34789664, 0.29017892, -0.15644722),
-	vec3(0.3899951, 0.26190555, -0.17435874)
-};
-
-const std::vector<vec3> teapotNormals =
-{
-	vec3(-0.966742, -0.255752, 0.0),
-    vec3(-0.966824, 0.255443, 0.0),
-    vec3(-0.092052, 0.995754, 0.0),
-    vec3(0.68205, 0.731305, 0.0),
-    vec3(0.870301, 0.492521, -0.0),
-    vec3(-0.893014, -0.256345, -0.369882),
-    vec3(-0.893437, 0.255997, -0.369102),
-    vec3(-0.0838771, 0.995843, -0.0355068),
-    vec3(0.629724, 0.73186, 0.260439),
-    vec3(0.803725, 0.49337, 0.332584),
-    vec3(-0.683407, -0.256729, -0.683407),
-    vec3(-0.683531, 0.256067, -0.683531),
-    vec3(-0.0649249, 0.995776, -0.0649248),
-    vec3(0.481398, 0.732469, 0.481398),
-    vec3(0.614804, 0.493997, 0.614804),
-    vec3(-0.369882, -0.256345, -0.893014),
-    vec3(-0.369102, 0.255997, -0.893437),
-    vec3(-0.0355067, 0.995843, -0.0838772),
-    vec3(0.260439, 0.73186, 0.629724),
-    vec3(0.332584, 0.49337, 0.803725),
-    vec3(-0.00284834, -0.257863, -0.966177),
-    vec3(-0.00192311, 0.254736, -0.967009),
-    vec3(-0.000266114, 0.995734, -0.0922702),
-    vec3(0.0, 0.731295, 0.682061),
-    vec3(0.0, 0.492521, 0.870301),
-    vec3(0.379058, -0.3593, -0.852771),
-    vec3(0.37711, 0.149086, -0.914091),
-    vec3(0.0275022, 0.992081, -0.122551),
-    vec3(-0.26101, 0.726762, 0.635367),
-    vec3(-0.332485, 0.492546, 0.804271),
-    vec3(0.663548, -0.410791, -0.625264),
-    vec3(0.712664, 0.0737216, -0.697621),
-    vec3(0.0997268, 0.987509, -0.121984),
-    vec3(-0.48732, 0.723754, 0.488568),
-    vec3(-0.615242, 0.492602, 0.615484),
-    vec3(0.880028, -0.332908, -0.338709),
-    vec3(0.917276, 0.167113, -0.361493),
-    vec3(0.113584, 0.992365, -0.0480695),
-    vec3(-0.63415, 0.727508, 0.261889),
-    vec3(-0.804126, 0.492634, 0.332705),
-    vec3(0.96669, -0.255738, 0.0104537),
-    vec3(0.967442, 0.252962, 0.00810329),
-    vec3(0.0934365, 0.995624, 0.00128063),
-    vec3(-0.682167, 0.731196, -0.00034353),
-    vec3(-0.870322, 0.492483, -0.0),
-    vec3(0.893014, -0.256345, 0.369882),
-    vec3(0.893437, 0.255997, 0.369102),
-    vec3(0.0838768, 0.995843, 0.0355066),
-    vec3(-0.629724, 0.73186, -0.260439),
-    vec3(-0.803725, 0.49337, -0.332584),
-    vec3(0.683407, -0.256729, 0.683407),
-    vec3(0.683531, 0.256067, 0.683531),
-    vec3(0.0649249, 0.995776, 0.0649249),
-    vec3(-0.481398, 0.732469, -0.481398),
-    vec3(-0.614804, 0.493997, -0.614804),
-    vec3(0.369882, -0.256345, 0.893014),
-    vec3(0.369102, 0.255997, 0.893437),
-    vec3(0.0355067, 0.995843, 0.083877),
-    vec3(-0.260439, 0.73186, -0.629724),
-    vec3(-0.332584, 0.49337, -0.803725),
-    vec3(0.0, -0.255752, 0.966742),
-    vec3(0.0, 0.255443, 0.966824),
-    vec3(0.0, 0.995754, 0.092052),
-    vec3(0.0, 0.731305, -0.68205),
-    vec3(-0.0, 0.492521, -0.870301),
-    vec3(-0.369882, -0.256345, 0.893014),
-    vec3(-0.369102, 0.255996, 0.893437),
-    vec3(-0.0355068, 0.995843, 0.0838771),
-    vec3(0.260439, 0.73186, -0.629724),
-    vec3(0.332584, 0.49337, -0.803725),
-    vec3(-0.683407, -0.256729, 0.683407),
-    vec3(-0.683531, 0.256067, 0.683531),
-    vec3(-0.0649249, 0.995776, 0.064925),
-    vec3(0.481398, 0.732469, -0.481398),
-    vec3(0.614804, 0.493997, -0.614804),
-    vec3(-0.893014, -0.256345, 0.369882),
-    vec3(-0.893437, 0.255997, 0.369102),
-    vec3(-0.0838767, 0.995843, 0.0355066),
-    vec3(0.629724, 0.73186, -0.260439),
-    vec3(0.803725, 0.49337, -0.332584),
-    vec3(0.915321, 0.402725, 0.0),
-    vec3(0.941808, 0.336151, -0.0),
-    vec3(0.97869, 0.205342, 0.0),
-    vec3(0.997804, -0.0662397, 0.0),
-    vec3(0.845438, 0.403546, 0.349835),
-    vec3(0.869996, 0.336859, 0.360047),
-    vec3(0.904193, 0.205791, 0.37428),
-    vec3(0.921879, -0.0663697, 0.381752),
-    vec3(0.646802, 0.404096, 0.646802),
-    vec3(0.665655, 0.337351, 0.665655),
-    vec3(0.691923, 0.20612, 0.691923),
-    vec3(0.705542, -0.0664796, 0.705543),
-    vec3(0.349835, 0.403546, 0.845438),
-    vec3(0.360047, 0.336859, 0.869996),
-    vec3(0.37428, 0.205791, 0.904193),
-    vec3(0.381752, -0.0663697, 0.921879),
-    vec3(-0.0, 0.402725, 0.915321),
-    vec3(0.0, 0.336151, 0.941808),
-    vec3(-0.0, 0.205342, 0.97869),
-    vec3(-0.0, -0.0662397, 0.997804),
-    vec3(-0.349835, 0.403546, 0.845438),
-    vec3(-0.360047, 0.336859, 0.869996),
-    vec3(-0.37428, 0.205791, 0.904193),
-    vec3(-0.381752, -0.0663697, 0.921879),
-    vec3(-0.646802, 0.404096, 0.646802),
-    vec3(-0.665655, 0.337351, 0.665655),
-    vec3(-0.691923, 0.20612, 0.691923),
-    vec3(-0.705543, -0.0664796, 0.705543),
-    vec3(-0.845438, 0.403546, 0.349835),
-    vec3(-0.869996, 0.336859, 0.360047),
-    vec3(-0.904193, 0.205791, 0.37428),
-    vec3(-0.921879, -0.0663697, 0.381752),
-    vec3(-0.915321, 0.402725, -0.0),
-    vec3(-0.941808, 0.336151, -0.0),
-    vec3(-0.97869, 0.205342, -0.0),
-    vec3(-0.997804, -0.0662397, -0.0),
-    vec3(-0.845438, 0.403546, -0.349835),
-    vec3(-0.869996, 0.336859, -0.360047),
-    vec3(-0.904193, 0.205791, -0.37428),
-    vec3(-0.921879, -0.0663697, -0.381752),
-    vec3(-0.646802, 0.404096, -0.646802),
-    vec3(-0.665655, 0.337351, -0.665655),
-    vec3(-0.691923, 0.20612, -0.691923),
-    vec3(-0.705542, -0.0664796, -0.705543),
-    vec3(-0.349835, 0.403546, -0.845438),
-    vec3(-0.360047, 0.336859, -0.869996),
-    vec3(-0.37428, 0.205791, -0.904193),
-    vec3(-0.381752, -0.0663697, -0.921879),
-    vec3(0.0, 0.402725, -0.915321),
-    vec3(-0.0, 0.336151, -0.941808),
-    vec3(0.0, 0.205342, -0.97869),
-    vec3(0.0, -0.0662397, -0.997804),
-    vec3(0.349835, 0.403546, -0.845438),
-    vec3(0.360047, 0.336859, -0.869996),
-    vec3(0.37428, 0.205791, -0.904193),
-    vec3(0.381752, -0.0663697, -0.921879),
-    vec3(0.646802, 0.404096, -0.646802),
-    vec3(0.665655, 0.337351, -0.665655),
-    vec3(0.691923, 0.20612, -0.691923),
-    vec3(0.705543, -0.0664796, -0.705542),
-    vec3(0.845438, 0.403546, -0.349835),
-    vec3(0.869996, 0.336859, -0.360047),
-    vec3(0.904193, 0.205791, -0.37428),
-    vec3(0.921879, -0.0663697, -0.381752),
-    vec3(0.900182, -0.435513, -0.0),
-    vec3(0.729611, -0.683863, -0.0),
-    vec3(0.693951, -0.720022, -0.0),
-    vec3(0.79395, -0.607984, 0.0),
-    vec3(0.831437, -0.43618, 0.344179),
-    vec3(0.673512, -0.684665, 0.278594),
-    vec3(0.640399, -0.720924, 0.264874),
-    vec3(0.732949, -0.608996, 0.303166),
-    vec3(0.636092, -0.436777, 0.636092),
-    vec3(0.514965, -0.685289, 0.514965),
-    vec3(0.489651, -0.721446, 0.489651),
-    vec3(0.560555, -0.609554, 0.560555),
-    vec3(0.344179, -0.43618, 0.831437),
-    vec3(0.278594, -0.684665, 0.673512),
-    vec3(0.264874, -0.720924, 0.640399),
-    vec3(0.303166, -0.608996, 0.732949),
-    vec3(0.0, -0.435513, 0.900182),
-    vec3(-0.0, -0.683863, 0.729611),
-    vec3(0.0, -0.720022, 0.693951),
-    vec3(-0.0, -0.607984, 0.79395),
-    vec3(-0.344179, -0.43618, 0.831437),
-    vec3(-0.278594, -0.684665, 0.673512),
-    vec3(-0.264874, -0.720924, 0.640399),
-    vec3(-0.303166, -0.608996, 0.732949),
-    vec3(-0.636092, -0.436777, 0.636092),
-    vec3(-0.514965, -0.685289, 0.514965),
-    vec3(-0.489651, -0.721446, 0.489651),
-    vec3(-0.560555, -0.609554, 0.560555),
-    vec3(-0.831437, -0.43618, 0.344179),
-    vec3(-0.673512, -0.684665, 0.278595),
-    vec3(-0.640399, -0.720924, 0.264874),
-    vec3(-0.732949, -0.608996, 0.303166),
-    vec3(-0.900182, -0.435513, -0.0),
-    vec3(-0.729611, -0.683863, -0.0),
-    vec3(-0.693951, -0.720022, 0.0),
-    vec3(-0.79395, -0.607983, -0.0),
-    vec3(-0.831437, -0.43618, -0.344179),
-    vec3(-0.673512, -0.684665, -0.278594),
-    vec3(-0.640399, -0.720924, -0.264874),
-    vec3(-0.732949, -0.608996, -0.303166),
-    vec3(-0.636092, -0.436777, -0.636092),
-    vec3(-0.514965, -0.685289, -0.514965),
-    vec3(-0.489651, -0.721446, -0.489651),
-    vec3(-0.560555, -0.609554, -0.560555),
-    vec3(-0.344179, -0.43618, -0.831437),
-    vec3(-0.278594, -0.684665, -0.673512),
-    vec3(-0.264874, -0.720924, -0.640399),
-    vec3(-0.303166, -0.608996, -0.732949),
-    vec3(-0.0, -0.435513, -0.900182),
-    vec3(0.0, -0.683863, -0.729611),
-    vec3(-0.0, -0.720022, -0.693951),
-    vec3(0.0, -0.607984, -0.79395),
-    vec3(0.344179, -0.43618, -0.831437),
-    vec3(0.278594, -0.684665, -0.673512),
-    vec3(0.264874, -0.720924, -0.640399),
-    vec3(0.303167, -0.608996, -0.732949),
-    vec3(0.636092, -0.436777, -0.636092),
-    vec3(0.514965, -0.685289, -0.514965),
-    vec3(0.489651, -0.721446, -0.489651),
-    vec3(0.560555, -0.609554, -0.560555),
-    vec3(0.831437, -0.43618, -0.344179),
-    vec3(0.673512, -0.684665, -0.278595),
-    vec3(0.640399, -0.720924, -0.264874),
-    vec3(0.732949, -0.608996, -0.303166),
-    vec3(0.62386, -0.781536, 0.0),
-    vec3(0.177291, -0.984159, -0.0),
-    vec3(0.0492072, -0.998789, 0.0),
-    vec3(0.0, -1.0, -0.0),
-    vec3(0.576229, -0.781801, 0.238217),
-    vec3(0.163629, -0.984208, 0.0675273),
-    vec3(0.0454217, -0.998792, 0.0187357),
-    vec3(0.440416, -0.782348, 0.440416),
-    vec3(0.124903, -0.984276, 0.124903),
-    vec3(0.0346621, -0.998798, 0.0346621),
-    vec3(0.238217, -0.781801, 0.576229),
-    vec3(0.0675273, -0.984208, 0.163629),
-    vec3(0.0187357, -0.998792, 0.0454217),
-    vec3(-0.0, -0.781536, 0.62386),
-    vec3(0.0, -0.984159, 0.177291),
-    vec3(-0.0, -0.998789, 0.0492072),
-    vec3(-0.238216, -0.781801, 0.576229),
-    vec3(-0.0675273, -0.984208, 0.163629),
-    vec3(-0.0187357, -0.998792, 0.0454217),
-    vec3(-0.440416, -0.782348, 0.440416),
-    vec3(-0.124903, -0.984276, 0.124903),
-    vec3(-0.0346621, -0.998798, 0.0346621),
-    vec3(-0.576229, -0.781801, 0.238217),
-    vec3(-0.163629, -0.984208, 0.0675273),
-    vec3(-0.0454217, -0.998792, 0.0187357),
-    vec3(-0.62386, -0.781536, -0.0),
-    vec3(-0.177291, -0.984159, 0.0),
-    vec3(-0.0492072, -0.998789, -0.0),
-    vec3(-0.576229, -0.781801, -0.238217),
-    vec3(-0.163629, -0.984208, -0.0675273),
-    vec3(-0.0454217, -0.998792, -0.0187357),
-    vec3(-0.440416, -0.782348, -0.440416),
-    vec3(-0.124903, -0.984276, -0.124903),
-    vec3(-0.0346621, -0.998798, -0.0346621),
-    vec3(-0.238217, -0.781801, -0.576229),
-    vec3(-0.0675273, -0.984208, -0.163629),
-    vec3(-0.0187357, -0.998792, -0.0454217),
-    vec3(0.0, -0.781536, -0.62386),
-    vec3(-0.0, -0.984159, -0.177291),
-    vec3(0.0, -0.998789, -0.0492072),
-    vec3(0.238217, -0.781801, -0.576229),
-    vec3(0.0675273, -0.984208, -0.163629),
-    vec3(0.0187357, -0.998792, -0.0454217),
-    vec3(0.440416, -0.782348, -0.440416),
-    vec3(0.124903, -0.984276, -0.124903),
-    vec3(0.0346621, -0.998798, -0.0346621),
-    vec3(0.576229, -0.781801, -0.238217),
-    vec3(0.163629, -0.984208, -0.0675273),
-    vec3(0.0454217, -0.998792, -0.0187357),
-    vec3(0.00778619, -0.99997, -0.000215809),
-    vec3(0.0391385, -0.999233, -0.000988567),
-    vec3(0.179511, -0.983746, -0.00436856),
-    vec3(0.6123, -0.790556, -0.0104598),
-    vec3(0.986152, -0.165707, -0.00666949),
-    vec3(0.00703893, -0.812495, 0.582926),
-    vec3(0.0361273, -0.837257, 0.545614),
-    vec3(0.161845, -0.810421, 0.563048),
-    vec3(0.482365, -0.595148, 0.642746),
-    vec3(0.73872, -0.114593, 0.664199),
-    vec3(-0.00190867, 0.162121, 0.986769),
-    vec3(0.0027616, 0.0171073, 0.99985),
-    vec3(0.0105326, 0.0733989, 0.997247),
-    vec3(-0.0660406, 0.130069, 0.989303),
-    vec3(-0.0944272, 0.0165946, 0.995393),
-    vec3(-0.009203, 0.871509, 0.490293),
-    vec3(-0.0486064, 0.840609, 0.539457),
-    vec3(-0.223298, 0.802881, 0.552739),
-    vec3(-0.596365, 0.559971, 0.575135),
-    vec3(-0.803337, 0.0682361, 0.591602),
-    vec3(-0.0105609, 0.999944, 0.000103364),
-    vec3(-0.0587986, 0.99827, 0.000709759),
-    vec3(-0.28071, 0.959787, 0.00326876),
-    vec3(-0.749723, 0.661738, 0.0042684),
-    vec3(-0.997351, 0.0727144, 0.00205923),
-    vec3(-0.00879197, 0.871493, -0.49033),
-    vec3(-0.0464937, 0.841178, -0.538756),
-    vec3(-0.217909, 0.806807, -0.549161),
-    vec3(-0.597291, 0.560026, -0.574121),
-    vec3(-0.804, 0.0629127, -0.591291),
-    vec3(-0.00180555, 0.161691, -0.98684),
-    vec3(0.00203087, 0.014555, -0.999892),
-    vec3(0.00921499, 0.0600698, -0.998152),
-    vec3(-0.0593333, 0.113865, -0.991723),
-    vec3(-0.0868992, 0.0122903, -0.996141),
-    vec3(0.00641779, -0.812379, -0.583094),
-    vec3(0.0337833, -0.837512, -0.545373),
-    vec3(0.157112, -0.811947, -0.56219),
-    vec3(0.484407, -0.589365, -0.646528),
-    vec3(0.73887, -0.10132, -0.666187),
-    vec3(0.946512, 0.32265, -0.0033571),
-    vec3(0.82583, 0.56387, -0.00745213),
-    vec3(0.650011, 0.759893, -0.00693681),
-    vec3(0.532429, 0.846458, -0.00524544),
-    vec3(0.725608, 0.259351, 0.637362),
-    vec3(0.645945, 0.461988, 0.607719),
-    vec3(0.531614, 0.63666, 0.558615),
-    vec3(0.424964, 0.681717, 0.59554),
-    vec3(-0.0495616, -0.019755, 0.998576),
-    vec3(-0.0378162, -0.0356243, 0.99865),
-    vec3(-0.0379139, -0.0365122, 0.998614),
-    vec3(-0.168854, -0.297946, 0.93953),
-    vec3(-0.742342, -0.299166, 0.599523),
-    vec3(-0.619602, -0.529406, 0.579503),
-    vec3(-0.483708, -0.685761, 0.543837),
-    vec3(-0.445293, -0.794355, 0.413176),
-    vec3(-0.926513, -0.376257, 0.00199587),
-    vec3(-0.75392, -0.656952, 0.00431723),
-    vec3(-0.566224, -0.824244, 0.00346105),
-    vec3(-0.481804, -0.876277, 0.00185047),
-    vec3(-0.744675, -0.294424, -0.598977),
-    vec3(-0.621949, -0.528114, -0.578165),
-    vec3(-0.481171, -0.68834, -0.542828),
-    vec3(-0.438055, -0.797035, -0.415744),
-    vec3(-0.0443368, -0.0170558, -0.998871),
-    vec3(-0.0261761, -0.0281665, -0.99926),
-    vec3(-0.0252939, -0.0283323, -0.999278),
-    vec3(-0.157482, -0.289392, -0.944167),
-    vec3(0.728244, 0.25241, -0.637142),
-    vec3(0.647055, 0.459725, -0.608254),
-    vec3(0.522994, 0.640657, -0.562171),
-    vec3(0.409978, 0.682857, -0.604669),
-    vec3(-0.230787, 0.972982, -0.00652338),
-    vec3(-0.548936, 0.835863, -0.00151111),
-    vec3(-0.875671, 0.482807, 0.00989278),
-    vec3(-0.877554, 0.479097, 0.0190923),
-    vec3(-0.69619, 0.717439, 0.024497),
-    vec3(-0.152878, 0.687211, 0.71019),
-    vec3(-0.316721, 0.63775, 0.702113),
-    vec3(-0.601067, 0.471452, 0.64533),
-    vec3(-0.635889, 0.44609, 0.6298),
-    vec3(-0.435746, 0.601008, 0.670011),
-    vec3(0.111112, -0.0850694, 0.99016),
-    vec3(0.22331, 0.00654036, 0.974726),
-    vec3(0.190097, 0.154964, 0.969458),
-    vec3(0.00527077, 0.189482, 0.98187),
-    vec3(-0.0117518, 0.246688, 0.969024),
-    vec3(0.343906, -0.722796, 0.599412),
-    vec3(0.572489, -0.567656, 0.591627),
-    vec3(0.787436, -0.256459, 0.560512),
-    vec3(0.647097, -0.306374, 0.698141),
-    vec3(0.427528, -0.499343, 0.753576),
-    vec3(0.410926, -0.911668, 0.00128446),
-    vec3(0.67152, -0.740986, -0.000899122),
-    vec3(0.922026, -0.38706, -0.00725269),
-    vec3(0.84691, -0.531556, -0.0138542),
-    vec3(0.535925, -0.8442, -0.0105045),
-    vec3(0.341188, -0.722822, -0.600931),
-    vec3(0.578664, -0.561139, -0.591838),
-    vec3(0.784869, -0.25102, -0.566542),
-    vec3(0.642681, -0.302257, -0.70399),
-    vec3(0.418589, -0.500042, -0.758117),
-    vec3(0.115806, -0.0791394, -0.990114),
-    vec3(0.232811, 0.0125652, -0.972441),
-    vec3(0.206662, 0.153601, -0.96628),
-    vec3(0.0244996, 0.161443, -0.986578),
-    vec3(0.00338193, 0.211115, -0.977455),
-    vec3(-0.134912, 0.687491, -0.713551),
-    vec3(-0.31954, 0.633073, -0.705062),
-    vec3(-0.603902, 0.461442, -0.649903),
-    vec3(-0.631816, 0.437169, -0.640072),
-    vec3(-0.424306, 0.612706, -0.66675),
-    vec3(-0.4258, 0.904753, 0.0108049),
-    vec3(0.0220472, 0.999756, 0.00162273),
-    vec3(0.999599, 0.0258705, 0.0115556),
-    vec3(0.709585, -0.704553, 0.00967183),
-    vec3(-0.259858, 0.791936, 0.552549),
-    vec3(0.00953916, 0.99972, -0.0216718),
-    vec3(0.410156, 0.332912, -0.849083),
-    vec3(0.541523, -0.54862, -0.637),
-    vec3(0.0463104, 0.455224, 0.889172),
-    vec3(-0.0106883, 0.988794, 0.148901),
-    vec3(-0.0443756, 0.682947, -0.729118),
-    vec3(0.122825, 0.00923214, -0.992385),
-    vec3(0.481839, -0.180439, 0.85748),
-    vec3(0.455272, 0.736752, 0.499925),
-    vec3(-0.220542, 0.907193, -0.358276),
-    vec3(-0.23592, 0.657249, -0.715797),
-    vec3(0.728092, -0.685302, -0.0155853),
-    vec3(0.888739, 0.45811, -0.0166791),
-    vec3(-0.260097, 0.965582, 0.000800195),
-    vec3(-0.371612, 0.928378, -0.00441745),
-    vec3(0.480166, -0.17836, -0.858853),
-    vec3(0.488103, 0.716801, -0.497947),
-    vec3(-0.222004, 0.905399, 0.361893),
-    vec3(-0.235405, 0.66318, 0.710477),
-    vec3(0.0587203, 0.437704, -0.8972),
-    vec3(0.00132612, 0.986459, -0.164003),
-    vec3(-0.0441901, 0.681677, 0.730317),
-    vec3(0.138801, -0.0341896, 0.98973),
-    vec3(-0.25889, 0.797206, -0.54538),
-    vec3(0.0122703, 0.999739, 0.0192865),
-    vec3(0.39863, 0.35489, 0.845663),
-    vec3(0.537564, -0.5814, 0.610737),
-    vec3(-0.0, 1.0, 0.0),
-    vec3(0.82454, 0.565804, 0.0),
-    vec3(0.917701, -0.397272, 0.0),
-    vec3(0.935269, -0.353939, 0.000112842),
-    vec3(0.780712, 0.624891, 0.0),
-    vec3(0.762641, 0.565035, 0.314825),
-    vec3(0.847982, -0.397998, 0.350034),
-    vec3(0.864141, -0.355261, 0.356441),
-    vec3(0.720991, 0.625625, 0.297933),
-    vec3(0.583357, 0.565165, 0.583338),
-    vec3(0.648485, -0.398726, 0.648448),
-    vec3(0.660872, -0.355894, 0.660748),
-    vec3(0.551862, 0.62529, 0.55178),
-    vec3(0.314824, 0.565051, 0.762629),
-    vec3(0.350045, -0.397976, 0.847988),
-    vec3(0.356474, -0.3552, 0.864153),
-    vec3(0.297983, 0.625515, 0.721067),
-    vec3(-0.0, 0.565804, 0.82454),
-    vec3(-0.0, -0.397272, 0.917701),
-    vec3(-0.000112839, -0.353939, 0.935269),
-    vec3(-0.0, 0.624891, 0.780712),
-    vec3(-0.314825, 0.565035, 0.762641),
-    vec3(-0.350034, -0.397998, 0.847982),
-    vec3(-0.356441, -0.355261, 0.864141),
-    vec3(-0.297933, 0.625625, 0.720991),
-    vec3(-0.583338, 0.565165, 0.583357),
-    vec3(-0.648448, -0.398726, 0.648485),
-    vec3(-0.660748, -0.355894, 0.660872),
-    vec3(-0.55178, 0.62529, 0.551862),
-    vec3(-0.762629, 0.565051, 0.314824),
-    vec3(-0.847988, -0.397976, 0.350045),
-    vec3(-0.864153, -0.3552, 0.356474),
-    vec3(-0.721067, 0.625515, 0.297983),
-    vec3(-0.82454, 0.565804, -0.0),
-    vec3(-0.917701, -0.397272, -0.0),
-    vec3(-0.935269, -0.353939, -0.000112839),
-    vec3(-0.780712, 0.624891, -0.0),
-    vec3(-0.76264, 0.565035, -0.314825),
-    vec3(-0.847982, -0.397998, -0.350034),
-    vec3(-0.864141, -0.355261, -0.356441),
-    vec3(-0.720991, 0.625625, -0.297933),
-    vec3(-0.583357, 0.565165, -0.583338),
-    vec3(-0.648485, -0.398726, -0.648448),
-    vec3(-0.660872, -0.355894, -0.660748),
-    vec3(-0.551862, 0.62529, -0.55178),
-    vec3(-0.314824, 0.565051, -0.762629),
-    vec3(-0.350045, -0.397976, -0.847988),
-    vec3(-0.356474, -0.3552, -0.864153),
-    vec3(-0.297983, 0.625515, -0.721067),
-    vec3(0.0, 0.565804, -0.82454),
-    vec3(0.0, -0.397272, -0.917701),
-    vec3(0.000112839, -0.353939, -0.935269),
-    vec3(0.0, 0.624891, -0.780712),
-    vec3(0.314825, 0.565035, -0.762641),
-    vec3(0.350034, -0.397998, -0.847982),
-    vec3(0.356441, -0.355261, -0.864141),
-    vec3(0.297933, 0.625625, -0.720991),
-    vec3(0.583338, 0.565165, -0.583357),
-    vec3(0.648448, -0.398726, -0.648485),
-    vec3(0.660748, -0.355894, -0.660872),
-    vec3(0.55178, 0.62529, -0.551862),
-    vec3(0.762629, 0.565051, -0.314824),
-    vec3(0.847988, -0.397976, -0.350045),
-    vec3(0.864153, -0.3552, -0.356474),
-    vec3(0.721067, 0.625515, -0.297983),
-    vec3(0.236584, 0.971611, 0.0),
-    vec3(0.173084, 0.984907, -0.0),
-    vec3(0.379703, 0.925108, 0.0),
-    vec3(0.526673, 0.850068, 0.0),
-    vec3(0.217978, 0.971775, 0.0902162),
-    vec3(0.15959, 0.984977, 0.0659615),
-    vec3(0.350498, 0.925312, 0.14474),
-    vec3(0.48559, 0.850653, 0.201474),
-    vec3(0.166631, 0.971838, 0.166631),
-    vec3(0.121908, 0.985026, 0.121908),
-    vec3(0.267668, 0.925585, 0.267668),
-    vec3(0.371315, 0.851029, 0.371315),
-    vec3(0.0902162, 0.971775, 0.217978),
-    vec3(0.0659615, 0.984977, 0.15959),
-    vec3(0.14474, 0.925312, 0.350498),
-    vec3(0.201474, 0.850653, 0.48559),
-    vec3(-0.0, 0.971611, 0.236584),
-    vec3(0.0, 0.984907, 0.173084),
-    vec3(0.0, 0.925108, 0.379703),
-    vec3(0.0, 0.850068, 0.526673),
-    vec3(-0.0902162, 0.971775, 0.217978),
-    vec3(-0.0659615, 0.984977, 0.15959),
-    vec3(-0.14474, 0.925312, 0.350498),
-    vec3(-0.201474, 0.850653, 0.48559),
-    vec3(-0.166631, 0.971838, 0.166631),
-    vec3(-0.121908, 0.985026, 0.121908),
-    vec3(-0.267668, 0.925585, 0.267668),
-    vec3(-0.371315, 0.851029, 0.371315),
-    vec3(-0.217978, 0.971775, 0.0902162),
-    vec3(-0.15959, 0.984977, 0.0659615),
-    vec3(-0.350498, 0.925312, 0.14474),
-    vec3(-0.48559, 0.850653, 0.201474),
-    vec3(-0.236583, 0.971611, -0.0),
-    vec3(-0.173084, 0.984907, 0.0),
-    vec3(-0.379703, 0.925108, -0.0),
-    vec3(-0.526673, 0.850068, 0.0),
-    vec3(-0.217978, 0.971775, -0.0902162),
-    vec3(-0.15959, 0.984977, -0.0659615),
-    vec3(-0.350498, 0.925312, -0.14474),
-    vec3(-0.48559, 0.850653, -0.201474),
-    vec3(-0.166631, 0.971838, -0.166631),
-    vec3(-0.121908, 0.985026, -0.121908),
-    vec3(-0.267668, 0.925585, -0.267668),
-    vec3(-0.371315, 0.851029, -0.371315),
-    vec3(-0.0902162, 0.971775, -0.217978),
-    vec3(-0.0659615, 0.984977, -0.15959),
-    vec3(-0.14474, 0.925312, -0.350498),
-    vec3(-0.201474, 0.850653, -0.485589),
-    vec3(0.0, 0.971611, -0.236584),
-    vec3(-0.0, 0.984907, -0.173084),
-    vec3(-0.0, 0.925108, -0.379703),
-    vec3(-0.0, 0.850068, -0.526673),
-    vec3(0.0902162, 0.971775, -0.217978),
-    vec3(0.0659615, 0.984977, -0.15959),
-    vec3(0.14474, 0.925312, -0.350498),
-    vec3(0.201474, 0.850653, -0.48559),
-    vec3(0.166631, 0.971838, -0.166631),
-    vec3(0.121908, 0.985026, -0.121908),
-    vec3(0.267668, 0.925585, -0.267668),
-    vec3(0.371315, 0.851029, -0.371315),
-    vec3(0.217978, 0.971775, -0.0902162),
-    vec3(0.15959, 0.984977, -0.0659615),
-    vec3(0.350498, 0.925312, -0.14474),
-    vec3(0.48559, 0.850653, -0.201474)
-};
-
-const std::vector<int> teapotIndices =
-{
-	6, 5, 0,
-	0, 1, 6,
-	7, 6, 1,
-	1, 2, 7,
-	8, 7, 2,
-	2, 3, 8,
-	9, 8, 3,
-	3, 4, 9,
-	11, 10, 5,
-	5, 6, 11,
-	12, 11, 6,
-	6, 7, 12,
-	13, 12, 7,
-	7, 8, 13,
-	14, 13, 8,
-	8, 9, 14,
-	16, 15, 10,
-	10, 11, 16,
-	17, 16, 11,
-	11, 12, 17,
-	18, 17, 12,
-	12, 13, 18,
-	19, 18, 13,
-	13, 14, 19,
-	21, 20, 15,
-	15, 16, 21,
-	22, 21, 16,
-	16, 17, 22,
-	23, 22, 17,
-	17, 18, 23,
-	24, 23, 18,
-	18, 19, 24,
-	26, 25, 20,
-	20, 21, 26,
-	27, 26, 21,
-	21, 22, 27,
-	28, 27, 22,
-	22, 23, 28,
-	29, 28, 23,
-	23, 24, 29,
-	31, 30, 25,
-	25, 26, 31,
-	32, 31, 26,
-	26, 27, 32,
-	33, 32, 27,
-	27, 28, 33,
-	34, 33, 28,
-	28, 29, 34,
-	36, 35, 30,
-	30, 31, 36,
-	37, 36, 31,
-	31, 32, 37,
-	38, 37, 32,
-	32, 33, 38,
-	39, 38, 33,
-	33, 34, 39,
-	41, 40, 35,
-	35, 36, 41,
-	42, 41, 36,
-	36, 37, 42,
-	43, 42, 37,
-	37, 38, 43,
-	44, 43, 38,
-	38, 39, 44,
-	46, 45, 40,
-	40, 41, 46,
-	47, 46, 41,
-	41, 42, 47,
-	48, 47, 42,
-	42, 43, 48,
-	49, 48, 43,
-	43, 44, 49,
-	51, 50, 45,
-	45, 46, 51,
-	52, 51, 46,
-	46, 47, 52,
-	53, 52, 47,
-	47, 48, 53,
-	54, 53, 48,
-	48, 49, 54,
-	56, 55, 50,
-	50, 51, 56,
-	57, 56, 51,
-	51, 52, 57,
-	58, 57, 52,
-	52, 53, 58,
-	59, 58, 53,
-	53, 54, 59,
-	61, 60, 55,
-	55, 56, 61,
-	62, 61, 56,
-	56, 57, 62,
-	63, 62, 57,
-	57, 58, 63,
-	64, 63, 58,
-	58, 59, 64,
-	66, 65, 60,
-	60, 61, 66,
-	67, 66, 61,
-	61, 62, 67,
-	68, 67, 62,
-	62, 63, 68,
-	69, 68, 63,
-	63, 64, 69,
-	71, 70, 65,
-	65, 66, 71,
-	72, 71, 66,
-	66, 67, 72,
-	73, 72, 67,
-	67, 68, 73,
-	74, 73, 68,
-	68, 69, 74,
-	76, 75, 70,
-	70, 71, 76,
-	77, 76, 71,
-	71, 72, 77,
-	78, 77, 72,
-	72, 73, 78,
-	79, 78, 73,
-	73, 74, 79,
-	1, 0, 75,
-	75, 76, 1,
-	2, 1, 76,
-	76, 77, 2,
-	3, 2, 77,
-	77, 78, 3,
-	4, 3, 78,
-	78, 79, 4,
-	84, 9, 4,
-	4, 80, 84,
-	85, 84, 80,
-	80, 81, 85,
-	86, 85, 81,
-	81, 82, 86,
-	87, 86, 82,
-	82, 83, 87,
-	88, 14, 9,
-	9, 84, 88,
-	89, 88, 84,
-	84, 85, 89,
-	90, 89, 85,
-	85, 86, 90,
-	91, 90, 86,
-	86, 87, 91,
-	92, 19, 14,
-	14, 88, 92,
-	93, 92, 88,
-	88, 89, 93,
-	94, 93, 89,
-	89, 90, 94,
-	95, 94, 90,
-	90, 91, 95,
-	96, 24, 19,
-	19, 92, 96,
-	97, 96, 92,
-	92, 93, 97,
-	98, 97, 93,
-	93, 94, 98,
-	99, 98, 94,
-	94, 95, 99,
-	100, 29, 24,
-	24, 96, 100,
-	101, 100, 96,
-	96, 97, 101,
-	102, 101, 97,
-	97, 98, 102,
-	103, 102, 98,
-	98, 99, 103,
-	104, 34, 29,
-	29, 100, 104,
-	105, 104, 100,
-	100, 101, 105,
-	106, 105, 101,
-	101, 102, 106,
-	107, 106, 102,
-	102, 103, 107,
-	108, 39, 34,
-	34, 104, 108,
-	109, 108, 104,
-	104, 105, 109,
-	110, 109, 105,
-	105, 106, 110,
-	111, 110, 106,
-	106, 107, 111,
-	112, 44, 39,
-	39, 108, 112,
-	113, 112, 108,
-	108, 109, 113,
-	114, 113, 109,
-	109, 110, 114,
-	115, 114, 110,
-	110, 111, 115,
-	116, 49, 44,
-	44, 112, 116,
-	117, 116, 112,
-	112, 113, 117,
-	118, 117, 113,
-	113, 114, 118,
-	119, 118, 114,
-	114, 115, 119,
-	120, 54, 49,
-	49, 116, 120,
-	121, 120, 116,
-	116, 117, 121,
-	122, 121, 117,
-	117, 118, 122,
-	123, 122, 118,
-	118, 119, 123,
-	124, 59, 54,
-	54, 120, 124,
-	125, 124, 120,
-	120, 121, 125,
-	126, 125, 121,
-	121, 122, 126,
-	127, 126, 122,
-	122, 123, 127,
-	128, 64, 59,
-	59, 124, 128,
-	129, 128, 124,
-	124, 125, 129,
-	130, 129, 125,
-	125, 126, 130,
-	131, 130, 126,
-	126, 127, 131,
-	132, 69, 64,
-	64, 128, 132,
-	133, 132, 128,
-	128, 129, 133,
-	134, 133, 129,
-	129, 130, 134,
-	135, 134, 130,
-	130, 131, 135,
-	136, 74, 69,
-	69, 132, 136,
-	137, 136, 132,
-	132, 133, 137,
-	138, 137, 133,
-	133, 134, 138,
-	139, 138, 134,
-	134, 135, 139,
-	140, 79, 74,
-	74, 136, 140,
-	141, 140, 136,
-	136, 137, 141,
-	142, 141, 137,
-	137, 138, 142,
-	143, 142, 138,
-	138, 139, 143,
-	80, 4, 79,
-	79, 140, 80,
-	81, 80, 140,
-	140, 141, 81,
-	82, 81, 141,
-	141, 142, 82,
-	83, 82, 142,
-	142, 143, 83,
-	148, 87, 83,
-	83, 144, 148,
-	149, 148, 144,
-	144, 145, 149,
-	150, 149, 145,
-	145, 146, 150,
-	151, 150, 146,
-	146, 147, 151,
-	152, 91, 87,
-	87, 148, 152,
-	153, 152, 148,
-	148, 149, 153,
-	154, 153, 149,
-	149, 150, 154,
-	155, 154, 150,
-	150, 151, 155,
-	156, 95, 91,
-	91, 152, 156,
-	157, 156, 152,
-	152, 153, 157,
-	158, 157, 153,
-	153, 154, 158,
-	159, 158, 154,
-	154, 155, 159,
-	160, 99, 95,
-	95, 156, 160,
-	161, 160, 156,
-	156, 157, 161,
-	162, 161, 157,
-	157, 158, 162,
-	163, 162, 158,
-	158, 159, 163,
-	164, 103, 99,
-	99, 160, 164,
-	165, 164, 160,
-	160, 161, 165,
-	166, 165, 161,
-	161, 162, 166,
-	167, 166, 162,
-	162, 163, 167,
-	168, 107, 103,
-	103, 164, 168,
-	169, 168, 164,
-	164, 165, 169,
-	170, 169, 165,
-	165, 166, 170,
-	171, 170, 166,
-	166, 167, 171,
-	172, 111, 107,
-	107, 168, 172,
-	173, 172, 168,
-	168, 169, 173,
-	174, 173, 169,
-	169, 170, 174,
-	175, 174, 170,
-	170, 171, 175,
-	176, 115, 111,
-	111, 172, 176,
-	177, 176, 172,
-	172, 173, 177,
-	178, 177, 173,
-	173, 174, 178,
-	179, 178, 174,
-	174, 175, 179,
-	180, 119, 115,
-	115, 176, 180,
-	181, 180, 176,
-	176, 177, 181,
-	182, 181, 177,
-	177, 178, 182,
-	183, 182, 178,
-	178, 179, 183,
-	184, 123, 119,
-	119, 180, 184,
-	185, 184, 180,
-	180, 181, 185,
-	186, 185, 181,
-	181, 182, 186,
-	187, 186, 182,
-	182, 183, 187,
-	188, 127, 123,
-	123, 184, 188,
-	189, 188, 184,
-	184, 185, 189,
-	190, 189, 185,
-	185, 186, 190,
-	191, 190, 186,
-	186, 187, 191,
-	192, 131, 127,
-	127, 188, 192,
-	193, 192, 188,
-	188, 189, 193,
-	194, 193, 189,
-	189, 190, 194,
-	195, 194, 190,
-	190, 191, 195,
-	196, 135, 131,
-	131, 192, 196,
-	197, 196, 192,
-	192, 193, 197,
-	198, 197, 193,
-	193, 194, 198,
-	199, 198, 194,
-	194, 195, 199,
-	200, 139, 135,
-	135, 196, 200,
-	201, 200, 196,
-	196, 197, 201,
-	202, 201, 197,
-	197, 198, 202,
-	203, 202, 198,
-	198, 199, 203,
-	204, 143, 139,
-	139, 200, 204,
-	205, 204, 200,
-	200, 201, 205,
-	206, 205, 201,
-	201, 202, 206,
-	207, 206, 202,
-	202, 203, 207,
-	144, 83, 143,
-	143, 204, 144,
-	145, 144, 204,
-	204, 205, 145,
-	146, 145, 205,
-	205, 206, 146,
-	147, 146, 206,
-	206, 207, 147,
-	212, 151, 147,
-	147, 208, 212,
-	213, 212, 208,
-	208, 209, 213,
-	214, 213, 209,
-	209, 210, 214,
-	211, 214, 210,
-	210, 211, 211,
-	215, 155, 151,
-	151, 212, 215,
-	216, 215, 212,
-	212, 213, 216,
-	217, 216, 213,
-	213, 214, 217,
-	211, 217, 214,
-	214, 211, 211,
-	218, 159, 155,
-	155, 215, 218,
-	219, 218, 215,
-	215, 216, 219,
-	220, 219, 216,
-	216, 217, 220,
-	211, 220, 217,
-	217, 211, 211,
-	221, 163, 159,
-	159, 218, 221,
-	222, 221, 218,
-	218, 219, 222,
-	223, 222, 219,
-	219, 220, 223,
-	211, 223, 220,
-	220, 211, 211,
-	224, 167, 163,
-	163, 221, 224,
-	225, 224, 221,
-	221, 222, 225,
-	226, 225, 222,
-	222, 223, 226,
-	211, 226, 223,
-	223, 211, 211,
-	227, 171, 167,
-	167, 224, 227,
-	228, 227, 224,
-	224, 225, 228,
-	229, 228, 225,
-	225, 226, 229,
-	211, 229, 226,
-	226, 211, 211,
-	230, 175, 171,
-	171, 227, 230,
-	231, 230, 227,
-	227, 228, 231,
-	232, 231, 228,
-	228, 229, 232,
-	211, 232, 229,
-	229, 211, 211,
-	233, 179, 175,
-	175, 230, 233,
-	234, 233, 230,
-	230, 231, 234,
-	235, 234, 231,
-	231, 232, 235,
-	211, 235, 232,
-	232, 211, 211,
-	236, 183, 179,
-	179, 233, 236,
-	237, 236, 233,
-	233, 234, 237,
-	238, 237, 234,
-	234, 235, 238,
-	211, 238, 235,
-	235, 211, 211,
-	239, 187, 183,
-	183, 236, 239,
-	240, 239, 236,
-	236, 237, 240,
-	241, 240, 237,
-	237, 238, 241,
-	211, 241, 238,
-	238, 211, 211,
-	242, 191, 187,
-	187, 239, 242,
-	243, 242, 239,
-	239, 240, 243,
-	244, 243, 240,
-	240, 241, 244,
-	211, 244, 241,
-	241, 211, 211,
-	245, 195, 191,
-	191, 242, 245,
-	246, 245, 242,
-	242, 243, 246,
-	247, 246, 243,
-	243, 244, 247,
-	211, 247, 244,
-	244, 211, 211,
-	248, 199, 195,
-	195, 245, 248,
-	249, 248, 245,
-	245, 246, 249,
-	250, 249, 246,
-	246, 247, 250,
-	211, 250, 247,
-	247, 211, 211,
-	251, 203, 199,
-	199, 248, 251,
-	252, 251, 248,
-	248, 249, 252,
-	253, 252, 249,
-	249, 250, 253,
-	211, 253, 250,
-	250, 211, 211,
-	254, 207, 203,
-	203, 251, 254,
-	255, 254, 251,
-	251, 252, 255,
-	256, 255, 252,
-	252, 253, 256,
-	211, 256, 253,
-	253, 211, 211,
-	208, 147, 207,
-	207, 254, 208,
-	209, 208, 254,
-	254, 255, 209,
-	210, 209, 255,
-	255, 256, 210,
-	211, 210, 256,
-	256, 211, 211,
-	263, 262, 257,
-	257, 258, 263,
-	264, 263, 258,
-	258, 259, 264,
-	265, 264, 259,
-	259, 260, 265,
-	266, 265, 260,
-	260, 261, 266,
-	268, 267, 262,
-	262, 263, 268,
-	269, 268, 263,
-	263, 264, 269,
-	270, 269, 264,
-	264, 265, 270,
-	271, 270, 265,
-	265, 266, 271,
-	273, 272, 267,
-	267, 268, 273,
-	274, 273, 268,
-	268, 269, 274,
-	275, 274, 269,
-	269, 270, 275,
-	276, 275, 270,
-	270, 271, 276,
-	278, 277, 272,
-	272, 273, 278,
-	279, 278, 273,
-	273, 274, 279,
-	280, 279, 274,
-	274, 275, 280,
-	281, 280, 275,
-	275, 276, 281,
-	283, 282, 277,
-	277, 278, 283,
-	284, 283, 278,
-	278, 279, 284,
-	285, 284, 279,
-	279, 280, 285,
-	286, 285, 280,
-	280, 281, 286,
-	288, 287, 282,
-	282, 283, 288,
-	289, 288, 283,
-	283, 284, 289,
-	290, 289, 284,
-	284, 285, 290,
-	291, 290, 285,
-	285, 286, 291,
-	293, 292, 287,
-	287, 288, 293,
-	294, 293, 288,
-	288, 289, 294,
-	295, 294, 289,
-	289, 290, 295,
-	296, 295, 290,
-	290, 291, 296,
-	258, 257, 292,
-	292, 293, 258,
-	259, 258, 293,
-	293, 294, 259,
-	260, 259, 294,
-	294, 295, 260,
-	261, 260, 295,
-	295, 296, 261,
-	301, 266, 261,
-	261, 297, 301,
-	302, 301, 297,
-	297, 298, 302,
-	303, 302, 298,
-	298, 299, 303,
-	304, 303, 299,
-	299, 300, 304,
-	305, 271, 266,
-	266, 301, 305,
-	306, 305, 301,
-	301, 302, 306,
-	307, 306, 302,
-	302, 303, 307,
-	308, 307, 303,
-	303, 304, 308,
-	309, 276, 271,
-	271, 305, 309,
-	310, 309, 305,
-	305, 306, 310,
-	311, 310, 306,
-	306, 307, 311,
-	312, 311, 307,
-	307, 308, 312,
-	313, 281, 276,
-	276, 309, 313,
-	314, 313, 309,
-	309, 310, 314,
-	315, 314, 310,
-	310, 311, 315,
-	316, 315, 311,
-	311, 312, 316,
-	317, 286, 281,
-	281, 313, 317,
-	318, 317, 313,
-	313, 314, 318,
-	319, 318, 314,
-	314, 315, 319,
-	320, 319, 315,
-	315, 316, 320,
-	321, 291, 286,
-	286, 317, 321,
-	322, 321, 317,
-	317, 318, 322,
-	323, 322, 318,
-	318, 319, 323,
-	324, 323, 319,
-	319, 320, 324,
-	325, 296, 291,
-	291, 321, 325,
-	326, 325, 321,
-	321, 322, 326,
-	327, 326, 322,
-	322, 323, 327,
-	328, 327, 323,
-	323, 324, 328,
-	297, 261, 296,
-	296, 325, 297,
-	298, 297, 325,
-	325, 326, 298,
-	299, 298, 326,
-	326, 327, 299,
-	300, 299, 327,
-	327, 328, 300,
-	335, 334, 329,
-	329, 330, 335,
-	336, 335, 330,
-	330, 331, 336,
-	337, 336, 331,
-	331, 332, 337,
-	338, 337, 332,
-	332, 333, 338,
-	340, 339, 334,
-	334, 335, 340,
-	341, 340, 335,
-	335, 336, 341,
-	342, 341, 336,
-	336, 337, 342,
-	343, 342, 337,
-	337, 338, 343,
-	345, 344, 339,
-	339, 340, 345,
-	346, 345, 340,
-	340, 341, 346,
-	347, 346, 341,
-	341, 342, 347,
-	348, 347, 342,
-	342, 343, 348,
-	350, 349, 344,
-	344, 345, 350,
-	351, 350, 345,
-	345, 346, 351,
-	352, 351, 346,
-	346, 347, 352,
-	353, 352, 347,
-	347, 348, 353,
-	355, 354, 349,
-	349, 350, 355,
-	356, 355, 350,
-	350, 351, 356,
-	357, 356, 351,
-	351, 352, 357,
-	358, 357, 352,
-	352, 353, 358,
-	360, 359, 354,
-	354, 355, 360,
-	361, 360, 355,
-	355, 356, 361,
-	362, 361, 356,
-	356, 357, 362,
-	363, 362, 357,
-	357, 358, 363,
-	365, 364, 359,
-	359, 360, 365,
-	366, 365, 360,
-	360, 361, 366,
-	367, 366, 361,
-	361, 362, 367,
-	368, 367, 362,
-	362, 363, 368,
-	330, 329, 364,
-	364, 365, 330,
-	331, 330, 365,
-	365, 366, 331,
-	332, 331, 366,
-	366, 367, 332,
-	333, 332, 367,
-	367, 368, 333,
-	373, 338, 333,
-	333, 369, 373,
-	374, 373, 369,
-	369, 370, 374,
-	375, 374, 370,
-	370, 371, 375,
-	376, 375, 371,
-	371, 372, 376,
-	377, 343, 338,
-	338, 373, 377,
-	378, 377, 373,
-	373, 374, 378,
-	379, 378, 374,
-	374, 375, 379,
-	380, 379, 375,
-	375, 376, 380,
-	381, 348, 343,
-	343, 377, 381,
-	382, 381, 377,
-	377, 378, 382,
-	383, 382, 378,
-	378, 379, 383,
-	384, 383, 379,
-	379, 380, 384,
-	385, 353, 348,
-	348, 381, 385,
-	386, 385, 381,
-	381, 382, 386,
-	387, 386, 382,
-	382, 383, 387,
-	388, 387, 383,
-	383, 384, 388,
-	389, 358, 353,
-	353, 385, 389,
-	390, 389, 385,
-	385, 386, 390,
-	391, 390, 386,
-	386, 387, 391,
-	392, 391, 387,
-	387, 388, 392,
-	393, 363, 358,
-	358, 389, 393,
-	394, 393, 389,
-	389, 390, 394,
-	395, 394, 390,
-	390, 391, 395,
-	396, 395, 391,
-	391, 392, 396,
-	397, 368, 363,
-	363, 393, 397,
-	398, 397, 393,
-	393, 394, 398,
-	399, 398, 394,
-	394, 395, 399,
-	400, 399, 395,
-	395, 396, 400,
-	369, 333, 368,
-	368, 397, 369,
-	370, 369, 397,
-	397, 398, 370,
-	371, 370, 398,
-	398, 399, 371,
-	372, 371, 399,
-	399, 400, 372,
-	406, 401, 401,
-	401, 402, 406,
-	407, 406, 402,
-	402, 403, 407,
-	408, 407, 403,
-	403, 404, 408,
-	409, 408, 404,
-	404, 405, 409,
-	410, 401, 401,
-	401, 406, 410,
-	411, 410, 406,
-	406, 407, 411,
-	412, 411, 407,
-	407, 408, 412,
-	413, 412, 408,
-	408, 409, 413,
-	414, 401, 401,
-	401, 410, 414,
-	415, 414, 410,
-	410, 411, 415,
-	416, 415, 411,
-	411, 412, 416,
-	417, 416, 412,
-	412, 413, 417,
-	418, 401, 401,
-	401, 414, 418,
-	419, 418, 414,
-	414, 415, 419,
-	420, 419, 415,
-	415, 416, 420,
-	421, 420, 416,
-	416, 417, 421,
-	422, 401, 401,
-	401, 418, 422,
-	423, 422, 418,
-	418, 419, 423,
-	424, 423, 419,
-	419, 420, 424,
-	425, 424, 420,
-	420, 421, 425,
-	426, 401, 401,
-	401, 422, 426,
-	427, 426, 422,
-	422, 423, 427,
-	428, 427, 423,
-	423, 424, 428,
-	429, 428, 424,
-	424, 425, 429,
-	430, 401, 401,
-	401, 426, 430,
-	431, 430, 426,
-	426, 427, 431,
-	432, 431, 427,
-	427, 428, 432,
-	433, 432, 428,
-	428, 429, 433,
-	434, 401, 401,
-	401, 430, 434,
-	435, 434, 430,
-	430, 431, 435,
-	436, 435, 431,
-	431, 432, 436,
-	437, 436, 432,
-	432, 433, 437,
-	438, 401, 401,
-	401, 434, 438,
-	439, 438, 434,
-	434, 435, 439,
-	440, 439, 435,
-	435, 436, 440,
-	441, 440, 436,
-	436, 437, 441,
-	442, 401, 401,
-	401, 438, 442,
-	443, 442, 438,
-	438, 439, 443,
-	444, 443, 439,
-	439, 440, 444,
-	445, 444, 440,
-	440, 441, 445,
-	446, 401, 401,
-	401, 442, 446,
-	447, 446, 442,
-	442, 443, 447,
-	448, 447, 443,
-	443, 444, 448,
-	449, 448, 444,
-	444, 445, 449,
-	450, 401, 401,
-	401, 446, 450,
-	451, 450, 446,
-	446, 447, 451,
-	452, 451, 447,
-	447, 448, 452,
-	453, 452, 448,
-	448, 449, 453,
-	454, 401, 401,
-	401, 450, 454,
-	455, 454, 450,
-	450, 451, 455,
-	456, 455, 451,
-	451, 452, 456,
-	457, 456, 452,
-	452, 453, 457,
-	458, 401, 401,
-	401, 454, 458,
-	459, 458, 454,
-	454, 455, 459,
-	460, 459, 455,
-	455, 456, 460,
-	461, 460, 456,
-	456, 457, 461,
-	462, 401, 401,
-	401, 458, 462,
-	463, 462, 458,
-	458, 459, 463,
-	464, 463, 459,
-	459, 460, 464,
-	465, 464, 460,
-	460, 461, 465,
-	402, 401, 401,
-	401, 462, 402,
-	403, 402, 462,
-	462, 463, 403,
-	404, 403, 463,
-	463, 464, 404,
-	405, 404, 464,
-	464, 465, 405,
-	470, 409, 405,
-	405, 466, 470,
-	471, 470, 466,
-	466, 467, 471,
-	472, 471, 467,
-	467, 468, 472,
-	473, 472, 468,
-	468, 469, 473,
-	474, 413, 409,
-	409, 470, 474,
-	475, 474, 470,
-	470, 471, 475,
-	476, 475, 471,
-	471, 472, 476,
-	477, 476, 472,
-	472, 473, 477,
-	478, 417, 413,
-	413, 474, 478,
-	479, 478, 474,
-	474, 475, 479,
-	480, 479, 475,
-	475, 476, 480,
-	481, 480, 476,
-	476, 477, 481,
-	482, 421, 417,
-	417, 478, 482,
-	483, 482, 478,
-	478, 479, 483,
-	484, 483, 479,
-	479, 480, 484,
-	485, 484, 480,
-	480, 481, 485,
-	486, 425, 421,
-	421, 482, 486,
-	487, 486, 482,
-	482, 483, 487,
-	488, 487, 483,
-	483, 484, 488,
-	489, 488, 484,
-	484, 485, 489,
-	490, 429, 425,
-	425, 486, 490,
-	491, 490, 486,
-	486, 487, 491,
-	492, 491, 487,
-	487, 488, 492,
-	493, 492, 488,
-	488, 489, 493,
-	494, 433, 429,
-	429, 490, 494,
-	495, 494, 490,
-	490, 491, 495,
-	496, 495, 491,
-	491, 492, 496,
-	497, 496, 492,
-	492, 493, 497,
-	498, 437, 433,
-	433, 494, 498,
-	499, 498, 494,
-	494, 495, 499,
-	500, 499, 495,
-	495, 496, 500,
-	501, 500, 496,
-	496, 497, 501,
-	502, 441, 437,
-	437, 498, 502,
-	503, 502, 498,
-	498, 499, 503,
-	504, 503, 499,
-	499, 500, 504,
-	505, 504, 500,
-	500, 501, 505,
-	506, 445, 441,
-	441, 502, 506,
-	507, 506, 502,
-	502, 503, 507,
-	508, 507, 503,
-	503, 504, 508,
-	509, 508, 504,
-	504, 505, 509,
-	510, 449, 445,
-	445, 506, 510,
-	511, 510, 506,
-	506, 507, 511,
-	512, 511, 507,
-	507, 508, 512,
-	513, 512, 508,
-	508, 509, 513,
-	514, 453, 449,
-	449, 510, 514,
-	515, 514, 510,
-	510, 511, 515,
-	516, 515, 511,
-	511, 512, 516,
-	517, 516, 512,
-	512, 513, 517,
-	518, 457, 453,
-	453, 514, 518,
-	519, 518, 514,
-	514, 515, 519,
-	520, 519, 515,
-	515, 516, 520,
-	521, 520, 516,
-	516, 517, 521,
-	522, 461, 457,
-	457, 518, 522,
-	523, 522, 518,
-	518, 519, 523,
-	524, 523, 519,
-	519, 520, 524,
-	525, 524, 520,
-	520, 521, 525,
-	526, 465, 461,
-	461, 522, 526,
-	527, 526, 522,
-	522, 523, 527,
-	528, 527, 523,
-	523, 524, 528,
-	529, 528, 524,
-	524, 525, 529,
-	466, 405, 465,
-	465, 526, 466,
-	467, 466, 526,
-	526, 527, 467,
-	468, 467, 527,
-	527, 528, 468,
-	469, 468, 528,
-	528, 529, 469
-};
-
 GLuint gProgram;
 GLuint gVAO;
 GLuint gTexture;
+GLint gDenoiseLoc;
+GLuint gPbo = 0;
+GLsync gPboFences[PBO_COUNT] = {};
+unsigned char* gPboPointer = nullptr; // persistent mapping, null when each upload maps its slot
+int gPboIndex = 0;
+int gTextureWidth = 0;
+int gTextureHeight = 0;
+bool gPersistentMapping = false;
 
 int gRenderWidth = 0;
 int gRenderHeight = 0;
 
-int gSamples = 0;
-unsigned char* gPixels = nullptr;
+int gSamples = 0; // passes since the last reset, pixels track their own sample count
+int gMaxSamples = MAX_SAMPLES_PER_PIXEL;
+int gRayDepth = RAY_DEPTH;
+float gNoiseThreshold = NOISE_THRESHOLD;
+int gTileOrder[TILE_SIZE*TILE_SIZE]; // x + y*TILE_SIZE in the order a tile's pixels are traced
+bool gSortRays = false; // trace a tile breadth first, bounce rays sorted by octant and origin
+std::atomic<int> gTonemap{ TONEMAP_NONE };
+float gExposure = 1.0f; // linear scale, 2^stops
+bool gSrgb = false; // sRGB transfer instead of the square root gamma
+bool gDither = false; // ordered dither ahead of the 8 bit quantization
+unsigned char* gPixels = nullptr; // resolved from the accumulation only when a frame is presented
 vec3* gStoragePixels = nullptr;
+float* gStorageSquares = nullptr; // luminance squared, for the variance
+int* gPixelSamples = nullptr;
+
+// Primary hit through the pixel center, reprojection matches these between views
+struct firstHit
+{
+	vec3 position{};
+	vec3 normal{};
+	vec3 albedo = vec3(1.0f, 1.0f, 1.0f); // the sky is not demodulated
+	float depth{}; // 0 on a miss
+	int material = -1;
+};
+
+firstHit* gFirstHits = nullptr;
+
+// Accumulation of the previous view, gathered from when the camera moves
+vec3* gPrevStoragePixels = nullptr;
+float* gPrevStorageSquares = nullptr;
+int* gPrevPixelSamples = nullptr;
+firstHit* gPrevFirstHits = nullptr;
+bool gHistoryValid = false;
+
+// Edge-avoiding a-trous wavelet filter over the demodulated radiance, ping-pongs between the two buffers
+std::atomic<bool> gDenoise{ false };
+int gDenoiseIteration = 0;
+vec3* gDenoiseColors[2] = {};
+float* gDenoiseLuminances[2] = {}; // of gDenoiseColors, so the filter taps don't recompute it
+float* gDenoiseVariances[2] = {};
+unsigned char* gDenoisedPixels = nullptr;
+
+// What the filter taps read of a first hit, packed so a 5x5 footprint touches less memory than the full records
+struct denoiseGuide
+{
+	vec3 normal;
+	float depth;
+	int material; // DENOISE_EMPTY matches no center
+};
+
+denoiseGuide* gDenoiseGuides = nullptr;
 
 unsigned int gCores;
 std::thread* gThreads = nullptr;
 
+struct tile
+{
+	int x0{};
+	int y0{};
+	int x1{};
+	int y1{};
+	float time{}; // ms spent on the last pass
+	float error{}; // worst pixel standard error in display units
+	int samples{};
+	int batch = 1; // samples per pixel on the next pass
+	bool converged{};
+};
+
+struct tileQueue
+{
+	std::mutex mutex;
+	std::deque<int> tiles;
+};
+
+struct camera
+{
+	vec3 origin{};
+	vec3 horizontal{};
+	vec3 vertical{};
+	vec3 lowerLeftCorner{};
+};
+
+std::vector<tile> gTiles;
+int gActiveTiles = 0;
+tileQueue* gQueues = nullptr;
+camera gCamera;
+camera gPrevCamera;
+int gPassMode = PASS_SAMPLE;
+
+std::mutex gPoolMutex;
+std::condition_variable gPoolStart;
+std::condition_variable gPoolDone;
+int gPoolGeneration = 0;
+unsigned int gPoolBusy = 0;
+bool gPoolQuit = false;
+std::atomic<int> gSteals{ 0 };
+
+std::atomic<uint64_t> gRayCount{ 0 };
+thread_local uint64_t tRayCount = 0;
+
+// Traversal counters, only the benchmark build pays for them
+#ifdef TRACER_BENCHMARK
+std::atomic<uint64_t> gNodeTests{ 0 };
+std::atomic<uint64_t> gPrimitiveTests{ 0 };
+thread_local uint64_t tNodeTests = 0;
+thread_local uint64_t tPrimitiveTests = 0;
+float gBvhBuildMs = 0.0f; // every bvhBuild() since the case started, both levels
+#define BENCHMARK_COUNT(counter, n) (counter += (n))
+#else
+#define BENCHMARK_COUNT(counter, n)
+#endif
+
 float gFpsTime = 0.0f;
 int gFpsCount = 0;
 
@@ -2225,12 +319,15 @@ vec3 gEyePos;
 vec3 gPrevEyePos;
 double gPrevPosX;
 double gPrevPosY;
+vec3 gCameraTarget;
+float gCameraDistance = 7.0f;
+float gCameraFov = 0.7853f; // radians
 float gTargetRotX;
 float gTargetRotY;
 float gRotX;
 float gRotY;
 
-int gLevel = MAX_LEVEL;
+int gLevel = MAX_LEVEL; // tracer thread
 
 inline float clampf(float x, float min, float max) {
 	if (x < min) return min;
@@ -2238,13 +335,49 @@ inline float clampf(float x, float min, float max) {
 	return x;
 }
 
-inline vec3 random_in_unit_sphere()
+inline uint32_t pcgHash(uint32_t x)
+{
+	// https://www.reedbeta.com/blog/hash-functions-for-gpu-rendering/
+	uint32_t state = x*747796405u + 2891336453u;
+	uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state)*277803737u;
+	return (word >> 22u) ^ word;
+}
+
+// Counter-based random stream, every (seed, pixel, sample, dimension) key owns an independent sequence
+// so no state is shared between threads and a pass is reproducible whatever the tile order.
+struct rng
+{
+	uint32_t state{};
+
+	// -- Explicit basic constructors --
+	inline rng(uint32_t seed, uint32_t pixel, uint32_t sample, uint32_t dimension) :
+		state(pcgHash(seed + pcgHash(pixel + pcgHash(sample + pcgHash(dimension)))))
+	{
+	}
+
+	inline uint32_t next()
+	{
+		state = state*747796405u + 2891336453u;
+		uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state)*277803737u;
+		return (word >> 22u) ^ word;
+	}
+
+	// [0, 1)
+	inline float nextFloat()
+	{
+		return (next() >> 8)*(1.0f/16777216.0f);
+	}
+};
+
+uint32_t gSeed = 0x9E3779B9u;
+
+inline vec3 random_in_unit_sphere(rng& random)
 {
 	// https://datagenetics.com/blog/january32020/index.html
-	float theta = two_pi_real_dist(re);
-	float v = real_dist(re);
+	float theta = random.nextFloat()*M_2PI;
+	float v = random.nextFloat();
 	float phi = acosf((2.0f*v) - 1.0f);
-	float r = powf(real_dist(re), 1.0f/3.0f);
+	float r = powf(random.nextFloat(), 1.0f/3.0f);
 	return vec3(r*sinf(phi)*cos(theta), r*sinf(phi)*sin(theta), r*cos(phi));
 }
 
@@ -2264,41 +397,44 @@ struct aabb
 	}
 };
 
-inline bool hitAABB(const ray3& r, const aabb& aabb, float minT, float maxT)
+// Slab test against a precomputed 1/direction, flat boxes (axis aligned triangles) still count as hit
+inline bool hitAABB(const vec3& origin, const vec3& invDirection, const aabb& aabb, float minT, float maxT, float& entryT)
 {
+	BENCHMARK_COUNT(tNodeTests, 1);
 	{ // x
-		auto t0 = fmin((aabb.min.x - r.origin.x) / r.direction.x, (aabb.max.x - r.origin.x) / r.direction.x);
-		auto t1 = fmax((aabb.min.x - r.origin.x) / r.direction.x, (aabb.max.x - r.origin.x) / r.direction.x);
-		minT = fmax(t0, minT);
-		maxT = fmin(t1, maxT);
-		if (maxT <= minT)
+		auto t0 = (aabb.min.x - origin.x)*invDirection.x;
+		auto t1 = (aabb.max.x - origin.x)*invDirection.x;
+		minT = fmax(fmin(t0, t1), minT);
+		maxT = fmin(fmax(t0, t1), maxT);
+		if (maxT < minT)
 		{
 			return false;
 		}
 	}
 
 	{ // y
-		auto t0 = fmin((aabb.min.y - r.origin.y) / r.direction.y, (aabb.max.y - r.origin.y) / r.direction.y);
-		auto t1 = fmax((aabb.min.y - r.origin.y) / r.direction.y, (aabb.max.y - r.origin.y) / r.direction.y);
-		minT = fmax(t0, minT);
-		maxT = fmin(t1, maxT);
-		if (maxT <= minT)
+		auto t0 = (aabb.min.y - origin.y)*invDirection.y;
+		auto t1 = (aabb.max.y - origin.y)*invDirection.y;
+		minT = fmax(fmin(t0, t1), minT);
+		maxT = fmin(fmax(t0, t1), maxT);
+		if (maxT < minT)
 		{
 			return false;
 		}
 	}
 
 	{ // z
-		auto t0 = fmin((aabb.min.z - r.origin.z) / r.direction.z, (aabb.max.z - r.origin.z) / r.direction.z);
-		auto t1 = fmax((aabb.min.z - r.origin.z) / r.direction.z, (aabb.max.z - r.origin.z) / r.direction.z);
-		minT = fmax(t0, minT);
-		maxT = fmin(t1, maxT);
-		if (maxT <= minT)
+		auto t0 = (aabb.min.z - origin.z)*invDirection.z;
+		auto t1 = (aabb.max.z - origin.z)*invDirection.z;
+		minT = fmax(fmin(t0, t1), minT);
+		maxT = fmin(fmax(t0, t1), maxT);
+		if (maxT < minT)
 		{
 			return false;
 		}
 	}
 
+	entryT = minT;
 	return true;
 }
 
@@ -2314,15 +450,51 @@ inline aabb surroundingBox(const aabb& box0, const aabb& box1) {
     return aabb(small,big);
 }
 
+inline aabb emptyBox()
+{
+	return aabb(vec3(FLT_MAX, FLT_MAX, FLT_MAX), vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX));
+}
+
+inline aabb growBox(const aabb& box, const vec3& p)
+{
+	return aabb(vec3(std::min(box.min.x, p.x), std::min(box.min.y, p.y), std::min(box.min.z, p.z)),
+				vec3(std::max(box.max.x, p.x), std::max(box.max.y, p.y), std::max(box.max.z, p.z)));
+}
+
+// Same as surroundingBox without the NaN handling of fmin, cheap enough for the inner loops of the build
+inline aabb growBox(const aabb& box, const aabb& other)
+{
+	return aabb(vec3(std::min(box.min.x, other.min.x), std::min(box.min.y, other.min.y), std::min(box.min.z, other.min.z)),
+				vec3(std::max(box.max.x, other.max.x), std::max(box.max.y, other.max.y), std::max(box.max.z, other.max.z)));
+}
+
+inline float surfaceArea(const aabb& box)
+{
+	vec3 e = box.max - box.min;
+	return 2.0f*(e.x*e.y + e.y*e.z + e.z*e.x);
+}
+
+inline float axisOf(const vec3& v, int axis)
+{
+	return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+}
+
 
+// Closest hit, the traversal only records t and the primitive, completeHit() fills in the surface afterwards
 struct hit
 {
+	float t{};
+	int sphere = -1; // sphere index, -1 for a triangle
+	int instance{};
+	int triangle{};
+	float u{};
+	float v{};
+
 	vec3 point{};
 	vec3 normal{};
-	float t{};
 	bool frontFace{};
-	vec3 color{};
-	vec3 emit{};
+	int material{};
+	int light = -1; // index in gLights when the surface is a sampled emitter
 
 	// -- Implicit basic constructors --
 	constexpr hit() = default;
@@ -2335,804 +507,3863 @@ struct hit
 	}
 };
 
-struct baseObject
+struct material
 {
-	int id{};
-	aabb box{};
+	int type{};
+	vec3 color{};
+	vec3 emit{};
+	float fuzz{};
+};
 
-	// -- Implicit basic constructors --
-	constexpr baseObject() = default;
-	constexpr baseObject(baseObject const& s) = default;
+// Spheres as parallel arrays, the intersection loop only streams through centers and radii
+struct sphereSet
+{
+	std::vector<float> centerX{};
+	std::vector<float> centerY{};
+	std::vector<float> centerZ{};
+	std::vector<float> radius{};
+	std::vector<int> material{};
+	std::vector<int> light{};
+
+	inline int size() const
+	{
+		return (int)radius.size();
+	}
 
-	// -- Explicit basic constructors --
-	inline constexpr baseObject(int id) :
-		id(id)
+	inline vec3 center(int i) const
 	{
+		return vec3(centerX[i], centerY[i], centerZ[i]);
 	}
 };
 
-struct lambertianSphere
+// Triangles in edge form for Moller-Trumbore, shading normals are only read for the closest hit
+struct triangleSet
 {
-	baseObject base{};
-	vec3 center{};
-	float radius{};
-	vec3 color{};
-	vec3 emit{};
-
-	// -- Implicit basic constructors --
-	constexpr lambertianSphere() = default;
-	constexpr lambertianSphere(lambertianSphere const& s) = default;
+	std::vector<vec3> v0{};
+	std::vector<vec3> e1{};
+	std::vector<vec3> e2{};
+	std::vector<vec3> n0{};
+	std::vector<vec3> n1{};
+	std::vector<vec3> n2{};
+
+	inline int size() const
+	{
+		return (int)v0.size();
+	}
+};
 
-	// -- Explicit basic constructors --
-	inline constexpr lambertianSphere(const vec3& center, float radius, const vec3& color, const vec3& emit) :
-		base(1), center(center), radius(radius), color(color), emit(emit)
+// Unit vector folded onto the octahedron and unfolded into a square, 16 bits per coordinate
+inline void encodeOctahedral(const vec3& n, uint16_t out[2])
+{
+	float invL1 = 1.0f / (fabsf(n.x) + fabsf(n.y) + fabsf(n.z));
+	float x = n.x*invL1;
+	float y = n.y*invL1;
+	if (n.z < 0.0f)
 	{
-		base.box = aabb(center - vec3(radius, radius, radius), center + vec3(radius, radius, radius));
+		float fx = (1.0f - fabsf(y))*(x >= 0.0f ? 1.0f : -1.0f);
+		float fy = (1.0f - fabsf(x))*(y >= 0.0f ? 1.0f : -1.0f);
+		x = fx;
+		y = fy;
 	}
+	out[0] = (uint16_t)lrintf((clampf(x, -1.0f, 1.0f)*0.5f + 0.5f)*65535.0f);
+	out[1] = (uint16_t)lrintf((clampf(y, -1.0f, 1.0f)*0.5f + 0.5f)*65535.0f);
+}
+
+inline vec3 decodeOctahedral(const uint16_t in[2])
+{
+	float x = in[0]*(2.0f / 65535.0f) - 1.0f;
+	float y = in[1]*(2.0f / 65535.0f) - 1.0f;
+	float z = 1.0f - fabsf(x) - fabsf(y);
+	float fold = fmax(-z, 0.0f);
+	x += x >= 0.0f ? -fold : fold;
+	y += y >= 0.0f ? -fold : fold;
+	return vec3(x, y, z).normalize();
+}
+
+// Position as 16 bit fractions of the bounds of the leaf that owns the vertex, 10 bytes with the normal
+struct packedVertex
+{
+	uint16_t position[3];
+	uint16_t normal[2];
 };
 
-struct metalSphere
+inline vec3 unpackPosition(const packedVertex& v, const vec3& origin, const vec3& scale)
 {
-	baseObject base{};
-	vec3 center{};
-	float radius{};
-	vec3 color{};
-	float fuzz{};
+	return origin + vec3(v.position[0], v.position[1], v.position[2])*scale;
+}
 
-	// -- Implicit basic constructors --
-	constexpr metalSphere() = default;
-	constexpr metalSphere(metalSphere const& s) = default;
+// Quantized alternative to triangleSet. Every leaf owns a run of vertices and its triangles index into it with 8 bit corners,
+// the tree indices of a quantized mesh hold the start of the run of their leaf instead of triangle numbers.
+struct packedTriangleSet
+{
+	std::vector<packedVertex> vertices{};
+	std::vector<uint32_t> triangles{}; // corner0 | corner1 << 8 | corner2 << 16
 
-	// -- Explicit basic constructors --
-	inline constexpr metalSphere(const vec3& center, float radius, const vec3& color, float fuzz) :
-		base(2), center(center), radius(radius), color(color), fuzz(fuzz)
+	inline int size() const
+	{
+		return (int)triangles.size();
+	}
+};
+
+int gSimdLevel = SIMD_NONE;
+
+int detectSimdLevel()
+{
+#if TRACER_X86
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] >= 7)
 	{
-		base.box = aabb(center - vec3(radius, radius, radius), center + vec3(radius, radius, radius));
+		__cpuid(info, 1);
+		bool osxsave = (info[2] & (1 << 27)) != 0;
+		bool fma = (info[2] & (1 << 12)) != 0;
+		__cpuidex(info, 7, 0);
+		bool avx2 = (info[1] & (1 << 5)) != 0;
+		if (osxsave && fma && avx2 && (_xgetbv(0) & 6) == 6) return SIMD_AVX2;
 	}
+#else
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return SIMD_AVX2;
+#endif
+	return SIMD_SSE;
+#else
+	return SIMD_NONE;
+#endif
+}
+
+// Linear BVH, nodes are stored depth-first so the left child always follows its parent
+struct bvhNode
+{
+	aabb box{};
+	int offset{}; // interior: index of the right child, leaf: first entry in bvh::indices
+	int count{};  // 0 for interior nodes
+};
+static_assert(sizeof(bvhNode) == 32, "bvhNode should fill half a cache line");
+
+// Wide node for SIMD traversal, child bounds are stored per axis so one ray is tested against all W boxes at once
+template<int W>
+struct alignas(32) bvhWideNode
+{
+	float minX[W];
+	float minY[W];
+	float minZ[W];
+	float maxX[W];
+	float maxY[W];
+	float maxZ[W];
+	int child[W]; // interior: wide node index, leaf: first entry in bvh::indices
+	int count[W]; // primitives in a leaf, 0 for interior slots, -1 for empty slots
 };
 
-struct triangle
+struct bvh
 {
-	vec3 v0;
-	vec3 v1;
-	vec3 v2;
-	vec3 n0;
-	vec3 n1;
-	vec3 n2;
+	std::vector<bvhNode> nodes{};
+	std::vector<int> indices{};
+	float buildCost{}; // bvhCost() right after the last full build, refits are measured against it
 
-	// -- Implicit basic constructors --
-	constexpr triangle() = default;
-	constexpr triangle(triangle const&) = default;
+	// Collapsed copy of nodes for the SIMD level picked at startup
+	std::vector<bvhWideNode<4>> nodes4{};
+	std::vector<bvhWideNode<8>> nodes8{};
 
-	// -- Explicit basic constructors --
-	inline triangle(const vec3& v0, const vec3& v1, const vec3& v2, const vec3& n0, const vec3& n1, const vec3& n2) :
-		v0(v0), v1(v1), v2(v2), n0(n0), n1(n1), n2(n2)
+	size_t bytes() const
 	{
+		return nodes.size()*sizeof(bvhNode) + indices.size()*sizeof(int) + nodes4.size()*sizeof(bvhWideNode<4>) + nodes8.size()*sizeof(bvhWideNode<8>);
 	}
 };
 
-struct node
+struct bvhBin
 {
-	baseObject* pObject;
-	aabb box;
+	aabb box = emptyBox();
+	int count{};
+};
 
-	node* pLeft;
-	node* pRight;
+// Bounds and bins of one range of primitives, partial results of chunks are merged
+struct bvhRangeInfo
+{
+	aabb box = emptyBox();
+	aabb centroidBox = emptyBox();
+	bvhBin bins[3][BVH_BINS];
 };
 
-bool box_x_compare(const baseObject* a, const baseObject* b)
+// Primitives are partitioned by value so every sweep reads memory in order
+struct bvhPrimitive
 {
-	return a->box.min.x < b->box.min.x;
-}
+	aabb box;
+	vec3 centroid;
+	int index;
+};
 
-bool box_y_compare(const baseObject* a, const baseObject* b)
+// Shared by every task of one build
+struct bvhBuilder
 {
-	return a->box.min.y < b->box.min.y;
-}
+	bvh& tree;
+	std::vector<bvhPrimitive> primitives;
+	// Threads running besides the caller's, subtree tasks and chunk sweeps draw from the same gCores - 1
+	std::atomic<int> threads{ 0 };
 
+	// -- Explicit basic constructors --
+	explicit bvhBuilder(bvh& t) : tree(t) {}
+};
 
-bool box_z_compare(const baseObject* a, const baseObject* b)
+// Takes up to wanted threads from the build's budget, returns how many it got
+int bvhReserveThreads(bvhBuilder& builder, int wanted)
 {
-	return a->box.min.z < b->box.min.z;
+	int running = builder.threads.load();
+	for (;;)
+	{
+		int granted = std::min(wanted, (int)gCores - 1 - running);
+		if (granted <= 0) return 0;
+		if (builder.threads.compare_exchange_weak(running, running + granted)) return granted;
+	}
 }
 
+// Split [first, first + count) in one chunk per free core when it is large enough to pay for the threads.
+// Fewer chunks bin the same primitives, so the tree does not depend on how many threads were free.
+template<typename F>
+void bvhParallelChunks(bvhBuilder& builder, int first, int count, F&& chunk)
+{
+	int extra = count >= BVH_PARALLEL_BINNING ? bvhReserveThreads(builder, (int)gCores - 1) : 0;
+	int chunks = extra + 1;
+	std::vector<std::thread> threads;
+	for (int c = 1; c < chunks; ++c)
+	{
+		threads.push_back(std::thread(chunk, c, first + (int)((int64_t)count*c / chunks), first + (int)((int64_t)count*(c + 1) / chunks)));
+	}
+	chunk(0, first, first + (int)((int64_t)count / chunks));
+	for (auto& t : threads)
+	{
+		t.join();
+	}
+	builder.threads -= extra;
+}
 
-void nodeContructor(node* pNode, const std::vector<baseObject*>& objects, size_t start, size_t end)
+void bvhMergeRange(bvhRangeInfo& into, const bvhRangeInfo& from)
 {
-	size_t object_span = end - start;
+	into.box = growBox(into.box, from.box);
+	into.centroidBox = growBox(into.centroidBox, from.centroidBox);
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		for (int b = 0; b < BVH_BINS; ++b)
+		{
+			into.bins[axis][b].box = growBox(into.bins[axis][b].box, from.bins[axis][b].box);
+			into.bins[axis][b].count += from.bins[axis][b].count;
+		}
+	}
+}
 
-	int axis = axis_int_dist(re);
-	auto comparator = (axis == 0) ? box_x_compare
-					: (axis == 1) ? box_y_compare
-								  : box_z_compare;
-	if (object_span == 1)
+// Node index is the first slot of the 2*count - 1 reserved for the subtree, the left child follows it and the right one starts after the left reservation.
+// A binary traversal pushes at most one node per interior ancestor and a W wide one at most W - 1 per wide level,
+// collapsing never deepens the tree, so the depth limit keeps them within BVH_STACK_SIZE, *3 and *7 entries.
+void bvhSubdivide(bvhBuilder& builder, int index, int first, int count, int depth)
+{
+	bvh& tree = builder.tree;
+	auto& primitives = builder.primitives;
+
+	// Large ranges are swept in one chunk per free core, small ones straight into the result
+	bool parallel = count >= BVH_PARALLEL_BINNING && gCores > 1;
+	std::vector<bvhRangeInfo> partial(parallel ? gCores : 0);
+	bvhRangeInfo range;
+	auto bound = [&](bvhRangeInfo& info, int begin, int end)
+		{
+			for (int i = begin; i < end; ++i)
+			{
+				info.box = growBox(info.box, primitives[i].box);
+				info.centroidBox = growBox(info.centroidBox, primitives[i].centroid);
+			}
+		};
+	if (parallel)
+	{
+		bvhParallelChunks(builder, first, count, [&](int c, int begin, int end) { bound(partial[c], begin, end); });
+		for (const auto& p : partial)
+		{
+			range.box = growBox(range.box, p.box);
+			range.centroidBox = growBox(range.centroidBox, p.centroidBox);
+		}
+	}
+	else
 	{
-		pNode->pObject = objects[start];
-		pNode->pLeft = nullptr;
-		pNode->pRight = nullptr;
+		bound(range, first, first + count);
+	}
+	tree.nodes[index].box = range.box;
 
-		pNode->box = pNode->pObject->box;
-		return;
+	bool flat[3];
+	float minC[3];
+	float scale[3];
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		minC[axis] = axisOf(range.centroidBox.min, axis);
+		float extent = axisOf(range.centroidBox.max, axis) - minC[axis];
+		flat[axis] = extent < 1e-6f;
+		scale[axis] = BVH_BINS / extent;
 	}
 
-	if (object_span == 2)
+	// Bin all three axes in one sweep over the primitives
+	auto bin = [&](bvhRangeInfo& info, int begin, int end)
+		{
+			for (int i = begin; i < end; ++i)
+			{
+				const bvhPrimitive& primitive = primitives[i];
+				for (int axis = 0; axis < 3; ++axis)
+				{
+					if (flat[axis]) continue;
+
+					int b = std::min(BVH_BINS - 1, (int)((axisOf(primitive.centroid, axis) - minC[axis])*scale[axis]));
+					info.bins[axis][b].box = growBox(info.bins[axis][b].box, primitive.box);
+					++info.bins[axis][b].count;
+				}
+			}
+		};
+	if (count > 1 && parallel)
 	{
-		if (comparator(objects[start], objects[start + 1]) == true)
+		bvhParallelChunks(builder, first, count, [&](int c, int begin, int end) { bin(partial[c], begin, end); });
+		for (const auto& p : partial)
 		{
-			pNode->pLeft = new node();
-			pNode->pLeft->pObject = objects[start];
-			pNode->pLeft->box = pNode->pLeft->pObject->box;
-			pNode->pLeft->pLeft = nullptr;
-			pNode->pLeft->pRight = nullptr;
+			bvhMergeRange(range, p);
+		}
+	}
+	else if (count > 1)
+	{
+		bin(range, first, first + count);
+	}
 
-			pNode->pRight = new node();
-			pNode->pRight->pObject = objects[start + 1];
-			pNode->pRight->box = pNode->pRight->pObject->box;
-			pNode->pRight->pLeft = nullptr;
-			pNode->pRight->pRight = nullptr;
+	// Binned surface area heuristic, a traversal step and a primitive test both cost 1
+	float leafCost = (float)count;
+	float bestCost = FLT_MAX;
+	int bestAxis = -1;
+	int bestSplit = 0;
+	float invArea = 1.0f / fmax(surfaceArea(range.box), 1e-12f);
+	for (int axis = 0; axis < 3 && count > 1; ++axis)
+	{
+		if (flat[axis]) continue;
+
+		const bvhBin* bins = range.bins[axis];
+		float leftArea[BVH_BINS - 1];
+		int leftCount[BVH_BINS - 1];
+		aabb leftBox = emptyBox();
+		int leftSum = 0;
+		for (int b = 0; b < BVH_BINS - 1; ++b)
+		{
+			leftBox = growBox(leftBox, bins[b].box);
+			leftSum += bins[b].count;
+			leftArea[b] = leftSum > 0 ? surfaceArea(leftBox) : 0.0f;
+			leftCount[b] = leftSum;
 		}
-		else
+
+		aabb rightBox = emptyBox();
+		int rightSum = 0;
+		for (int b = BVH_BINS - 1; b > 0; --b)
 		{
-			pNode->pLeft = new node();
-			pNode->pLeft->pObject = objects[start + 1];
-			pNode->pLeft->box = pNode->pLeft->pObject->box;
-			pNode->pLeft->pLeft = nullptr;
-			pNode->pLeft->pRight = nullptr;
+			rightBox = growBox(rightBox, bins[b].box);
+			rightSum += bins[b].count;
+			if (leftCount[b - 1] == 0 || rightSum == 0) continue;
 
-			pNode->pRight = new node();
-			pNode->pRight->pObject = objects[start];
-			pNode->pRight->box = pNode->pRight->pObject->box;
-			pNode->pRight->pLeft = nullptr;
-			pNode->pRight->pRight = nullptr;
+			float cost = 1.0f + (leftArea[b - 1]*leftCount[b - 1] + surfaceArea(rightBox)*rightSum)*invArea;
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = b;
+			}
 		}
 	}
-	else
+
+	if (bestAxis == -1 || depth >= BVH_MAX_DEPTH || (count <= BVH_MAX_LEAF_SIZE && bestCost >= leafCost))
 	{
-		auto tmpObjects = objects;
-		std::sort(tmpObjects.begin() + start, tmpObjects.begin() + end, comparator);
+		tree.nodes[index].offset = first;
+		tree.nodes[index].count = count;
+		return;
+	}
+
+	auto middle = std::partition(primitives.begin() + first, primitives.begin() + first + count, [&](const bvhPrimitive& primitive)
+		{
+			return std::min(BVH_BINS - 1, (int)((axisOf(primitive.centroid, bestAxis) - minC[bestAxis])*scale[bestAxis])) < bestSplit;
+		});
+	int leftCount = (int)(middle - (primitives.begin() + first));
+
+	int right = index + 2*leftCount;
+	tree.nodes[index].offset = right;
+	tree.nodes[index].count = 0;
 
-		auto mid = start + object_span / 2;
-		pNode->pLeft = new node();
-		nodeContructor(pNode->pLeft, tmpObjects, start, mid);
-		pNode->pRight = new node();
-		nodeContructor(pNode->pRight, tmpObjects, mid, end);
+	// Hand the left subtree to a new thread while cores are free, the two reservations never overlap
+	bool spawn = leftCount >= BVH_PARALLEL_TASK && count - leftCount >= BVH_PARALLEL_TASK;
+	if (spawn && bvhReserveThreads(builder, 1) == 1)
+	{
+		std::thread left(bvhSubdivide, std::ref(builder), index + 1, first, leftCount, depth + 1);
+		bvhSubdivide(builder, right, first + leftCount, count - leftCount, depth + 1);
+		left.join();
+		--builder.threads;
+		return;
 	}
 
-	pNode->pObject = nullptr;
-	pNode->box = surroundingBox(pNode->pLeft->box, pNode->pRight->box);
+	bvhSubdivide(builder, index + 1, first, leftCount, depth + 1);
+	bvhSubdivide(builder, right, first + leftCount, count - leftCount, depth + 1);
 }
 
-void nodeDestructor(node* pNode)
+// Squeeze out the slots leaves did not use, depth first order and left = index + 1 survive
+void bvhCompact(bvh& tree)
 {
-	if (pNode->pLeft != nullptr) nodeDestructor(pNode->pLeft);
-	if (pNode->pRight != nullptr) nodeDestructor(pNode->pRight);
+	std::vector<int> remap(tree.nodes.size());
+	int used = 0;
+	for (size_t i = 0; i < tree.nodes.size(); ++i)
+	{
+		remap[i] = used;
+		if (tree.nodes[i].count >= 0) ++used;
+	}
+
+	for (size_t i = 0; i < tree.nodes.size(); ++i)
+	{
+		bvhNode node = tree.nodes[i];
+		if (node.count < 0) continue;
 
-	delete pNode->pLeft;
-	delete pNode->pRight;
+		if (node.count == 0) node.offset = remap[node.offset];
+		tree.nodes[remap[i]] = node;
+	}
+	tree.nodes.resize(used);
+	tree.nodes.shrink_to_fit();
 }
 
-node* gWorld = nullptr;
-std::vector<baseObject*> gObjects;
-lambertianSphere gFloor(vec3(0.0f, -100.0f, 0.0f), 100.0f, vec3(0.5f, 0.5f, 0.5f), vec3(0.0f, 0.0f, 0.0f));
+template<int W>
+void bvhSetSlot(bvhWideNode<W>& wide, int slot, const bvhNode& node)
+{
+	wide.minX[slot] = node.box.min.x;
+	wide.minY[slot] = node.box.min.y;
+	wide.minZ[slot] = node.box.min.z;
+	wide.maxX[slot] = node.box.max.x;
+	wide.maxY[slot] = node.box.max.y;
+	wide.maxZ[slot] = node.box.max.z;
+	wide.child[slot] = node.offset;
+	wide.count[slot] = node.count;
+}
 
-bool hitLambertianSphere(const ray3& r, const lambertianSphere& s, float minT, float maxT, hit& hit, vec3& scatterDirection)
+template<int W>
+int bvhCollapseNode(const bvh& tree, std::vector<bvhWideNode<W>>& wide, int index)
 {
-	vec3 oc = r.origin - s.center;
-	float a = vec3::dot(r.direction, r.direction);
-	float halfb = vec3::dot(oc, r.direction);
-	float c = vec3::dot(oc, oc) - s.radius*s.radius;
-	float discriminant = halfb*halfb - a*c;
-	if (discriminant < 0.0f) return false;
+	// Pull grandchildren up by repeatedly opening the interior child with the largest surface
+	int children[W];
+	int childCount = 0;
+	children[childCount++] = index + 1;
+	children[childCount++] = tree.nodes[index].offset;
+	while (childCount < W)
+	{
+		int best = -1;
+		float bestArea = -1.0f;
+		for (int i = 0; i < childCount; ++i)
+		{
+			const bvhNode& child = tree.nodes[children[i]];
+			if (child.count == 0 && surfaceArea(child.box) > bestArea)
+			{
+				best = i;
+				bestArea = surfaceArea(child.box);
+			}
+		}
+		if (best == -1) break;
 
-	float sqrtd = sqrtf(discriminant);
+		int opened = children[best];
+		children[best] = opened + 1;
+		children[childCount++] = tree.nodes[opened].offset;
+	}
 
-	float root = (-halfb - sqrtd)/a;
-	if (root < minT || maxT < root)
+	int wideIndex = (int)wide.size();
+	wide.push_back(bvhWideNode<W>());
+	for (int i = 0; i < W; ++i)
 	{
-		float root = (-halfb + sqrtd)/a;
-		if (root < minT || maxT < root)
+		if (i < childCount)
 		{
-			return false;
+			bvhSetSlot(wide[wideIndex], i, tree.nodes[children[i]]);
+		}
+		else
+		{
+			bvhSetSlot(wide[wideIndex], i, bvhNode{ emptyBox(), 0, -1 });
 		}
 	}
 
-	hit.t = root;
-	hit.point = r.at(root);
-	vec3 outwardNormal = (hit.point - s.center)/s.radius;
-	hit.faceNormal(r, outwardNormal);
-	hit.color = s.color;
-	hit.emit = s.emit;
-
+	for (int i = 0; i < childCount; ++i)
 	{
-		vec3 randomUnitSphere = random_in_unit_sphere();
-
-		scatterDirection = hit.normal + randomUnitSphere.normalize();
-		if ((fabsf(scatterDirection.x) < 1e-6f) && (fabsf(scatterDirection.y) < 1e-6f) && (fabsf(scatterDirection.z) < 1e-6f))
+		if (tree.nodes[children[i]].count == 0)
 		{
-			scatterDirection = hit.normal;
+			int child = bvhCollapseNode(tree, wide, children[i]);
+			wide[wideIndex].child[i] = child;
 		}
 	}
-
-	return true;
+	return wideIndex;
 }
 
-bool hitMetalSphere(const ray3& r, const metalSphere& s, float minT, float maxT, hit& hit, vec3& scatterDirection)
+template<int W>
+void bvhCollapseWide(const bvh& tree, std::vector<bvhWideNode<W>>& wide)
 {
-	vec3 oc = r.origin - s.center;
-	float a = vec3::dot(r.direction, r.direction);
-	float halfb = vec3::dot(oc, r.direction);
-	float c = vec3::dot(oc, oc) - s.radius*s.radius;
-	float discriminant = halfb*halfb - a*c;
-	if (discriminant < 0.0f) return false;
-
-	float sqrtd = sqrtf(discriminant);
-
-	float root = (-halfb - sqrtd)/a;
-	if (root < minT || maxT < root)
+	wide.clear();
+	if (tree.nodes[0].count > 0)
 	{
-		float root = (-halfb + sqrtd)/a;
-		if (root < minT || maxT < root)
+		// Single leaf, wrap it so the traversal always starts from an interior node
+		wide.push_back(bvhWideNode<W>());
+		bvhSetSlot(wide[0], 0, tree.nodes[0]);
+		for (int i = 1; i < W; ++i)
 		{
-			return false;
+			bvhSetSlot(wide[0], i, bvhNode{ emptyBox(), 0, -1 });
 		}
+		return;
 	}
-
-	hit.t = root;
-	hit.point = r.at(root);
-	vec3 outwardNormal = (hit.point - s.center)/s.radius;
-	hit.faceNormal(r, outwardNormal);
-	hit.color = s.color;
-	hit.emit = vec3(0.0f, 0.0f, 0.0f);
-
-	scatterDirection = r.direction - hit.normal*2.0f*vec3::dot(r.direction, hit.normal) + random_in_unit_sphere()*s.fuzz;
-	return vec3::dot(scatterDirection, hit.normal) > 0.0f;
+	bvhCollapseNode(tree, wide, 0);
 }
 
-bool hitTriangle(const ray3& r, const triangle& triangle, float minT, float maxT, hit& hit, vec3& scatterDirection)
+void bvhCollapse(bvh& tree)
 {
-	vec3 e1 = triangle.v1 - triangle.v0;
-	vec3 e2 = triangle.v2 - triangle.v0;
+	tree.nodes4.clear();
+	tree.nodes8.clear();
+	if (tree.nodes.empty()) return;
 
-	vec3 pvec = vec3::cross(r.direction, e2);
-	float det = vec3::dot(e1, pvec);
-	if (det > -0.0001f && det < 0.0001f)
+	if (gSimdLevel == SIMD_AVX2)
 	{
-		return false;
+		bvhCollapseWide(tree, tree.nodes8);
 	}
-
-	float invDet = 1.0f / det;
-	vec3 tvec = r.origin - triangle.v0;
-	float u = vec3::dot(tvec, pvec)*invDet;
-	if (u < 0.0f || u > 1.0f)
+	else if (gSimdLevel == SIMD_SSE)
 	{
-		return false;
+		bvhCollapseWide(tree, tree.nodes4);
 	}
+}
 
-	vec3 qvec = vec3::cross(tvec, e1);
-	float v = vec3::dot(r.direction, qvec)*invDet;
-	if (v < 0.0f || (u + v) > 1.0f)
+// Surface area heuristic cost of the whole tree relative to its root, the quantity the builder minimises
+float bvhCost(const bvh& tree)
+{
+	if (tree.nodes.empty()) return 0.0f;
+
+	float cost = 0.0f;
+	for (const auto& node : tree.nodes)
 	{
-		return false;
+		cost += surfaceArea(node.box)*(node.count > 0 ? node.count : 1);
 	}
+	return cost / fmax(surfaceArea(tree.nodes[0].box), 1e-12f);
+}
 
-	float root = vec3::dot(e2, qvec)*invDet;
-	if (root < minT || maxT < root)
+void bvhBuild(bvh& tree, const std::vector<aabb>& boxes)
+{
+#ifdef TRACER_BENCHMARK
+	auto start = high_resolution_clock::now();
+#endif
+	tree.nodes.clear();
+	tree.indices.resize(boxes.size());
+
+	bvhBuilder builder(tree);
+	builder.primitives.resize(boxes.size());
+	for (size_t i = 0; i < boxes.size(); ++i)
 	{
-		return false;
+		builder.primitives[i] = bvhPrimitive{ boxes[i], (boxes[i].min + boxes[i].max)*0.5f, (int)i };
 	}
 
-	hit.t = root;
-	hit.point = r.at(root);
-	vec3 outwardNormal = triangle.n1*u + triangle.n2*v + triangle.n0*(1.0f - u - v);
-	hit.faceNormal(r, outwardNormal);
+	if (boxes.empty()) return;
 
+	// Preallocated arena, a subtree over n primitives never needs more than 2n - 1 nodes, unused slots keep count -1
+	tree.nodes.assign(boxes.size()*2 - 1, bvhNode{ emptyBox(), 0, -1 });
+	bvhSubdivide(builder, 0, 0, (int)boxes.size(), 0);
+	bvhCompact(tree);
+	for (size_t i = 0; i < boxes.size(); ++i)
 	{
-		vec3 randomUnitSphere = random_in_unit_sphere();
-
-		scatterDirection = hit.normal + randomUnitSphere.normalize();
-		if ((fabsf(scatterDirection.x) < 1e-6f) && (fabsf(scatterDirection.y) < 1e-6f) && (fabsf(scatterDirection.z) < 1e-6f))
-		{
-			scatterDirection = hit.normal;
-		}
+		tree.indices[i] = builder.primitives[i].index;
 	}
+	tree.buildCost = bvhCost(tree);
 
-	return true;
+	bvhCollapse(tree);
+#ifdef TRACER_BENCHMARK
+	gBvhBuildMs += duration_cast<microseconds>(high_resolution_clock::now() - start).count() / 1000.0f;
+#endif
 }
 
-struct lambertianMesh
+// Bottom up over the depth first range [index, end) of one subtree, children follow their parent so a reverse sweep meets them first
+void bvhRefitRange(bvh& tree, const std::vector<aabb>& boxes, int index, int end)
 {
-	baseObject base{};
-	vec3 color{};
+	for (int i = end - 1; i >= index; --i)
+	{
+		bvhNode& node = tree.nodes[i];
+		if (node.count > 0)
+		{
+			aabb box = emptyBox();
+			for (int k = node.offset; k < node.offset + node.count; ++k)
+			{
+				box = growBox(box, boxes[tree.indices[k]]);
+			}
+			node.box = box;
+		}
+		else
+		{
+			node.box = growBox(tree.nodes[i + 1].box, tree.nodes[node.offset].box);
+		}
+	}
+}
+
+// Large subtrees hand their left child to another thread until every core has a share, like the build
+void bvhRefitSubtree(bvh& tree, const std::vector<aabb>& boxes, int index, int end, int threads)
+{
+	bvhNode& node = tree.nodes[index];
+	if (node.count == 0 && threads > 1 && end - index >= 2*BVH_PARALLEL_TASK)
+	{
+		std::thread left(bvhRefitSubtree, std::ref(tree), std::cref(boxes), index + 1, node.offset, threads / 2);
+		bvhRefitSubtree(tree, boxes, node.offset, end, threads - threads / 2);
+		left.join();
+		node.box = growBox(tree.nodes[index + 1].box, tree.nodes[node.offset].box);
+		return;
+	}
+	bvhRefitRange(tree, boxes, index, end);
+}
+
+// Keeps the topology and only recomputes the bounds, false once the tree got bad enough that it should be rebuilt instead
+bool bvhRefit(bvh& tree, const std::vector<aabb>& boxes)
+{
+	if (tree.nodes.empty()) return true;
+
+	bvhRefitSubtree(tree, boxes, 0, (int)tree.nodes.size(), (int)gCores);
+	bvhCollapse(tree);
+	return bvhCost(tree) <= tree.buildCost*BVH_REFIT_DEGRADATION;
+}
+
+// Object space triangles and their tree, shared by every instance of the mesh
+struct mesh
+{
+	triangleSet triangles{};
+	packedTriangleSet packed{}; // used instead of triangles when quantized
+	bool quantized{};
+	bvh tree{};
+	aabb box{};
+
+	inline int size() const
+	{
+		return quantized ? packed.size() : triangles.size();
+	}
+
+	size_t bytes() const
+	{
+		return triangles.size()*6*sizeof(vec3) + packed.vertices.size()*sizeof(packedVertex) + packed.triangles.size()*sizeof(uint32_t) + tree.bytes();
+	}
+};
+
+// Affine transform as the three rows of a 3x4 matrix, the last column is the translation
+struct transform
+{
+	float m[12] = { 1.0f, 0.0f, 0.0f, 0.0f,
+					0.0f, 1.0f, 0.0f, 0.0f,
+					0.0f, 0.0f, 1.0f, 0.0f };
+
+	inline vec3 point(const vec3& p) const
+	{
+		return vec3(m[0]*p.x + m[1]*p.y + m[2]*p.z + m[3],
+					m[4]*p.x + m[5]*p.y + m[6]*p.z + m[7],
+					m[8]*p.x + m[9]*p.y + m[10]*p.z + m[11]);
+	}
+
+	inline vec3 vector(const vec3& v) const
+	{
+		return vec3(m[0]*v.x + m[1]*v.y + m[2]*v.z,
+					m[4]*v.x + m[5]*v.y + m[6]*v.z,
+					m[8]*v.x + m[9]*v.y + m[10]*v.z);
+	}
+
+	// Transposed linear part, called on the inverse it takes object space normals to world space
+	inline vec3 normal(const vec3& n) const
+	{
+		return vec3(m[0]*n.x + m[4]*n.y + m[8]*n.z,
+					m[1]*n.x + m[5]*n.y + m[9]*n.z,
+					m[2]*n.x + m[6]*n.y + m[10]*n.z);
+	}
+
+	inline vec3 translation() const
+	{
+		return vec3(m[3], m[7], m[11]);
+	}
+
+	inline void setTranslation(const vec3& t)
+	{
+		m[3] = t.x;
+		m[7] = t.y;
+		m[11] = t.z;
+	}
+
+	transform inverse() const
+	{
+		// Adjugate of the linear part over its determinant, then the translation undone in the new frame
+		transform r;
+		float c0 = m[5]*m[10] - m[6]*m[9];
+		float c1 = m[6]*m[8] - m[4]*m[10];
+		float c2 = m[4]*m[9] - m[5]*m[8];
+		float invDet = 1.0f / (m[0]*c0 + m[1]*c1 + m[2]*c2);
+		r.m[0] = c0*invDet;
+		r.m[1] = (m[2]*m[9] - m[1]*m[10])*invDet;
+		r.m[2] = (m[1]*m[6] - m[2]*m[5])*invDet;
+		r.m[4] = c1*invDet;
+		r.m[5] = (m[0]*m[10] - m[2]*m[8])*invDet;
+		r.m[6] = (m[2]*m[4] - m[0]*m[6])*invDet;
+		r.m[8] = c2*invDet;
+		r.m[9] = (m[1]*m[8] - m[0]*m[9])*invDet;
+		r.m[10] = (m[0]*m[5] - m[1]*m[4])*invDet;
+		r.setTranslation(-r.vector(translation()));
+		return r;
+	}
+
+	// Scale, then rotate by angle radians around axis, then translate
+	static transform compose(const vec3& scale, const vec3& axis, float angle, const vec3& position)
+	{
+		vec3 a = vec3::dot(axis, axis) > 0.0f ? axis.normalize() : vec3(0.0f, 1.0f, 0.0f);
+		float c = cosf(angle);
+		float s = sinf(angle);
+		float k = 1.0f - c;
+		float rotation[9] =
+		{
+			c + a.x*a.x*k,       a.x*a.y*k - a.z*s,   a.x*a.z*k + a.y*s,
+			a.y*a.x*k + a.z*s,   c + a.y*a.y*k,       a.y*a.z*k - a.x*s,
+			a.z*a.x*k - a.y*s,   a.z*a.y*k + a.x*s,   c + a.z*a.z*k
+		};
+
+		transform t;
+		for (int row = 0; row < 3; ++row)
+		{
+			t.m[row*4 + 0] = rotation[row*3 + 0]*scale.x;
+			t.m[row*4 + 1] = rotation[row*3 + 1]*scale.y;
+			t.m[row*4 + 2] = rotation[row*3 + 2]*scale.z;
+		}
+		t.setTranslation(position);
+		return t;
+	}
+};
+
+// One placement of a shared mesh, rays are taken into mesh space instead of copying the triangles
+struct instance
+{
+	int mesh{};
+	int material{};
+	transform toWorld{};
+	transform toObject{}; // inverse of toWorld
+	aabb box{}; // world space
+};
+
+bvh gWorld;
+std::vector<material> gMaterials;
+sphereSet gSpheres;
+std::vector<mesh> gMeshes;
+std::vector<instance> gInstances;
+
+struct light
+{
+	vec3 center{};
+	float radius{};
 	vec3 emit{};
-	std::vector<triangle> triangles{};
+};
 
-	// -- Implicit basic constructors --
-	constexpr lambertianMesh() = default;
-	constexpr lambertianMesh(lambertianMesh const& mesh) = default;
+std::vector<light> gLights;
 
-	// -- Explicit basic constructors --
-	inline lambertianMesh(const std::vector<vec3>& vertices, const std::vector<vec3>& normals, const std::vector<int> indices, const vec3& scale, const vec3& position, const vec3& color, const vec3& emit) :
-		base(3), color(color), emit(emit)
+// Sine motion around the position an object was loaded at
+struct animation
+{
+	int sphere = -1; // gSpheres index, -1 when an instance moves
+	int instance = -1;
+	vec3 origin{};
+	vec3 amplitude{};
+	float frequency{}; // Hz
+};
+
+std::vector<animation> gAnimations;
+std::atomic<bool> gAnimationPaused{ false };
+float gSceneTime = 0.0f; // seconds, tracer thread
+int gRefits = 0;
+int gRebuilds = 0;
+
+// World bounds of the corners of the mesh box
+void placeInstance(instance& i, const transform& toWorld)
+{
+	const aabb& box = gMeshes[i.mesh].box;
+	i.toWorld = toWorld;
+	i.toObject = toWorld.inverse();
+	i.box = emptyBox();
+	for (int corner = 0; corner < 8; ++corner)
+	{
+		vec3 p((corner & 1) ? box.max.x : box.min.x, (corner & 2) ? box.max.y : box.min.y, (corner & 4) ? box.max.z : box.min.z);
+		i.box = growBox(i.box, toWorld.point(p));
+	}
+}
+
+// Top level primitives, spheres first then instances
+std::vector<aabb> worldBoxes()
+{
+	std::vector<aabb> boxes;
+	boxes.reserve(gSpheres.size() + gInstances.size());
+	for (int i = 0; i < gSpheres.size(); ++i)
+	{
+		vec3 r(gSpheres.radius[i], gSpheres.radius[i], gSpheres.radius[i]);
+		boxes.push_back(aabb(gSpheres.center(i) - r, gSpheres.center(i) + r));
+	}
+	for (const auto& i : gInstances)
+	{
+		boxes.push_back(i.box);
+	}
+	return boxes;
+}
+
+void buildWorld()
+{
+	bvhBuild(gWorld, worldBoxes());
+
+	// Spheres first in every leaf, see sceneHit()
+	for (const auto& node : gWorld.nodes)
+	{
+		if (node.count > 0)
+		{
+			std::sort(gWorld.indices.begin() + node.offset, gWorld.indices.begin() + node.offset + node.count);
+		}
+	}
+}
+
+// Moves every animated object to where it is at time seconds, then refits the top level or rebuilds it when the refit got too loose.
+// Only called while the workers are idle.
+void animateScene(float time)
+{
+	for (const auto& a : gAnimations)
+	{
+		vec3 p = a.origin + a.amplitude*sinf(M_2PI*a.frequency*time);
+		if (a.sphere >= 0)
+		{
+			gSpheres.centerX[a.sphere] = p.x;
+			gSpheres.centerY[a.sphere] = p.y;
+			gSpheres.centerZ[a.sphere] = p.z;
+			if (gSpheres.light[a.sphere] >= 0)
+			{
+				gLights[gSpheres.light[a.sphere]].center = p;
+			}
+		}
+		else
+		{
+			transform toWorld = gInstances[a.instance].toWorld;
+			toWorld.setTranslation(p);
+			placeInstance(gInstances[a.instance], toWorld);
+		}
+	}
+
+	if (bvhRefit(gWorld, worldBoxes()))
+	{
+		++gRefits;
+	}
+	else
+	{
+		buildWorld();
+		++gRebuilds;
+	}
+}
+
+// Iterative traversal, the nearer child is visited first and the farther one waits on the stack with its entry distance.
+// leafHit(primitives, count, box, minT, maxT) intersects the primitives of one leaf and shrinks maxT on a hit.
+template<typename leafFn>
+bool bvhTraverseScalar(const bvh& tree, const ray3& r, float minT, float maxT, leafFn&& leafHit)
+{
+	vec3 invDirection(1.0f / r.direction.x, 1.0f / r.direction.y, 1.0f / r.direction.z);
+
+	float entryT;
+	if (hitAABB(r.origin, invDirection, tree.nodes[0].box, minT, maxT, entryT) == false) return false;
+
+	int stack[BVH_STACK_SIZE];
+	float stackT[BVH_STACK_SIZE];
+	int stackSize = 0;
+
+	bool isHit = false;
+	int index = 0;
+	for (;;)
+	{
+		const bvhNode& node = tree.nodes[index];
+		if (node.count > 0)
+		{
+			if (leafHit(&tree.indices[node.offset], node.count, node.box, minT, maxT) == true)
+			{
+				isHit = true;
+			}
+		}
+		else
+		{
+			int nearChild = index + 1;
+			int farChild = node.offset;
+			float nearT;
+			float farT;
+			bool hitNear = hitAABB(r.origin, invDirection, tree.nodes[nearChild].box, minT, maxT, nearT);
+			bool hitFar = hitAABB(r.origin, invDirection, tree.nodes[farChild].box, minT, maxT, farT);
+			if (hitNear && hitFar)
+			{
+				if (farT < nearT)
+				{
+					std::swap(nearChild, farChild);
+					std::swap(nearT, farT);
+				}
+				stack[stackSize] = farChild;
+				stackT[stackSize] = farT;
+				++stackSize;
+				index = nearChild;
+				continue;
+			}
+			if (hitNear || hitFar)
+			{
+				index = hitNear ? nearChild : farChild;
+				continue;
+			}
+		}
+
+		// Pop the next subtree that can still hold a closer hit
+		index = -1;
+		while (stackSize > 0)
+		{
+			--stackSize;
+			if (stackT[stackSize] < maxT)
+			{
+				index = stack[stackSize];
+				break;
+			}
+		}
+		if (index == -1) break;
+	}
+
+	return isHit;
+}
+
+#if TRACER_X86
+// Ray against the 4 child boxes of a wide node, returns the hit mask and writes the entry distances
+inline int hitWideNode(const bvhWideNode<4>& node, const __m128 origin[3], const __m128 invDirection[3], __m128 minT, __m128 maxT, float* entryT)
+{
+	BENCHMARK_COUNT(tNodeTests, 4);
+	__m128 t0x = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minX), origin[0]), invDirection[0]);
+	__m128 t1x = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxX), origin[0]), invDirection[0]);
+	__m128 t0y = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minY), origin[1]), invDirection[1]);
+	__m128 t1y = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxY), origin[1]), invDirection[1]);
+	__m128 t0z = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minZ), origin[2]), invDirection[2]);
+	__m128 t1z = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxZ), origin[2]), invDirection[2]);
+
+	__m128 tNear = _mm_max_ps(_mm_max_ps(_mm_min_ps(t0x, t1x), _mm_min_ps(t0y, t1y)), _mm_max_ps(_mm_min_ps(t0z, t1z), minT));
+	__m128 tFar = _mm_min_ps(_mm_min_ps(_mm_max_ps(t0x, t1x), _mm_max_ps(t0y, t1y)), _mm_min_ps(_mm_max_ps(t0z, t1z), maxT));
+
+	_mm_storeu_ps(entryT, tNear);
+	return _mm_movemask_ps(_mm_cmple_ps(tNear, tFar));
+}
+
+// Same for the 8 child boxes, (bound - origin)/direction folds into one fused multiply-subtract
+TARGET_AVX2 inline int hitWideNode(const bvhWideNode<8>& node, const __m256 origin[3], const __m256 invDirection[3], __m256 minT, __m256 maxT, float* entryT)
+{
+	BENCHMARK_COUNT(tNodeTests, 8);
+	__m256 t0x = _mm256_fmsub_ps(_mm256_load_ps(node.minX), invDirection[0], origin[0]);
+	__m256 t1x = _mm256_fmsub_ps(_mm256_load_ps(node.maxX), invDirection[0], origin[0]);
+	__m256 t0y = _mm256_fmsub_ps(_mm256_load_ps(node.minY), invDirection[1], origin[1]);
+	__m256 t1y = _mm256_fmsub_ps(_mm256_load_ps(node.maxY), invDirection[1], origin[1]);
+	__m256 t0z = _mm256_fmsub_ps(_mm256_load_ps(node.minZ), invDirection[2], origin[2]);
+	__m256 t1z = _mm256_fmsub_ps(_mm256_load_ps(node.maxZ), invDirection[2], origin[2]);
+
+	__m256 tNear = _mm256_max_ps(_mm256_max_ps(_mm256_min_ps(t0x, t1x), _mm256_min_ps(t0y, t1y)), _mm256_max_ps(_mm256_min_ps(t0z, t1z), minT));
+	__m256 tFar = _mm256_min_ps(_mm256_min_ps(_mm256_max_ps(t0x, t1x), _mm256_max_ps(t0y, t1y)), _mm256_min_ps(_mm256_max_ps(t0z, t1z), maxT));
+
+	_mm256_storeu_ps(entryT, tNear);
+	return _mm256_movemask_ps(_mm256_cmp_ps(tNear, tFar, _CMP_LE_OQ));
+}
+
+// Shared wide traversal step, hit children are sorted by entry distance: leaves are intersected right away
+// from near to far, interior children are pushed far to near so the nearest one is popped next.
+template<int W, typename leafFn>
+inline bool bvhVisitWide(const bvhWideNode<W>& node, int mask, const float* entryT, const std::vector<int>& indices,
+						 float minT, float& maxT, int* stack, float* stackT, int& stackSize, leafFn&& leafHit)
+{
+	int order[W];
+	int orderCount = 0;
+	for (int i = 0; i < W; ++i)
+	{
+		if ((mask & (1 << i)) == 0 || node.count[i] < 0) continue;
+
+		int j = orderCount++;
+		while (j > 0 && entryT[order[j - 1]] > entryT[i])
+		{
+			order[j] = order[j - 1];
+			--j;
+		}
+		order[j] = i;
+	}
+
+	bool isHit = false;
+	for (int k = 0; k < orderCount; ++k)
+	{
+		int i = order[k];
+		if (node.count[i] == 0 || entryT[i] > maxT) continue;
+
+		aabb box(vec3(node.minX[i], node.minY[i], node.minZ[i]), vec3(node.maxX[i], node.maxY[i], node.maxZ[i]));
+		if (leafHit(&indices[node.child[i]], node.count[i], box, minT, maxT) == true)
+		{
+			isHit = true;
+		}
+	}
+
+	for (int k = orderCount - 1; k >= 0; --k)
+	{
+		int i = order[k];
+		if (node.count[i] != 0 || entryT[i] > maxT) continue;
+
+		stack[stackSize] = node.child[i];
+		stackT[stackSize] = entryT[i];
+		++stackSize;
+	}
+	return isHit;
+}
+
+template<typename leafFn>
+bool bvhTraverse4(const bvh& tree, const ray3& r, float minT, float maxT, leafFn&& leafHit)
+{
+	__m128 origin[3] = { _mm_set1_ps(r.origin.x), _mm_set1_ps(r.origin.y), _mm_set1_ps(r.origin.z) };
+	__m128 invDirection[3] = { _mm_set1_ps(1.0f / r.direction.x), _mm_set1_ps(1.0f / r.direction.y), _mm_set1_ps(1.0f / r.direction.z) };
+	__m128 minT4 = _mm_set1_ps(minT);
+
+	int stack[BVH_STACK_SIZE*3];
+	float stackT[BVH_STACK_SIZE*3];
+	int stackSize = 1;
+	stack[0] = 0;
+	stackT[0] = minT;
+
+	bool isHit = false;
+	while (stackSize > 0)
 	{
-		auto tmpVertices = vertices;
-		for (auto& v : tmpVertices)
+		--stackSize;
+		if (stackT[stackSize] > maxT) continue;
+
+		const bvhWideNode<4>& node = tree.nodes4[stack[stackSize]];
+		alignas(16) float entryT[4];
+		int mask = hitWideNode(node, origin, invDirection, minT4, _mm_set1_ps(maxT), entryT);
+		if (bvhVisitWide(node, mask, entryT, tree.indices, minT, maxT, stack, stackT, stackSize, leafHit) == true)
 		{
-			v.x = v.x*scale.x + position.x;
-			v.y = v.y*scale.y + position.y;
-			v.z = v.z*scale.z + position.z;
+			isHit = true;
 		}
+	}
+	return isHit;
+}
+
+template<typename leafFn>
+TARGET_AVX2 bool bvhTraverse8(const bvh& tree, const ray3& r, float minT, float maxT, leafFn&& leafHit)
+{
+	__m256 invDirection[3] = { _mm256_set1_ps(1.0f / r.direction.x), _mm256_set1_ps(1.0f / r.direction.y), _mm256_set1_ps(1.0f / r.direction.z) };
+	__m256 origin[3] =
+	{
+		_mm256_mul_ps(_mm256_set1_ps(r.origin.x), invDirection[0]),
+		_mm256_mul_ps(_mm256_set1_ps(r.origin.y), invDirection[1]),
+		_mm256_mul_ps(_mm256_set1_ps(r.origin.z), invDirection[2])
+	};
+	__m256 minT8 = _mm256_set1_ps(minT);
+
+	int stack[BVH_STACK_SIZE*7];
+	float stackT[BVH_STACK_SIZE*7];
+	int stackSize = 1;
+	stack[0] = 0;
+	stackT[0] = minT;
+
+	bool isHit = false;
+	while (stackSize > 0)
+	{
+		--stackSize;
+		if (stackT[stackSize] > maxT) continue;
 
-		vec3 min(FLT_MAX, FLT_MAX, FLT_MAX);
-		for (const auto& v : tmpVertices)
+		const bvhWideNode<8>& node = tree.nodes8[stack[stackSize]];
+		alignas(32) float entryT[8];
+		int mask = hitWideNode(node, origin, invDirection, minT8, _mm256_set1_ps(maxT), entryT);
+		if (bvhVisitWide(node, mask, entryT, tree.indices, minT, maxT, stack, stackT, stackSize, leafHit) == true)
 		{
-			min.x = fmin(min.x, v.x);
-			min.y = fmin(min.y, v.y);
-			min.z = fmin(min.z, v.z);
+			isHit = true;
 		}
+	}
+	return isHit;
+}
+#endif
+
+// Dispatch on the wide layout built for the SIMD level detected at startup
+template<typename leafFn>
+bool bvhTraverse(const bvh& tree, const ray3& r, float minT, float maxT, leafFn&& leafHit)
+{
+	if (tree.nodes.empty()) return false;
+
+#if TRACER_X86
+	if (tree.nodes8.empty() == false) return bvhTraverse8(tree, r, minT, maxT, leafHit);
+	if (tree.nodes4.empty() == false) return bvhTraverse4(tree, r, minT, maxT, leafHit);
+#endif
+	return bvhTraverseScalar(tree, r, minT, maxT, leafHit);
+}
+
+inline bool hitSphere(const ray3& r, const vec3& center, float radius, float minT, float maxT, float& t)
+{
+	BENCHMARK_COUNT(tPrimitiveTests, 1);
+	vec3 oc = r.origin - center;
+	float a = vec3::dot(r.direction, r.direction);
+	float halfb = vec3::dot(oc, r.direction);
+	float c = vec3::dot(oc, oc) - radius*radius;
+	float discriminant = halfb*halfb - a*c;
+	if (discriminant < 0.0f) return false;
+
+	float sqrtd = sqrtf(discriminant);
 
-		vec3 max(-FLT_MIN, -FLT_MAX, -FLT_MAX);
-		for (const auto& v : tmpVertices)
+	float root = (-halfb - sqrtd)/a;
+	if (root < minT || maxT < root)
+	{
+		root = (-halfb + sqrtd)/a;
+		if (root < minT || maxT < root)
 		{
-			max.x = fmax(max.x, v.x);
-			max.y = fmax(max.y, v.y);
-			max.z = fmax(max.z, v.z);
+			return false;
 		}
+	}
+
+	t = root;
+	return true;
+}
+
+inline bool hitTriangle(const ray3& r, const vec3& v0, const vec3& e1, const vec3& e2, float minT, float maxT, float& t, float& u, float& v)
+{
+	BENCHMARK_COUNT(tPrimitiveTests, 1);
+	vec3 pvec = vec3::cross(r.direction, e2);
+	float det = vec3::dot(e1, pvec);
+	if (det > -0.0001f && det < 0.0001f)
+	{
+		return false;
+	}
+
+	float invDet = 1.0f / det;
+	vec3 tvec = r.origin - v0;
+	u = vec3::dot(tvec, pvec)*invDet;
+	if (u < 0.0f || u > 1.0f)
+	{
+		return false;
+	}
+
+	vec3 qvec = vec3::cross(tvec, e1);
+	v = vec3::dot(r.direction, qvec)*invDet;
+	if (v < 0.0f || (u + v) > 1.0f)
+	{
+		return false;
+	}
 
-		base.box = aabb(min, max);
+	t = vec3::dot(e2, qvec)*invDet;
+	return minT <= t && t <= maxT;
+}
+
+// The object space direction is not renormalised, so t means the same distance along the ray in both spaces
+bool hitInstance(const ray3& r, int instanceIndex, float minT, float maxT, hit& hit)
+{
+	const instance& object = gInstances[instanceIndex];
+	const mesh& m = gMeshes[object.mesh];
+	ray3 local(object.toObject.point(r.origin), object.toObject.vector(r.direction));
+	auto triangleHit = [&](int i, float t, float u, float v)
+		{
+			hit.t = t;
+			hit.sphere = -1;
+			hit.instance = instanceIndex;
+			hit.triangle = i;
+			hit.u = u;
+			hit.v = v;
+		};
+
+	if (m.quantized)
+	{
+		// Positions are relative to the bounds the traversal just tested, decode the corners right before the test
+		return bvhTraverse(m.tree, local, minT, maxT, [&](const int* primitives, int count, const aabb& box, float minT, float& maxT)
+			{
+				int first = (int)(primitives - m.tree.indices.data());
+				const uint32_t* triangles = m.packed.triangles.data() + first;
+				const packedVertex* vertices = m.packed.vertices.data() + primitives[0];
+				vec3 scale = (box.max - box.min)*(1.0f / 65535.0f);
+				bool isHit = false;
+				for (int k = 0; k < count; ++k)
+				{
+					uint32_t corners = triangles[k];
+					vec3 p0 = unpackPosition(vertices[corners & 0xff], box.min, scale);
+					vec3 p1 = unpackPosition(vertices[(corners >> 8) & 0xff], box.min, scale);
+					vec3 p2 = unpackPosition(vertices[(corners >> 16) & 0xff], box.min, scale);
+					float t, u, v;
+					if (hitTriangle(local, p0, p1 - p0, p2 - p0, minT, maxT, t, u, v) == true)
+					{
+						triangleHit(first + k, t, u, v);
+						maxT = t;
+						isHit = true;
+					}
+				}
+				return isHit;
+			});
+	}
+
+	return bvhTraverse(m.tree, local, minT, maxT, [&](const int* primitives, int count, const aabb&, float minT, float& maxT)
+		{
+			bool isHit = false;
+			for (int k = 0; k < count; ++k)
+			{
+				int i = primitives[k];
+				float t, u, v;
+				if (hitTriangle(local, m.triangles.v0[i], m.triangles.e1[i], m.triangles.e2[i], minT, maxT, t, u, v) == true)
+				{
+					triangleHit(i, t, u, v);
+					maxT = t;
+					isHit = true;
+				}
+			}
+			return isHit;
+		});
+}
+
+// Top level, leaf entries are sorted by type (spheres below gSpheres.size(), then instances) so each type runs its own tight loop
+bool sceneHit(const ray3& r, float minT, float maxT, hit& hit)
+{
+	int sphereCount = gSpheres.size();
+	return bvhTraverse(gWorld, r, minT, maxT, [&](const int* primitives, int count, const aabb&, float minT, float& maxT)
+		{
+			bool isHit = false;
+			int k = 0;
+			for (; k < count && primitives[k] < sphereCount; ++k)
+			{
+				int i = primitives[k];
+				float t;
+				if (hitSphere(r, gSpheres.center(i), gSpheres.radius[i], minT, maxT, t) == true)
+				{
+					hit.t = t;
+					hit.sphere = i;
+					maxT = t;
+					isHit = true;
+				}
+			}
+			for (; k < count; ++k)
+			{
+				if (hitInstance(r, primitives[k] - sphereCount, minT, maxT, hit) == true)
+				{
+					maxT = hit.t;
+					isHit = true;
+				}
+			}
+			return isHit;
+		});
+}
 
-		int triangleCount = indices.size() / 3;
-		for (size_t i = 0; i < triangleCount; ++i)
+void completeHit(const ray3& r, hit& hit)
+{
+	hit.point = r.at(hit.t);
+	if (hit.sphere >= 0)
+	{
+		hit.faceNormal(r, (hit.point - gSpheres.center(hit.sphere))/gSpheres.radius[hit.sphere]);
+		hit.material = gSpheres.material[hit.sphere];
+		hit.light = gSpheres.light[hit.sphere];
+	}
+	else
+	{
+		const instance& object = gInstances[hit.instance];
+		const mesh& m = gMeshes[object.mesh];
+		int i = hit.triangle;
+		vec3 n;
+		if (m.quantized)
+		{
+			uint32_t corners = m.packed.triangles[i];
+			const packedVertex* vertices = m.packed.vertices.data() + m.tree.indices[i];
+			n = decodeOctahedral(vertices[(corners >> 8) & 0xff].normal)*hit.u + decodeOctahedral(vertices[(corners >> 16) & 0xff].normal)*hit.v
+			  + decodeOctahedral(vertices[corners & 0xff].normal)*(1.0f - hit.u - hit.v);
+		}
+		else
 		{
-			int index0 = indices[i*3 + 0];
-			int index1 = indices[i*3 + 1];
-			int index2 = indices[i*3 + 2];
-			triangles.push_back(triangle
-			(
-				tmpVertices[index0], tmpVertices[index1], tmpVertices[index2],
-				normals[index0], normals[index1], normals[index2]
-			));
+			n = m.triangles.n1[i]*hit.u + m.triangles.n2[i]*hit.v + m.triangles.n0[i]*(1.0f - hit.u - hit.v);
 		}
+		hit.faceNormal(r, object.toObject.normal(n).normalize());
+		hit.material = object.material;
+		hit.light = -1;
+	}
+}
+
+// Solid angle density of sampling light l from point p, uniform cone toward the sphere
+inline float lightPdf(const light& l, const vec3& p)
+{
+	vec3 toCenter = l.center - p;
+	float distance2 = vec3::dot(toCenter, toCenter);
+	float sinMax2 = l.radius*l.radius / distance2;
+	if (sinMax2 >= 1.0f) return 0.0f;
+
+	float cosMax = sqrtf(1.0f - sinMax2);
+	return 1.0f / (M_2PI*(1.0f - cosMax)*gLights.size());
+}
+
+inline float powerHeuristic(float pdf, float otherPdf)
+{
+	return pdf*pdf / (pdf*pdf + otherPdf*otherPdf);
+}
+
+// Next event estimation from a diffuse hit: pick one emissive sphere, sample the cone it subtends
+// and weight the unoccluded contribution against the cosine lobe with the power heuristic.
+vec3 sampleLights(const hit& hit, const vec3& albedo, rng& random)
+{
+	const light& l = gLights[std::min((size_t)(random.nextFloat()*gLights.size()), gLights.size() - 1)];
+	float pdf = lightPdf(l, hit.point);
+	if (pdf <= 0.0f) return vec3();
+
+	vec3 w = (l.center - hit.point).normalize();
+	vec3 u = vec3::cross(fabsf(w.x) > 0.9f ? vec3(0.0f, 1.0f, 0.0f) : vec3(1.0f, 0.0f, 0.0f), w).normalize();
+	vec3 v = vec3::cross(w, u);
+
+	vec3 toCenter = l.center - hit.point;
+	float cosMax = sqrtf(1.0f - l.radius*l.radius / vec3::dot(toCenter, toCenter));
+	float cosTheta = 1.0f - random.nextFloat()*(1.0f - cosMax);
+	float sinTheta = sqrtf(fmax(0.0f, 1.0f - cosTheta*cosTheta));
+	float phi = random.nextFloat()*M_2PI;
+	vec3 direction = u*(cosf(phi)*sinTheta) + v*(sinf(phi)*sinTheta) + w*cosTheta;
+
+	float cosSurface = vec3::dot(direction, hit.normal);
+	if (cosSurface <= 0.0f) return vec3();
+
+	ray3 shadow(hit.point, direction);
+	float lightT;
+	if (hitSphere(shadow, l.center, l.radius, 0.001f, FLT_MAX, lightT) == false) return vec3();
+
+	++tRayCount;
+	::hit occluder;
+	if (sceneHit(shadow, 0.001f, lightT*0.999f, occluder) == true) return vec3();
+
+	float bsdfPdf = cosSurface*M_INV_PI;
+	return albedo*l.emit*(M_INV_PI*cosSurface*powerHeuristic(pdf, bsdfPdf)/pdf);
+}
+
+// Iterative path integrator: throughput is carried along the path instead of recursing per bounce,
+// paths are cut by Russian roulette after RUSSIAN_ROULETTE_DEPTH bounces and gRayDepth at most.
+// One path in flight, the sorted tile renderer keeps a whole tile of them between bounces
+struct pathState
+{
+	ray3 r{};
+	vec3 radiance{};
+	vec3 throughput = vec3(1.0f, 1.0f, 1.0f);
+	float bsdfPdf{}; // density of the last diffuse bounce, 0 after camera or metal bounces
+	uint32_t pixel{};
+	uint32_t sample{};
+	uint32_t key{};
+};
+
+// Adds one vertex to the path, false once it escaped, was absorbed or lost the roulette
+bool extendPath(pathState& p, int bounce)
+{
+	rng random(gSeed, p.pixel, p.sample, bounce + 1);
+	++tRayCount;
+
+	hit hit;
+	if (sceneHit(p.r, 0.001f, 1000.0f, hit) == false)
+	{
+		p.radiance = p.radiance + p.throughput*vec3(0.5f, 0.7f, 1.0f);
+		return false;
+	}
+	completeHit(p.r, hit);
+	const material& m = gMaterials[hit.material];
+
+	if (hit.light >= 0 && p.bsdfPdf > 0.0f)
+	{
+		// Also reachable by next event estimation from the previous vertex
+		float pdf = lightPdf(gLights[hit.light], p.r.origin);
+		p.radiance = p.radiance + p.throughput*m.emit*powerHeuristic(p.bsdfPdf, pdf);
+	}
+	else
+	{
+		p.radiance = p.radiance + p.throughput*m.emit;
+	}
+
+	vec3 scatterDirection;
+	if (m.type == MATERIAL_METAL)
+	{
+		scatterDirection = p.r.direction - hit.normal*2.0f*vec3::dot(p.r.direction, hit.normal) + random_in_unit_sphere(random)*m.fuzz;
+		if (vec3::dot(scatterDirection, hit.normal) <= 0.0f) return false;
+		p.bsdfPdf = 0.0f;
+	}
+	else
+	{
+		if (gLights.empty() == false)
+		{
+			p.radiance = p.radiance + p.throughput*sampleLights(hit, m.color, random);
+		}
+
+		scatterDirection = (hit.normal + random_in_unit_sphere(random).normalize()).normalize();
+		float cosTheta = vec3::dot(scatterDirection, hit.normal);
+		if (cosTheta < 1e-6f)
+		{
+			scatterDirection = hit.normal;
+			cosTheta = 1.0f;
+		}
+		p.bsdfPdf = cosTheta*M_INV_PI;
+	}
+	p.throughput = p.throughput*m.color;
+
+	if (bounce + 1 >= RUSSIAN_ROULETTE_DEPTH)
+	{
+		float survive = clampf(fmax(p.throughput.x, fmax(p.throughput.y, p.throughput.z)), 0.05f, 0.95f);
+		if (random.nextFloat() >= survive) return false;
+		p.throughput = p.throughput/survive;
+	}
+
+	p.r = ray3(hit.point, scatterDirection);
+	return true;
+}
+
+vec3 rayColor(ray3 r, uint32_t pixel, uint32_t sample)
+{
+	pathState p;
+	p.r = r;
+	p.pixel = pixel;
+	p.sample = sample;
+	for (int bounce = 0; bounce < gRayDepth && extendPath(p, bounce); ++bounce)
+	{
+	}
+	return p.radiance;
+}
+
+inline float luminance(const vec3& c)
+{
+	return 0.2126f*c.x + 0.7152f*c.y + 0.0722f*c.z;
+}
+
+// Standard error of the mean through the sqrt tonemap, d(sqrt(x)) = dx/(2*sqrt(x))
+float pixelError(int index)
+{
+	int n = gPixelSamples[index];
+	if (n < 2) return FLT_MAX;
+
+	float mean = luminance(gStoragePixels[index]) / n;
+	float variance = fmax(0.0f, gStorageSquares[index]/n - mean*mean)*n/(n - 1);
+	return sqrtf(variance/n) / (2.0f*sqrtf(mean) + 0.01f);
+}
+
+// Spreads the low 10 bits of v three bits apart
+inline uint32_t expandBits3(uint32_t v)
+{
+	v &= 0x3ff;
+	v = (v | (v << 16)) & 0x030000ff;
+	v = (v | (v << 8)) & 0x0300f00f;
+	v = (v | (v << 4)) & 0x030c30c3;
+	v = (v | (v << 2)) & 0x09249249;
+	return v;
+}
+
+// Direction octant above a 3D Morton code of the origin in the scene bounds, rays with close keys visit the same nodes
+uint32_t rayKey(const ray3& r, const aabb& bounds)
+{
+	vec3 extent = bounds.max - bounds.min;
+	uint32_t morton = 0;
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		float size = axisOf(extent, axis);
+		float offset = size > 0.0f ? (axisOf(r.origin, axis) - axisOf(bounds.min, axis)) / size : 0.0f;
+		morton |= expandBits3((uint32_t)clampf(offset*1024.0f, 0.0f, 1023.0f)) << axis;
+	}
+	uint32_t octant = (r.direction.x < 0.0f ? 1 : 0) | (r.direction.y < 0.0f ? 2 : 0) | (r.direction.z < 0.0f ? 4 : 0);
+	return octant << 29 | morton >> 1;
+}
+
+// Hilbert curve over the tile, https://en.wikipedia.org/wiki/Hilbert_curve#Applications_and_mapping_algorithms
+void hilbertPoint(int n, int d, int& x, int& y)
+{
+	x = 0;
+	y = 0;
+	for (int s = 1; s < n; s *= 2)
+	{
+		int rx = 1 & (d / 2);
+		int ry = 1 & (d ^ rx);
+		if (ry == 0)
+		{
+			if (rx == 1)
+			{
+				x = s - 1 - x;
+				y = s - 1 - y;
+			}
+			std::swap(x, y);
+		}
+		x += s*rx;
+		y += s*ry;
+		d /= 4;
+	}
+}
+
+void buildTileOrder(int order)
+{
+	for (int d = 0; d < TILE_SIZE*TILE_SIZE; ++d)
+	{
+		int x = d % TILE_SIZE;
+		int y = d / TILE_SIZE;
+		if (order == PIXEL_ORDER_MORTON)
+		{
+			x = 0;
+			y = 0;
+			for (int bit = 0; (1 << bit) < TILE_SIZE; ++bit)
+			{
+				x |= ((d >> (2*bit)) & 1) << bit;
+				y |= ((d >> (2*bit + 1)) & 1) << bit;
+			}
+		}
+		else if (order == PIXEL_ORDER_HILBERT)
+		{
+			hilbertPoint(TILE_SIZE, d, x, y);
+		}
+		gTileOrder[d] = x + y*TILE_SIZE;
+	}
+}
+
+inline ray3 cameraRay(const camera& cam, int i, int j, int storageIndex, int sample)
+{
+	rng random(gSeed, storageIndex, sample, 0);
+	float u = (i + random.nextFloat()) / (gRenderWidth - 1);
+	float v = (j + random.nextFloat()) / (gRenderHeight - 1);
+	return ray3(cam.origin, cam.lowerLeftCorner + cam.horizontal*u + cam.vertical*v - cam.origin);
+}
+
+inline void accumulateSample(int storageIndex, const vec3& color)
+{
+	float l = luminance(color);
+	gStoragePixels[storageIndex] = gStoragePixels[storageIndex] + color;
+	gStorageSquares[storageIndex] += l*l;
+}
+
+thread_local std::vector<pathState> tPaths;
+
+// Breadth first over the tile: every bounce traces all live paths, sorted so neighbouring rays share BVH nodes.
+// Random numbers depend only on pixel, sample and bounce, so the image matches the depth first renderer.
+void renderTileSorted(tile& t, const camera& cam)
+{
+	aabb bounds = gWorld.nodes.empty() ? aabb() : gWorld.nodes[0].box;
+	for (int s = 0; s < t.batch; ++s)
+	{
+		tPaths.clear();
+		for (int d = 0; d < TILE_SIZE*TILE_SIZE; ++d)
+		{
+			int i = t.x0 + gTileOrder[d] % TILE_SIZE;
+			int j = t.y0 + gTileOrder[d] / TILE_SIZE;
+			if (i >= t.x1 || j >= t.y1) continue;
+
+			pathState p;
+			p.pixel = i + j*gRenderWidth;
+			p.sample = ++gPixelSamples[p.pixel];
+			p.r = cameraRay(cam, i, j, p.pixel, p.sample);
+			tPaths.push_back(p);
+		}
+
+		// Finished paths are swapped behind the live ones
+		size_t live = tPaths.size();
+		for (int bounce = 0; bounce < gRayDepth && live > 0; ++bounce)
+		{
+			if (bounce > 0)
+			{
+				for (size_t k = 0; k < live; ++k)
+				{
+					tPaths[k].key = rayKey(tPaths[k].r, bounds);
+				}
+				std::sort(tPaths.begin(), tPaths.begin() + live, [](const pathState& a, const pathState& b) { return a.key < b.key; });
+			}
+			for (size_t k = 0; k < live;)
+			{
+				if (extendPath(tPaths[k], bounce)) ++k;
+				else std::swap(tPaths[k], tPaths[--live]);
+			}
+		}
+
+		for (const auto& p : tPaths)
+		{
+			accumulateSample(p.pixel, p.radiance);
+		}
+	}
+}
+
+void renderTile(tile& t, const camera& cam)
+{
+	if (gSortRays)
+	{
+		renderTileSorted(t, cam);
+	}
+	else
+	{
+		for (int s = 0; s < t.batch; ++s)
+		{
+			for (int d = 0; d < TILE_SIZE*TILE_SIZE; ++d)
+			{
+				int i = t.x0 + gTileOrder[d] % TILE_SIZE;
+				int j = t.y0 + gTileOrder[d] / TILE_SIZE;
+				if (i >= t.x1 || j >= t.y1) continue;
+
+				int storageIndex = (i + j*gRenderWidth);
+				int sample = ++gPixelSamples[storageIndex];
+				accumulateSample(storageIndex, rayColor(cameraRay(cam, i, j, storageIndex, sample), storageIndex, sample));
+			}
+		}
+	}
+	t.samples += t.batch;
+
+	t.error = 0.0f;
+	for (int j = t.y0; j < t.y1; ++j)
+	{
+		for (int i = t.x0; i < t.x1; ++i)
+		{
+			t.error = fmax(t.error, pixelError(i + j*gRenderWidth));
+		}
+	}
+}
+
+camera makeCamera(const vec3& eye)
+{
+	float aspect = (float)gRenderWidth / gRenderHeight;
+	float h = tanf(gCameraFov/2.0f);
+	float viewportHeight = 2.0f*h;
+	float viewportWidth = aspect*viewportHeight;
+	vec3 origin = eye;
+	vec3 lookAt = gCameraTarget;
+	vec3 w = (origin - lookAt).normalize();
+	vec3 u = vec3::cross(vec3(0.0f, 1.0f, 0.0f), w).normalize();
+	vec3 v = vec3::cross(w, u);
+
+	camera cam;
+	cam.origin = origin;
+	cam.horizontal = u*viewportWidth;
+	cam.vertical = v*viewportHeight;
+	cam.lowerLeftCorner = origin - cam.horizontal/2.0f - cam.vertical/2.0f - w;
+	return cam;
+}
+
+// Inverse of the primary ray setup, d is relative to the camera origin (or a direction for points at infinity)
+bool projectCamera(const camera& cam, const vec3& d, float& u, float& v)
+{
+	vec3 forward = cam.lowerLeftCorner + cam.horizontal/2.0f + cam.vertical/2.0f - cam.origin;
+	float z = vec3::dot(d, forward) / vec3::dot(forward, forward);
+	if (z <= 0.0f) return false;
+
+	vec3 onPlane = d/z - forward;
+	u = vec3::dot(onPlane, cam.horizontal) / vec3::dot(cam.horizontal, cam.horizontal) + 0.5f;
+	v = vec3::dot(onPlane, cam.vertical) / vec3::dot(cam.vertical, cam.vertical) + 0.5f;
+	return true;
+}
+
+firstHit traceFirstHit(const ray3& r)
+{
+	firstHit first;
+	hit hit;
+	if (sceneHit(r, 0.001f, 1000.0f, hit) == false) return first;
+
+	completeHit(r, hit);
+	first.position = hit.point;
+	first.normal = hit.normal;
+	first.depth = hit.t*sqrtf(vec3::dot(r.direction, r.direction));
+	first.material = hit.material;
+	first.albedo = gMaterials[hit.material].color;
+	return first;
+}
+
+// Accepted when the old pixel saw the same surface, metal is view dependent and always starts over
+bool matchFirstHit(const firstHit& current, const firstHit& previous)
+{
+	if (current.material != previous.material) return false;
+	if (current.material < 0) return true;
+	if (gMaterials[current.material].type == MATERIAL_METAL) return false;
+	vec3 offset = current.position - previous.position;
+	if (vec3::dot(offset, offset) > REPROJECTION_TOLERANCE*REPROJECTION_TOLERANCE*current.depth*current.depth) return false;
+	return vec3::dot(current.normal, previous.normal) > 0.9f;
+}
+
+// Trace the pixel centers of the new view and gather each pixel's history from where its surface was in the previous one
+void reprojectTile(tile& t, const camera& cam)
+{
+	t.samples = INT_MAX;
+	t.error = 0.0f;
+	for (int j = t.y0; j < t.y1; ++j)
+	{
+		for (int i = t.x0; i < t.x1; ++i)
+		{
+			int storageIndex = (i + j*gRenderWidth);
+			float u = (i + 0.5f) / (gRenderWidth - 1);
+			float v = (j + 0.5f) / (gRenderHeight - 1);
+			ray3 r(cam.origin, cam.lowerLeftCorner + cam.horizontal*u + cam.vertical*v - cam.origin);
+			++tRayCount;
+
+			const firstHit& current = gFirstHits[storageIndex] = traceFirstHit(r);
+			if (gHistoryValid)
+			{
+				gStoragePixels[storageIndex] = vec3(0.0f, 0.0f, 0.0f);
+				gStorageSquares[storageIndex] = 0.0f;
+				gPixelSamples[storageIndex] = 0;
+
+				float prevU, prevV;
+				vec3 d = current.material < 0 ? r.direction : current.position - gPrevCamera.origin;
+				if (projectCamera(gPrevCamera, d, prevU, prevV))
+				{
+					int x = (int)floorf(prevU*(gRenderWidth - 1));
+					int y = (int)floorf(prevV*(gRenderHeight - 1));
+					int prevIndex = x + y*gRenderWidth;
+					if (x >= 0 && x < gRenderWidth && y >= 0 && y < gRenderHeight && gPrevPixelSamples[prevIndex] > 0 && matchFirstHit(current, gPrevFirstHits[prevIndex]))
+					{
+						// Cap the history so nearest pixel resampling does not pile up over a long orbit
+						int samples = gPrevPixelSamples[prevIndex];
+						float scale = samples > REPROJECTION_MAX_HISTORY ? (float)REPROJECTION_MAX_HISTORY / samples : 1.0f;
+						gStoragePixels[storageIndex] = gPrevStoragePixels[prevIndex]*scale;
+						gStorageSquares[storageIndex] = gPrevStorageSquares[prevIndex]*scale;
+						gPixelSamples[storageIndex] = std::min(samples, REPROJECTION_MAX_HISTORY);
+					}
+				}
+			}
+
+			t.samples = std::min(t.samples, gPixelSamples[storageIndex]);
+			t.error = fmax(t.error, pixelError(storageIndex));
+		}
+	}
+	t.batch = 1;
+	t.converged = false;
+}
+
+inline vec3 demodulate(const vec3& c, const vec3& albedo)
+{
+	return vec3(c.x / fmax(albedo.x, 0.01f), c.y / fmax(albedo.y, 0.01f), c.z / fmax(albedo.z, 0.01f));
+}
+
+// Variance of a pixel's mean luminance, divided by its albedo like the radiance
+float demodulatedVariance(int index)
+{
+	int n = gPixelSamples[index];
+	float mean = luminance(gStoragePixels[index]) / n;
+	float variance = n > 1 ? fmax(0.0f, gStorageSquares[index]/n - mean*mean) / (n - 1) : mean*mean;
+	float albedoLuminance = fmax(luminance(gFirstHits[index].albedo), 0.01f);
+	return variance / (albedoLuminance*albedoLuminance);
+}
+
+// Mean radiance divided by the first hit albedo, the variance is blurred over 3x3 since a few samples say little about it
+void denoiseInputTile(const tile& t)
+{
+	static const float kernel[2] = { 1.0f/2.0f, 1.0f/4.0f };
+
+	for (int j = t.y0; j < t.y1; ++j)
+	{
+		for (int i = t.x0; i < t.x1; ++i)
+		{
+			int index = (i + j*gRenderWidth);
+			int n = gPixelSamples[index];
+			if (n == 0)
+			{
+				gDenoiseColors[0][index] = vec3(0.0f, 0.0f, 0.0f);
+				gDenoiseLuminances[0][index] = 0.0f;
+				gDenoiseVariances[0][index] = 0.0f;
+				gDenoiseGuides[index] = { gFirstHits[index].normal, gFirstHits[index].depth, DENOISE_EMPTY };
+				continue;
+			}
+
+			float varianceSum = 0.0f;
+			float weightSum = 0.0f;
+			for (int y = std::max(j - 1, 0); y <= std::min(j + 1, gRenderHeight - 1); ++y)
+			{
+				for (int x = std::max(i - 1, 0); x <= std::min(i + 1, gRenderWidth - 1); ++x)
+				{
+					int q = x + y*gRenderWidth;
+					if (gPixelSamples[q] == 0) continue;
+
+					float weight = kernel[abs(x - i)]*kernel[abs(y - j)];
+					varianceSum += weight*demodulatedVariance(q);
+					weightSum += weight;
+				}
+			}
+
+			gDenoiseColors[0][index] = demodulate(gStoragePixels[index]/(float)n, gFirstHits[index].albedo);
+			gDenoiseLuminances[0][index] = luminance(gDenoiseColors[0][index]);
+			gDenoiseVariances[0][index] = varianceSum / weightSum;
+			gDenoiseGuides[index] = { gFirstHits[index].normal, gFirstHits[index].depth, gFirstHits[index].material };
+		}
+	}
+}
+
+// expf for x <= 0 within 1.1e-4 relative error, plenty for the edge stopping weights
+// 2^(x/ln2) split into a power of two and a cubic fit over the fraction
+inline float denoiseExp(float x)
+{
+	float y = fmaxf(x*1.44269504f, -126.0f);
+	int n = (int)y - 1; // y <= 0, so 2^y = 2^n * 2^f with f in (0, 1]
+	float f = y - n;
+	float p = 1.0f + f*(0.695502f + f*(0.226270f + f*0.078228f));
+	int bits = (n + 127) << 23;
+	float scale;
+	memcpy(&scale, &bits, sizeof(scale));
+	return p*scale;
+}
+
+// One 5x5 B3 spline iteration with holes of 2^iteration pixels
+void denoiseTile(const tile& t)
+{
+	static const float kernel[3] = { 3.0f/8.0f, 1.0f/4.0f, 1.0f/16.0f };
+
+	int step = 1 << gDenoiseIteration;
+	int source = gDenoiseIteration & 1;
+	bool last = gDenoiseIteration == DENOISE_ITERATIONS - 1;
+	const vec3* colors = gDenoiseColors[source];
+	const float* luminances = gDenoiseLuminances[source];
+	const float* variances = gDenoiseVariances[source];
+
+	for (int j = t.y0; j < t.y1; ++j)
+	{
+		for (int i = t.x0; i < t.x1; ++i)
+		{
+			int index = (i + j*gRenderWidth);
+			const firstHit& center = gFirstHits[index];
+			float centerLuminance = luminances[index];
+			bool centerValid = gPixelSamples[index] > 0;
+			// Both edge stopping terms go into one exponential, empty pixels take whatever their neighbours agree on
+			float luminanceScale = centerValid ? -1.0f/(DENOISE_SIGMA_LUMINANCE*sqrtf(variances[index]) + 1e-4f) : 0.0f;
+			float depthScale = center.material >= 0 ? -1.0f/(DENOISE_SIGMA_DEPTH*center.depth*step) : 0.0f;
+
+			vec3 sum(0.0f, 0.0f, 0.0f);
+			float varianceSum = 0.0f;
+			float weightSum = 0.0f;
+			for (int y = -2; y <= 2; ++y)
+			{
+				int qy = j + y*step;
+				if (qy < 0 || qy >= gRenderHeight) continue;
+
+				for (int x = -2; x <= 2; ++x)
+				{
+					int qx = i + x*step;
+					if (qx < 0 || qx >= gRenderWidth) continue;
+
+					int q = qx + qy*gRenderWidth;
+					const denoiseGuide& other = gDenoiseGuides[q];
+					if (other.material != center.material) continue;
+
+					float weight = kernel[abs(x)]*kernel[abs(y)];
+					if (center.material >= 0)
+					{
+						float normalWeight = fmax(0.0f, vec3::dot(center.normal, other.normal));
+						for (int k = 1; k < DENOISE_NORMAL_POWER; k *= 2)
+						{
+							normalWeight *= normalWeight;
+						}
+						weight *= normalWeight;
+					}
+					weight *= denoiseExp(fabsf(center.depth - other.depth)*depthScale + fabsf(centerLuminance - luminances[q])*luminanceScale);
+
+					sum = sum + colors[q]*weight;
+					varianceSum += weight*weight*variances[q];
+					weightSum += weight;
+				}
+			}
+
+			vec3 color = weightSum > 0.0f ? sum/weightSum : colors[index];
+			float variance = weightSum > 0.0f ? varianceSum/(weightSum*weightSum) : variances[index];
+			gDenoiseColors[source ^ 1][index] = color;
+			gDenoiseLuminances[source ^ 1][index] = luminance(color);
+			gDenoiseVariances[source ^ 1][index] = variance;
+
+			if (last)
+			{
+				gDenoiseColors[source ^ 1][index] = color*center.albedo;
+			}
+		}
+	}
+}
+
+// 4x4 ordered dither, the offsets stay put between frames so a converged image does not crawl
+alignas(16) const int gBayer[4][4] = { { 0, 8, 2, 10 }, { 12, 4, 14, 6 }, { 3, 11, 1, 9 }, { 15, 7, 13, 5 } };
+
+inline float toneCurve(float v, int tonemap)
+{
+	if (tonemap == TONEMAP_REINHARD) return v / (1.0f + v);
+	// Narkowicz's fit of the ACES filmic curve
+	if (tonemap == TONEMAP_ACES) return (v*(2.51f*v + 0.03f)) / (v*(2.43f*v + 0.59f) + 0.14f);
+	return v;
+}
+
+// Within half an 8 bit step of the exact curve, built from square roots so it vectorizes where powf does not
+inline float srgbEncode(float v)
+{
+	if (v < 0.0031308f) return 12.92f*v;
+	float s1 = sqrtf(v);
+	float s2 = sqrtf(s1);
+	float s3 = sqrtf(s2);
+	return 0.585122381f*s1 + 0.783140355f*s2 - 0.368262736f*s3;
+}
+
+inline int resolveChannel(float sum, float samples, float dither, int tonemap)
+{
+	float v = toneCurve(sum/samples*gExposure, tonemap);
+	v = gSrgb ? srgbEncode(v) : sqrtf(v);
+	return (int)(256*clampf(v + dither, 0.0f, 0.999f));
+}
+
+inline float ditherOffset(int x, int y)
+{
+	return gDither ? ((gBayer[y & 3][x & 3] + 0.5f)*(1.0f/16.0f) - 0.5f)*(1.0f/256.0f) : 0.0f;
+}
+
+#if TRACER_X86
+inline __m128 toneCurve4(__m128 v, int tonemap)
+{
+	if (tonemap == TONEMAP_REINHARD) return _mm_div_ps(v, _mm_add_ps(_mm_set1_ps(1.0f), v));
+	if (tonemap == TONEMAP_ACES)
+	{
+		__m128 numerator = _mm_mul_ps(v, _mm_add_ps(_mm_mul_ps(_mm_set1_ps(2.51f), v), _mm_set1_ps(0.03f)));
+		__m128 denominator = _mm_add_ps(_mm_mul_ps(v, _mm_add_ps(_mm_mul_ps(_mm_set1_ps(2.43f), v), _mm_set1_ps(0.59f))), _mm_set1_ps(0.14f));
+		return _mm_div_ps(numerator, denominator);
+	}
+	return v;
+}
+
+inline __m128 srgbEncode4(__m128 v)
+{
+	__m128 s1 = _mm_sqrt_ps(v);
+	__m128 s2 = _mm_sqrt_ps(s1);
+	__m128 s3 = _mm_sqrt_ps(s2);
+	__m128 curve = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(0.585122381f), s1), _mm_mul_ps(_mm_set1_ps(0.783140355f), s2)), _mm_mul_ps(_mm_set1_ps(0.368262736f), s3));
+	__m128 linear = _mm_cmplt_ps(v, _mm_set1_ps(0.0031308f));
+	return _mm_or_ps(_mm_and_ps(linear, _mm_mul_ps(_mm_set1_ps(12.92f), v)), _mm_andnot_ps(linear, curve));
+}
+
+inline __m128i resolveChannel4(__m128 sum, __m128 samples, __m128 dither, int tonemap)
+{
+	__m128 v = toneCurve4(_mm_mul_ps(_mm_div_ps(sum, samples), _mm_set1_ps(gExposure)), tonemap);
+	v = gSrgb ? srgbEncode4(v) : _mm_sqrt_ps(v);
+	v = _mm_min_ps(_mm_max_ps(_mm_add_ps(v, dither), _mm_setzero_ps()), _mm_set1_ps(0.999f));
+	return _mm_cvttps_epi32(_mm_mul_ps(_mm_set1_ps(256.0f), v));
+}
+
+// Four pixels at a time in the same operation order as resolveChannel, returns where the scalar tail starts
+int resolveRowSSE(const vec3* colors, const int* samples, unsigned char* pixels, int x0, int x1, int y, int tonemap)
+{
+	__m128 dither = _mm_setzero_ps();
+	if (gDither)
+	{
+		__m128 bayer = _mm_cvtepi32_ps(_mm_load_si128((const __m128i*)gBayer[y & 3]));
+		dither = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(_mm_add_ps(bayer, _mm_set1_ps(0.5f)), _mm_set1_ps(1.0f/16.0f)), _mm_set1_ps(0.5f)), _mm_set1_ps(1.0f/256.0f));
+	}
+
+	int i = x0;
+	for (; i + 4 <= x1; i += 4)
+	{
+		int index = i + y*gRenderWidth;
+		const float* c = &colors[index].x;
+		__m128 count = _mm_set1_ps(1.0f);
+		if (samples != nullptr)
+		{
+			count = _mm_max_ps(_mm_cvtepi32_ps(_mm_loadu_si128((const __m128i*)(samples + index))), _mm_set1_ps(1.0f));
+		}
+
+		__m128i r = resolveChannel4(_mm_setr_ps(c[0], c[3], c[6], c[9]), count, dither, tonemap);
+		__m128i g = resolveChannel4(_mm_setr_ps(c[1], c[4], c[7], c[10]), count, dither, tonemap);
+		__m128i b = resolveChannel4(_mm_setr_ps(c[2], c[5], c[8], c[11]), count, dither, tonemap);
+		__m128i rgba = _mm_or_si128(_mm_or_si128(r, _mm_slli_epi32(g, 8)), _mm_or_si128(_mm_slli_epi32(b, 16), _mm_set1_epi32((int)0xff000000)));
+		_mm_storeu_si128((__m128i*)(pixels + index*4), rgba);
+	}
+	return i;
+}
+#endif
+
+// Display pipeline over a tile: exposure, tone curve, display transfer, dither and 8 bit quantization
+// samples is null for colors that are already averaged
+void resolveTile(const tile& t, const vec3* colors, const int* samples, unsigned char* pixels)
+{
+	int tonemap = gTonemap;
+	for (int j = t.y0; j < t.y1; ++j)
+	{
+		int i = t.x0;
+#if TRACER_X86
+		if (gSimdLevel >= SIMD_SSE) i = resolveRowSSE(colors, samples, pixels, t.x0, t.x1, j, tonemap);
+#endif
+		for (; i < t.x1; ++i)
+		{
+			int index = i + j*gRenderWidth;
+			float count = samples != nullptr ? std::max((float)samples[index], 1.0f) : 1.0f;
+			float dither = ditherOffset(i, j);
+			pixels[index*4 + 0] = resolveChannel(colors[index].x, count, dither, tonemap);
+			pixels[index*4 + 1] = resolveChannel(colors[index].y, count, dither, tonemap);
+			pixels[index*4 + 2] = resolveChannel(colors[index].z, count, dither, tonemap);
+			pixels[index*4 + 3] = 255;
+		}
+	}
+}
+
+void resetTiles()
+{
+	gTiles.clear();
+	for (int y = 0; y < gRenderHeight; y += TILE_SIZE)
+	{
+		for (int x = 0; x < gRenderWidth; x += TILE_SIZE)
+		{
+			tile t;
+			t.x0 = x;
+			t.y0 = y;
+			t.x1 = std::min(x + TILE_SIZE, gRenderWidth);
+			t.y1 = std::min(y + TILE_SIZE, gRenderHeight);
+			gTiles.push_back(t);
+		}
+	}
+	gActiveTiles = (int)gTiles.size();
+}
+
+// Retire tiles under the noise threshold and size the next batch of the others from their error
+int scheduleTiles()
+{
+	gActiveTiles = 0;
+	for (auto& t : gTiles)
+	{
+		if (t.converged) continue;
+		if (t.samples >= gMaxSamples)
+		{
+			t.converged = true;
+			continue;
+		}
+
+		t.batch = 1;
+		if (gNoiseThreshold > 0.0f && t.samples >= ADAPTIVE_MIN_SAMPLES)
+		{
+			if (t.error < gNoiseThreshold)
+			{
+				t.converged = true;
+				continue;
+			}
+
+			// The error falls with 1/sqrt(n), estimate the samples still missing
+			float ratio = t.error / gNoiseThreshold;
+			int missing = (int)ceilf(t.samples*(ratio*ratio - 1.0f));
+			t.batch = std::max(1, std::min(missing, ADAPTIVE_MAX_BATCH));
+		}
+		t.batch = std::min(t.batch, gMaxSamples - t.samples);
+		++gActiveTiles;
+	}
+	return gActiveTiles;
+}
+
+bool popTile(unsigned int worker, int& index)
+{
+	tileQueue& queue = gQueues[worker];
+	std::lock_guard<std::mutex> lock(queue.mutex);
+	if (queue.tiles.empty()) return false;
+
+	index = queue.tiles.back();
+	queue.tiles.pop_back();
+	return true;
+}
+
+bool stealTile(unsigned int worker, int& index)
+{
+	// Steal from the opposite end of the victim's deque, it is the work the owner would reach last
+	for (unsigned int i = 1; i < gCores; ++i)
+	{
+		tileQueue& queue = gQueues[(worker + i) % gCores];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (queue.tiles.empty()) continue;
+
+		index = queue.tiles.front();
+		queue.tiles.pop_front();
+		++gSteals;
+		return true;
+	}
+	return false;
+}
+
+void workerLoop(unsigned int worker)
+{
+	int generation = 0;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(gPoolMutex);
+			gPoolStart.wait(lock, [&] { return gPoolQuit || gPoolGeneration != generation; });
+			if (gPoolQuit) return;
+			generation = gPoolGeneration;
+		}
+
+		int index;
+		while (popTile(worker, index) || stealTile(worker, index))
+		{
+			auto start = high_resolution_clock::now();
+			if (gPassMode == PASS_FIRST_HIT)
+			{
+				reprojectTile(gTiles[index], gCamera);
+			}
+			else if (gPassMode == PASS_DENOISE_INPUT)
+			{
+				denoiseInputTile(gTiles[index]);
+			}
+			else if (gPassMode == PASS_DENOISE)
+			{
+				denoiseTile(gTiles[index]);
+			}
+			else if (gPassMode == PASS_RESOLVE)
+			{
+				resolveTile(gTiles[index], gStoragePixels, gPixelSamples, gPixels);
+			}
+			else if (gPassMode == PASS_RESOLVE_DENOISED)
+			{
+				resolveTile(gTiles[index], gDenoiseColors[DENOISE_ITERATIONS & 1], nullptr, gDenoisedPixels);
+			}
+			else
+			{
+				renderTile(gTiles[index], gCamera);
+				auto stop = high_resolution_clock::now();
+				gTiles[index].time = duration_cast<microseconds>(stop - start).count() / 1000.0f;
+			}
+		}
+		gRayCount += tRayCount;
+		tRayCount = 0;
+#ifdef TRACER_BENCHMARK
+		gNodeTests += tNodeTests;
+		gPrimitiveTests += tPrimitiveTests;
+		tNodeTests = 0;
+		tPrimitiveTests = 0;
+#endif
+
+		{
+			std::lock_guard<std::mutex> lock(gPoolMutex);
+			if (--gPoolBusy == 0) gPoolDone.notify_one();
+		}
+	}
+}
+
+int dispatchTiles(const std::vector<int>& active, const camera& cam, int mode)
+{
+	// Hand each worker a contiguous run of tiles, neighbouring tiles share most of their rays' paths
+	int tileCount = (int)active.size();
+	for (unsigned int i = 0; i < gCores; ++i)
+	{
+		std::lock_guard<std::mutex> lock(gQueues[i].mutex);
+		int first = tileCount*i / gCores;
+		int last = tileCount*(i + 1) / gCores;
+		for (int t = first; t < last; ++t)
+		{
+			gQueues[i].tiles.push_back(active[t]);
+		}
+	}
+
+	std::unique_lock<std::mutex> lock(gPoolMutex);
+	gCamera = cam;
+	gPassMode = mode;
+	gPoolBusy = gCores;
+	++gPoolGeneration;
+	gPoolStart.notify_all();
+	gPoolDone.wait(lock, [] { return gPoolBusy == 0; });
+	return tileCount;
+}
+
+int renderPass(const camera& cam)
+{
+	std::vector<int> active;
+	active.reserve(gTiles.size());
+	scheduleTiles();
+	for (int t = 0; t < (int)gTiles.size(); ++t)
+	{
+		if (gTiles[t].converged == false) active.push_back(t);
+	}
+	if (active.empty()) return 0;
+
+	return dispatchTiles(active, cam, PASS_SAMPLE);
+}
+
+// Refresh the first hit buffer for a new view, carrying over what the previous view accumulated when there is one
+void reprojectPass(const camera& cam)
+{
+	if (gHistoryValid)
+	{
+		std::swap(gStoragePixels, gPrevStoragePixels);
+		std::swap(gStorageSquares, gPrevStorageSquares);
+		std::swap(gPixelSamples, gPrevPixelSamples);
+		std::swap(gFirstHits, gPrevFirstHits);
+	}
+
+	std::vector<int> all(gTiles.size());
+	for (int t = 0; t < (int)gTiles.size(); ++t)
+	{
+		all[t] = t;
+	}
+	dispatchTiles(all, cam, PASS_FIRST_HIT);
+
+	gSamples = 0;
+	gPrevCamera = cam;
+	gHistoryValid = true;
+}
+
+// Needs the first hit buffer of the current view, the result lands in gDenoiseColors[DENOISE_ITERATIONS & 1]
+void denoisePass()
+{
+	std::vector<int> all(gTiles.size());
+	for (int t = 0; t < (int)gTiles.size(); ++t)
+	{
+		all[t] = t;
+	}
+
+	// Every iteration reads the whole previous one, so each is its own pass
+	dispatchTiles(all, gCamera, PASS_DENOISE_INPUT);
+	for (gDenoiseIteration = 0; gDenoiseIteration < DENOISE_ITERATIONS; ++gDenoiseIteration)
+	{
+		dispatchTiles(all, gCamera, PASS_DENOISE);
+	}
+}
+
+// Turn the accumulation, or the denoiser's output, into gPixels or gDenoisedPixels
+void resolvePass(bool denoised)
+{
+	std::vector<int> all(gTiles.size());
+	for (int t = 0; t < (int)gTiles.size(); ++t)
+	{
+		all[t] = t;
+	}
+	dispatchTiles(all, gCamera, denoised ? PASS_RESOLVE_DENOISED : PASS_RESOLVE);
+}
+
+void startWorkers()
+{
+	gQueues = new tileQueue[gCores];
+	gThreads = new std::thread[gCores];
+	for (unsigned int i = 0; i < gCores; ++i)
+	{
+		gThreads[i] = std::thread(workerLoop, i);
+	}
+}
+
+void stopWorkers()
+{
+	{
+		std::lock_guard<std::mutex> lock(gPoolMutex);
+		gPoolQuit = true;
+	}
+	gPoolStart.notify_all();
+
+	for (unsigned int i = 0; i < gCores; ++i)
+	{
+		gThreads[i].join();
+	}
+
+	delete [] gThreads;
+	delete [] gQueues;
+}
+
+void clearAccumulation()
+{
+	gSamples = 0;
+	memset(gStoragePixels, 0, gRenderWidth*gRenderHeight*sizeof(vec3));
+	memset(gStorageSquares, 0, gRenderWidth*gRenderHeight*sizeof(float));
+	memset(gPixelSamples, 0, gRenderWidth*gRenderHeight*sizeof(int));
+	memset(gPixels, 0, gRenderWidth*gRenderHeight*4);
+	gHistoryValid = false;
+	resetTiles();
+}
+
+void resizeBuffers(int width, int height)
+{
+	gRenderWidth = width;
+	gRenderHeight = height;
+
+	if (gStoragePixels != nullptr)
+	{
+		delete [] gStoragePixels;
+		delete [] gStorageSquares;
+		delete [] gPixelSamples;
+		delete [] gFirstHits;
+		delete [] gPrevStoragePixels;
+		delete [] gPrevStorageSquares;
+		delete [] gPrevPixelSamples;
+		delete [] gPrevFirstHits;
+		delete [] gDenoiseColors[0];
+		delete [] gDenoiseColors[1];
+		delete [] gDenoiseLuminances[0];
+		delete [] gDenoiseLuminances[1];
+		delete [] gDenoiseGuides;
+		delete [] gDenoiseVariances[0];
+		delete [] gDenoiseVariances[1];
+		delete [] gDenoisedPixels;
+	}
+	if (gPixels != nullptr)
+	{
+		delete [] gPixels;
+	}
+
+	gStoragePixels = new vec3[gRenderWidth*gRenderHeight];
+	gStorageSquares = new float[gRenderWidth*gRenderHeight];
+	gPixelSamples = new int[gRenderWidth*gRenderHeight];
+	gFirstHits = new firstHit[gRenderWidth*gRenderHeight];
+	gPrevStoragePixels = new vec3[gRenderWidth*gRenderHeight];
+	gPrevStorageSquares = new float[gRenderWidth*gRenderHeight];
+	gPrevPixelSamples = new int[gRenderWidth*gRenderHeight];
+	gPrevFirstHits = new firstHit[gRenderWidth*gRenderHeight];
+	gDenoiseColors[0] = new vec3[gRenderWidth*gRenderHeight];
+	gDenoiseColors[1] = new vec3[gRenderWidth*gRenderHeight];
+	gDenoiseLuminances[0] = new float[gRenderWidth*gRenderHeight];
+	gDenoiseLuminances[1] = new float[gRenderWidth*gRenderHeight];
+	gDenoiseGuides = new denoiseGuide[gRenderWidth*gRenderHeight];
+	gDenoiseVariances[0] = new float[gRenderWidth*gRenderHeight];
+	gDenoiseVariances[1] = new float[gRenderWidth*gRenderHeight];
+	gDenoisedPixels = new unsigned char[gRenderWidth*gRenderHeight*4];
+	gPixels = new unsigned char[gRenderWidth*gRenderHeight*4];
+	clearAccumulation();
+}
+
+void resetRenderer(int level, int width, int height)
+{
+	int sub = powf(2, level - 1);
+	resizeBuffers(std::max(1, width / sub), std::max(1, height / sub));
+}
+
+// Camera and window size as last requested by the display thread
+struct view
+{
+	vec3 eye{};
+	int width{};
+	int height{};
+	int generation{};
+};
+
+// Resolved image handed from the tracer to the display thread
+struct frame
+{
+	std::vector<unsigned char> pixels;
+	int width{};
+	int height{};
+	bool denoised{};
+};
+
+std::mutex gViewMutex;
+std::condition_variable gViewChanged;
+view gView;
+bool gTracerQuit = false;
+bool gRepublish = false; // publish again without new samples, e.g. after toggling the denoiser
+std::thread gTracer;
+
+// Triple buffer, the tracer and the display thread each own one frame and trade it for the ready one with a single atomic exchange
+frame gFrames[3];
+std::atomic<int> gFrameReady{ 2 };
+int gFrameBack = 0; // tracer thread
+int gFrameFront = 1; // display thread
+
+void publishFrame()
+{
+	frame& f = gFrames[gFrameBack];
+	f.width = gRenderWidth;
+	f.height = gRenderHeight;
+	f.denoised = gDenoise;
+	if (f.denoised)
+	{
+		denoisePass();
+	}
+	resolvePass(f.denoised);
+	const unsigned char* pixels = f.denoised ? gDenoisedPixels : gPixels;
+	f.pixels.assign(pixels, pixels + gRenderWidth*gRenderHeight*4);
+	gFrameBack = gFrameReady.exchange(gFrameBack | FRAME_FRESH) & 3;
+}
+
+bool acquireFrame()
+{
+	if ((gFrameReady.load() & FRAME_FRESH) == 0) return false;
+
+	gFrameFront = gFrameReady.exchange(gFrameFront) & 3;
+	return true;
+}
+
+void publishView(const vec3& eye)
+{
+	{
+		std::lock_guard<std::mutex> lock(gViewMutex);
+		gView.eye = eye;
+		gView.width = gWidth;
+		gView.height = gHeight;
+		++gView.generation;
+	}
+	gViewChanged.notify_one();
+}
+
+void requestFrame()
+{
+	{
+		std::lock_guard<std::mutex> lock(gViewMutex);
+		gRepublish = true;
+	}
+	gViewChanged.notify_one();
+}
+
+// Runs sample passes back to back, the display thread only ever sees published frames
+void tracerLoop()
+{
+	view current;
+	auto lastStep = high_resolution_clock::now();
+	for (;;)
+	{
+		view requested;
+		bool republish;
+		{
+			std::unique_lock<std::mutex> lock(gViewMutex);
+			// Converged at full resolution and nothing moves, sleep until the camera or the window changes
+			gViewChanged.wait(lock, [&] { return gTracerQuit || gView.generation != current.generation || gActiveTiles > 0 || gLevel > 2 || gRepublish
+												 || (gAnimations.empty() == false && gAnimationPaused == false); });
+			if (gTracerQuit) return;
+			requested = gView;
+			republish = gRepublish;
+			gRepublish = false;
+		}
+
+		bool reproject = false;
+		if (requested.generation != current.generation)
+		{
+			bool resized = requested.width != current.width || requested.height != current.height;
+			current = requested;
+			if (resized)
+			{
+				gLevel = MAX_LEVEL;
+				resetRenderer(gLevel, current.width, current.height);
+			}
+			// Orbiting keeps the resolution level, the accumulation follows the camera
+			reproject = true;
+		}
+
+		if (gLevel > 2 && (gSamples > SAMPLES_PER_PIXEL_NEXT_LEVEL || gActiveTiles == 0))
+		{
+			--gLevel;
+			resetRenderer(gLevel, current.width, current.height);
+			reproject = true;
+		}
+
+		auto start = high_resolution_clock::now();
+
+		// Objects move with the wall clock, the accumulation follows them like it follows the camera
+		bool moved = false;
+		if (gAnimations.empty() == false && gAnimationPaused == false)
+		{
+			gSceneTime += std::min(ANIMATION_MAX_STEP, duration_cast<microseconds>(start - lastStep).count() / 1000000.0f);
+			animateScene(gSceneTime);
+			moved = true;
+		}
+		lastStep = start;
+
+		camera cam = makeCamera(current.eye);
+		if (reproject || moved)
+		{
+			// Under a still camera the passes keep counting toward the next resolution level
+			int passes = gSamples;
+			reprojectPass(cam);
+			if (reproject == false) gSamples = passes;
+		}
+
+		// Tile rendering
+		int rendered = renderPass(cam);
+		if (rendered > 0 || republish)
+		{
+			publishFrame();
+		}
+		if (rendered == 0) continue;
+		++gSamples;
+
+		auto stop = high_resolution_clock::now();
+		auto duration = duration_cast<microseconds>(stop - start);
+
+		gFpsTime += duration.count() / 1000000.0f;
+		++gFpsCount;
+		if (gFpsCount > 10 || gActiveTiles == 0)
+		{
+			float tileMin = FLT_MAX;
+			float tileMax = 0.0f;
+			float tileSum = 0.0f;
+			for (const auto& t : gTiles)
+			{
+				tileMin = fmin(tileMin, t.time);
+				tileMax = fmax(tileMax, t.time);
+				tileSum += t.time;
+			}
+
+			std::cout << "Passes/s: " << gFpsCount / gFpsTime << " - " << gSamples
+					  << " - tiles: " << gTiles.size() << " ms min/avg/max " << tileMin << "/" << tileSum / gTiles.size() << "/" << tileMax
+					  << " - active: " << gActiveTiles << " - steals: " << gSteals.exchange(0);
+			if (gAnimations.empty() == false)
+			{
+				std::cout << " - refits/rebuilds: " << gRefits << "/" << gRebuilds;
+			}
+			std::cout << std::endl;
+			gFpsTime = 0;
+			gFpsCount = 0;
+		}
+	}
+}
+
+void startTracer()
+{
+	gTracer = std::thread(tracerLoop);
+}
+
+void stopTracer()
+{
+	if (gTracer.joinable() == false) return;
+
+	{
+		std::lock_guard<std::mutex> lock(gViewMutex);
+		gTracerQuit = true;
+	}
+	gViewChanged.notify_one();
+	gTracer.join();
+}
+
+void resizeUpload(int width, int height)
+{
+	for (auto& fence : gPboFences)
+	{
+		if (fence != nullptr)
+		{
+			glDeleteSync(fence);
+			fence = nullptr;
+		}
+	}
+	if (gPbo != 0)
+	{
+		if (gPboPointer != nullptr)
+		{
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, gPbo);
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+			gPboPointer = nullptr;
+		}
+		glDeleteBuffers(1, &gPbo);
+	}
+
+	gTextureWidth = width;
+	gTextureHeight = height;
+
+	glDeleteTextures(1, &gTexture);
+	glGenTextures(1, &gTexture);
+	glBindTexture(GL_TEXTURE_2D, gTexture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+		if (gPersistentMapping)
+		{
+			glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, width, height);
+		}
+		else
+		{
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		}
+
+	GLsizeiptr size = (GLsizeiptr)width*height*4*PBO_COUNT;
+	glGenBuffers(1, &gPbo);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, gPbo);
+	if (gPersistentMapping)
+	{
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_PIXEL_UNPACK_BUFFER, size, nullptr, flags);
+		gPboPointer = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, flags);
+	}
+	else
+	{
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+// Copy into the next ring slot and let the driver pull it into the texture asynchronously
+void uploadFrame(const frame& f)
+{
+	if (f.width != gTextureWidth || f.height != gTextureHeight)
+	{
+		resizeUpload(f.width, f.height);
+	}
+
+	int slot = gPboIndex;
+	gPboIndex = (gPboIndex + 1) % PBO_COUNT;
+	if (gPboFences[slot] != nullptr)
+	{
+		// Written PBO_COUNT - 1 frames ago, the copy out of it is long done
+		glClientWaitSync(gPboFences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+		glDeleteSync(gPboFences[slot]);
+		gPboFences[slot] = nullptr;
+	}
+
+	GLsizeiptr size = (GLsizeiptr)f.width*f.height*4;
+	GLintptr offset = size*slot;
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, gPbo);
+	if (gPboPointer != nullptr)
+	{
+		memcpy(gPboPointer + offset, f.pixels.data(), size);
+	}
+	else
+	{
+		void* pointer = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, offset, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+		if (pointer != nullptr)
+		{
+			memcpy(pointer, f.pixels.data(), size);
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		}
+	}
+
+	glBindTexture(GL_TEXTURE_2D, gTexture);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, f.width, f.height, GL_RGBA, GL_UNSIGNED_BYTE, (const void*)offset);
+	gPboFences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+auto init() -> bool
+{
+	{
+		auto vertexShader = glCreateShader(GL_VERTEX_SHADER);
+		glShaderSource(vertexShader, 1, &renderVertexShaderSource, nullptr);
+		GL_CHECK(glCompileShader(vertexShader));
+		{
+			GLint success;
+			GL_CHECK(glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success));
+			if (!success)
+			{
+				GLint infoLength = 0;
+				glGetShaderiv(vertexShader, GL_INFO_LOG_LENGTH, &infoLength);
+				char* infoLog = new char[infoLength];
+				GL_CHECK(glGetShaderInfoLog(vertexShader, infoLength, &infoLength, infoLog));
+				std::cout << "ERROR::SHADER_COMPILATION_ERROR of type: " << "VERTEX_SHADER" << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
+				delete[] infoLog;
+				GL_CHECK(glDeleteShader(vertexShader));
+			}
+		}
+
+		auto fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+		glShaderSource(fragmentShader, 1, &renderFragmentShaderSource, nullptr);
+		GL_CHECK(glCompileShader(fragmentShader));
+		{
+			GLint success;
+			GL_CHECK(glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success));
+			if(!success)
+			{
+				GLint infoLength = 0;
+				glGetShaderiv(fragmentShader, GL_INFO_LOG_LENGTH, &infoLength);
+				char* infoLog = new char[infoLength];
+				GL_CHECK(glGetShaderInfoLog(fragmentShader, infoLength, &infoLength, infoLog));
+				std::cout << "ERROR::SHADER_COMPILATION_ERROR of type: " << "FRAGMENT_SHADER" << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
+				delete [] infoLog;
+				GL_CHECK(glDeleteShader(fragmentShader));
+			}
+		}
+
+		gProgram = glCreateProgram();
+		glAttachShader(gProgram, vertexShader);
+		glAttachShader(gProgram, fragmentShader);
+		glLinkProgram(gProgram);
+
+		glDeleteShader(vertexShader);
+		glDeleteShader(fragmentShader);
+	}
+	gDenoiseLoc = glGetUniformLocation(gProgram, "denoise");
+
+	glGenVertexArrays(1, &gVAO);
+
+	glGenTextures(1, &gTexture);
+	glBindTexture(GL_TEXTURE_2D, gTexture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+
+	// glBufferStorage is core since 4.4, macOS stops at 4.1 and maps each ring slot per upload instead
+	GLint major = 0;
+	GLint minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	glGetIntegerv(GL_MINOR_VERSION, &minor);
+	gPersistentMapping = major > 4 || (major == 4 && minor >= 4);
+	std::cout << "Upload: " << PBO_COUNT << " PBO ring, " << (gPersistentMapping ? "persistent mapping" : "mapped per upload") << std::endl;
+
+	on_size();
+	startTracer();
+
+	return true;
+}
+
+uint32_t crc32(const unsigned char* data, size_t size, uint32_t crc)
+{
+	static uint32_t table[256] = {};
+	if (table[1] == 0)
+	{
+		for (uint32_t i = 0; i < 256; ++i)
+		{
+			uint32_t c = i;
+			for (int k = 0; k < 8; ++k)
+			{
+				c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+			}
+			table[i] = c;
+		}
+	}
+
+	crc = ~crc;
+	for (size_t i = 0; i < size; ++i)
+	{
+		crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	}
+	return ~crc;
+}
+
+void pushBigEndian(std::vector<unsigned char>& out, uint32_t value)
+{
+	out.push_back((value >> 24) & 0xFF);
+	out.push_back((value >> 16) & 0xFF);
+	out.push_back((value >> 8) & 0xFF);
+	out.push_back(value & 0xFF);
+}
+
+void pushChunk(std::vector<unsigned char>& out, const char* type, const std::vector<unsigned char>& data)
+{
+	pushBigEndian(out, (uint32_t)data.size());
+	size_t start = out.size();
+	out.insert(out.end(), type, type + 4);
+	out.insert(out.end(), data.begin(), data.end());
+	pushBigEndian(out, crc32(out.data() + start, out.size() - start, 0));
+}
+
+// RGBA8 rows bottom to top as in gPixels, stored with uncompressed deflate blocks so no zlib is needed
+bool writePNG(const std::string& path, int width, int height, const unsigned char* rgba)
+{
+	std::vector<unsigned char> raw;
+	raw.reserve((width*4 + 1)*height);
+	for (int j = height - 1; j >= 0; --j)
+	{
+		raw.push_back(0);
+		raw.insert(raw.end(), rgba + j*width*4, rgba + (j + 1)*width*4);
+	}
+
+	std::vector<unsigned char> zlib = { 0x78, 0x01 };
+	for (size_t offset = 0; offset < raw.size(); offset += 65535)
+	{
+		size_t length = std::min<size_t>(65535, raw.size() - offset);
+		zlib.push_back(offset + length >= raw.size() ? 1 : 0);
+		zlib.push_back(length & 0xFF);
+		zlib.push_back((length >> 8) & 0xFF);
+		zlib.push_back(~length & 0xFF);
+		zlib.push_back((~length >> 8) & 0xFF);
+		zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + length);
+	}
+	uint32_t a = 1;
+	uint32_t b = 0;
+	for (unsigned char c : raw)
+	{
+		a = (a + c) % 65521;
+		b = (b + a) % 65521;
+	}
+	pushBigEndian(zlib, (b << 16) | a);
+
+	std::vector<unsigned char> header;
+	pushBigEndian(header, width);
+	pushBigEndian(header, height);
+	header.insert(header.end(), { 8, 6, 0, 0, 0 }); // 8 bits, RGBA
+
+	std::vector<unsigned char> png = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	pushChunk(png, "IHDR", header);
+	pushChunk(png, "IDAT", zlib);
+	pushChunk(png, "IEND", {});
+
+	std::ofstream file(path, std::ios::binary);
+	file.write((const char*)png.data(), png.size());
+	return file.good();
+}
+
+// Linear radiance, PFM rows are bottom to top like gStoragePixels, samples may be null for pixels that are already means
+bool writePFM(const std::string& path, int width, int height, const vec3* pixels, const int* samples)
+{
+	std::ofstream file(path, std::ios::binary);
+	file << "PF\n" << width << " " << height << "\n-1.0\n";
+	for (int i = 0; i < width*height; ++i)
+	{
+		float n = samples != nullptr ? (float)std::max(samples[i], 1) : 1.0f;
+		float rgb[3] = { pixels[i].x / n, pixels[i].y / n, pixels[i].z / n };
+		file.write((const char*)rgb, sizeof(rgb));
+	}
+	return file.good();
+}
+
+const char* tonemapName(int tonemap)
+{
+	return tonemap == TONEMAP_REINHARD ? "reinhard" : (tonemap == TONEMAP_ACES ? "aces" : "none");
+}
+
+bool parsePixelOrder(const std::string& name, int& order)
+{
+	if (name == "rows") order = PIXEL_ORDER_ROWS;
+	else if (name == "morton") order = PIXEL_ORDER_MORTON;
+	else if (name == "hilbert") order = PIXEL_ORDER_HILBERT;
+	else return false;
+	return true;
+}
+
+bool parseTonemap(const std::string& name, int& tonemap)
+{
+	if (name == "none") tonemap = TONEMAP_NONE;
+	else if (name == "reinhard") tonemap = TONEMAP_REINHARD;
+	else if (name == "aces") tonemap = TONEMAP_ACES;
+	else return false;
+	return true;
+}
+
+struct renderSettings
+{
+	bool headless{};
+	int width = 800;
+	int height = 600;
+	int spp = 64;
+	int depth = RAY_DEPTH;
+	float noise = NOISE_THRESHOLD;
+	bool denoise{};
+	uint32_t seed = gSeed;
+	float rotX{};
+	float rotY{};
+	float distance = 7.0f;
+	float fov = 45.0f; // degrees
+	vec3 target{};
+	float time{}; // seconds, where animated objects are for a headless render
+	bool quantize{}; // every mesh as if its statement said quantized
+	float exposure{}; // stops
+	int tonemap = TONEMAP_NONE;
+	bool srgb{};
+	bool dither{};
+	int pixelOrder = PIXEL_ORDER_HILBERT;
+	bool sortRays{};
+	std::string scene = "scenes/default.scene";
+	std::string output = "example_23.png";
+};
+
+vec3 orbitEye(float rotX, float rotY)
+{
+	vec4 eyePos = mat4::rotate(0.0f, 1.0f, 0.0f, -rotX) * mat4::rotate(1.0f, 0.0f, 0.0f, -rotY) * vec4(0.0f, 0.0f, gCameraDistance, 0.0f);
+	return gCameraTarget + vec3(eyePos.x, eyePos.y, eyePos.z);
+}
+
+// Offline render straight into the CPU buffers, no window or GL context is created
+int renderHeadless(const renderSettings& settings)
+{
+	gMaxSamples = settings.spp;
+	resizeBuffers(settings.width, settings.height);
+	camera cam = makeCamera(orbitEye(settings.rotX, settings.rotY));
+
+	if (gAnimations.empty() == false)
+	{
+		auto start = high_resolution_clock::now();
+		gSceneTime = settings.time;
+		animateScene(gSceneTime);
+		auto stop = high_resolution_clock::now();
+		std::cout << "Animation: " << gAnimations.size() << " objects at " << gSceneTime << " s, " << (gRebuilds > 0 ? "rebuilt" : "refitted") << " in "
+				  << duration_cast<microseconds>(stop - start).count() / 1000.0f << " ms, SAH cost " << bvhCost(gWorld) << " (built " << gWorld.buildCost << ")" << std::endl;
+	}
+
+	gRayCount = 0;
+	auto start = high_resolution_clock::now();
+	if (settings.denoise)
+	{
+		// Feature buffers for the denoiser
+		reprojectPass(cam);
+	}
+	while (renderPass(cam) > 0)
+	{
+		++gSamples;
+	}
+	auto stop = high_resolution_clock::now();
+	float renderTime = duration_cast<microseconds>(stop - start).count() / 1000000.0f;
+
+	float denoiseTime = 0.0f;
+	if (settings.denoise)
+	{
+		start = high_resolution_clock::now();
+		denoisePass();
+		stop = high_resolution_clock::now();
+		denoiseTime = duration_cast<microseconds>(stop - start).count() / 1000.0f;
+	}
+
+	start = high_resolution_clock::now();
+	resolvePass(settings.denoise);
+	stop = high_resolution_clock::now();
+	float resolveTime = duration_cast<microseconds>(stop - start).count() / 1000.0f;
+
+	start = high_resolution_clock::now();
+	bool pfm = settings.output.size() > 4 && settings.output.compare(settings.output.size() - 4, 4, ".pfm") == 0;
+	bool written;
+	if (settings.denoise)
+	{
+		written = pfm ? writePFM(settings.output, gRenderWidth, gRenderHeight, gDenoiseColors[DENOISE_ITERATIONS & 1], nullptr)
+					  : writePNG(settings.output, gRenderWidth, gRenderHeight, gDenoisedPixels);
+	}
+	else
+	{
+		written = pfm ? writePFM(settings.output, gRenderWidth, gRenderHeight, gStoragePixels, gPixelSamples)
+					  : writePNG(settings.output, gRenderWidth, gRenderHeight, gPixels);
+	}
+	stop = high_resolution_clock::now();
+	float writeTime = duration_cast<microseconds>(stop - start).count() / 1000.0f;
+
+	double samples = 0.0;
+	int converged = 0;
+	for (int i = 0; i < gRenderWidth*gRenderHeight; ++i)
+	{
+		samples += gPixelSamples[i];
+	}
+	for (const auto& t : gTiles)
+	{
+		if (t.samples < gMaxSamples) ++converged;
+	}
+
+	std::cout << "Render: " << gRenderWidth << "x" << gRenderHeight << ", " << samples / (gRenderWidth*gRenderHeight) << " spp (max " << gMaxSamples << ") in "
+			  << gSamples << " passes, depth " << gRayDepth << ", seed " << gSeed << std::endl;
+	std::cout << "Adaptive: noise threshold " << gNoiseThreshold << ", " << converged << "/" << gTiles.size() << " tiles converged early" << std::endl;
+	std::cout << "Render time: " << renderTime*1000.0f << " ms" << std::endl;
+	std::cout << "Rays/s: " << gRayCount / renderTime / 1000000.0 << " M (" << gRayCount << " rays)" << std::endl;
+	std::cout << "Samples/s: " << samples / renderTime / 1000000.0 << " M" << std::endl;
+	if (settings.denoise)
+	{
+		std::cout << "Denoise: " << DENOISE_ITERATIONS << " a-trous iterations in " << denoiseTime << " ms" << std::endl;
+	}
+	std::cout << "Resolve: " << tonemapName(gTonemap) << ", exposure x" << gExposure << (gSrgb ? ", sRGB" : ", gamma 2") << (gDither ? ", dithered" : "") << " in " << resolveTime << " ms" << std::endl;
+	std::cout << "Write: " << settings.output << " in " << writeTime << " ms" << std::endl;
+
+	if (written == false)
+	{
+		std::cout << "ERROR: could not write " << settings.output << std::endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
+
+bool parseArguments(int argc, char** argv, renderSettings& settings)
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--headless") settings.headless = true;
+		else if (arg == "--width" && hasValue) settings.width = std::max(1, atoi(argv[++i]));
+		else if (arg == "--height" && hasValue) settings.height = std::max(1, atoi(argv[++i]));
+		else if (arg == "--spp" && hasValue) settings.spp = std::max(1, atoi(argv[++i]));
+		else if (arg == "--depth" && hasValue) settings.depth = std::max(1, atoi(argv[++i]));
+		else if (arg == "--noise" && hasValue) settings.noise = std::max(0.0f, (float)atof(argv[++i]));
+		else if (arg == "--denoise") settings.denoise = true;
+		else if (arg == "--quantize") settings.quantize = true;
+		else if (arg == "--exposure" && hasValue) settings.exposure = (float)atof(argv[++i]);
+		else if (arg == "--tonemap" && hasValue && parseTonemap(argv[i + 1], settings.tonemap)) ++i;
+		else if (arg == "--srgb") settings.srgb = true;
+		else if (arg == "--dither") settings.dither = true;
+		else if (arg == "--pixel-order" && hasValue && parsePixelOrder(argv[i + 1], settings.pixelOrder)) ++i;
+		else if (arg == "--sort-rays") settings.sortRays = true;
+		else if (arg == "--seed" && hasValue) settings.seed = (uint32_t)strtoul(argv[++i], nullptr, 0);
+		else if (arg == "--rotx" && hasValue) settings.rotX = (float)atof(argv[++i]);
+		else if (arg == "--roty" && hasValue) settings.rotY = (float)atof(argv[++i]);
+		else if (arg == "--time" && hasValue) settings.time = (float)atof(argv[++i]);
+		else if (arg == "--scene" && hasValue) settings.scene = argv[++i];
+		else if ((arg == "--output" || arg == "-o") && hasValue) settings.output = argv[++i];
+		else
+		{
+			std::cout << "Usage: " << argv[0] << " [--headless] [--width W] [--height H] [--spp N] [--depth D] [--seed S]\n"
+					  << "       [--noise T] [--denoise] [--quantize] [--rotx radians] [--roty radians] [--time seconds] [--scene file.scene] [--output file.png|file.pfm]\n"
+					  << "       [--exposure stops] [--tonemap none|reinhard|aces] [--srgb] [--dither] [--pixel-order rows|morton|hilbert] [--sort-rays]" << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+void on_size()
+{
+	gEyePos = orbitEye(gRotX, gRotY);
+	gPrevEyePos = gEyePos;
+	publishView(gEyePos);
+
+	glViewport(0, 0, gWidth, gHeight);
+}
+
+void on_key(int key, int action)
+{
+	if (key == GLFW_KEY_D && action == GLFW_PRESS)
+	{
+		gDenoise = !gDenoise;
+		std::cout << "Denoiser: " << (gDenoise ? "CPU a-trous" : "smartDeNoise shader") << std::endl;
+		requestFrame();
+	}
+	if (key == GLFW_KEY_T && action == GLFW_PRESS)
+	{
+		gTonemap = (gTonemap + 1) % 3;
+		std::cout << "Tone mapping: " << tonemapName(gTonemap) << std::endl;
+		requestFrame();
+	}
+	if (key == GLFW_KEY_P && action == GLFW_PRESS && gAnimations.empty() == false)
+	{
+		gAnimationPaused = !gAnimationPaused;
+		std::cout << "Animation: " << (gAnimationPaused ? "paused" : "running") << std::endl;
+		requestFrame();
+	}
+}
+
+void on_mouse(double xpos, double ypos)
+{
+	int state = glfwGetMouseButton(g_pWindow, GLFW_MOUSE_BUTTON_LEFT);
+	if (state == GLFW_PRESS)
+	{
+		gTargetRotX += (xpos - gPrevPosX)*0.01f;
+		gTargetRotY += (ypos - gPrevPosY)*0.01f;
+
+		if (gTargetRotY <= -M_PI / 2.0f) gTargetRotY = -M_PI / 2.0f + 0.01f;
+		if (gTargetRotY >= M_PI / 2.0f)  gTargetRotY = M_PI / 2.0f - 0.01f;
+	}
+	gPrevPosX = xpos;
+	gPrevPosY = ypos;
+}
+
+auto update() -> void
+{
+	if (fabs(gTargetRotX - gRotX) < 0.01f)
+	{
+		gRotX = gTargetRotX;
+	}
+	else
+	{
+		gRotX += 0.05f * (gTargetRotX - gRotX);
+	}
+
+	if (fabs(gTargetRotY - gRotY) < 0.01f)
+	{
+		gRotY = gTargetRotY;
+	}
+	else
+	{
+		gRotY += 0.05f * (gTargetRotY - gRotY);
+	}
+
+	gEyePos = orbitEye(gRotX, gRotY);
+	if (gEyePos != gPrevEyePos)
+	{
+		publishView(gEyePos);
+	}
+	gPrevEyePos = gEyePos;
+
+	// Show the latest finished pass, a pass still in flight never holds up input or vsync
+	if (acquireFrame())
+	{
+		uploadFrame(gFrames[gFrameFront]);
+	}
+}
+
+auto draw() -> void
+{
+	glUseProgram(gProgram);
+	glUniform1i(gDenoiseLoc, gFrames[gFrameFront].denoised ? 0 : 1);
+	glBindVertexArray(gVAO);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+}
+
+int addMaterial(int type, const vec3& color, const vec3& emit, float fuzz)
+{
+	gMaterials.push_back(material{ type, color, emit, fuzz });
+	return (int)gMaterials.size() - 1;
+}
+
+int addSphere(const vec3& center, float radius, int material)
+{
+	gSpheres.centerX.push_back(center.x);
+	gSpheres.centerY.push_back(center.y);
+	gSpheres.centerZ.push_back(center.z);
+	gSpheres.radius.push_back(radius);
+	gSpheres.material.push_back(material);
+	gSpheres.light.push_back(-1);
+	return gSpheres.size() - 1;
+}
+
+// Every leaf gets its own run of the vertices its triangles use, false when a leaf would need more than 8 bit corners can address
+bool packMesh(mesh& m, const std::vector<vec3>& vertices, const std::vector<vec3>& normals, const std::vector<int>& indices)
+{
+	packedTriangleSet& packed = m.packed;
+	packed.triangles.resize(m.tree.indices.size());
+	std::vector<int> local;
+	for (const auto& node : m.tree.nodes)
+	{
+		if (node.count <= 0) continue;
+
+		// Same scale as the decoder derives from the leaf bounds
+		vec3 scale = (node.box.max - node.box.min)*(1.0f / 65535.0f);
+		vec3 invScale(scale.x > 0.0f ? 1.0f / scale.x : 0.0f, scale.y > 0.0f ? 1.0f / scale.y : 0.0f, scale.z > 0.0f ? 1.0f / scale.z : 0.0f);
+		int firstVertex = (int)packed.vertices.size();
+
+		local.clear();
+		for (int k = node.offset; k < node.offset + node.count; ++k)
+		{
+			uint32_t corners = 0;
+			for (int c = 0; c < 3; ++c)
+			{
+				int index = indices[m.tree.indices[k]*3 + c];
+				int corner = (int)(std::find(local.begin(), local.end(), index) - local.begin());
+				if (corner == (int)local.size())
+				{
+					if (corner > UINT8_MAX) return false;
+
+					local.push_back(index);
+					vec3 q = (vertices[index] - node.box.min)*invScale;
+					packedVertex v;
+					v.position[0] = (uint16_t)lrintf(clampf(q.x, 0.0f, 65535.0f));
+					v.position[1] = (uint16_t)lrintf(clampf(q.y, 0.0f, 65535.0f));
+					v.position[2] = (uint16_t)lrintf(clampf(q.z, 0.0f, 65535.0f));
+					encodeOctahedral(normals[index], v.normal);
+					packed.vertices.push_back(v);
+				}
+				corners |= (uint32_t)corner << (c*8);
+			}
+			packed.triangles[k] = corners;
+		}
+		for (int k = node.offset; k < node.offset + node.count; ++k)
+		{
+			m.tree.indices[k] = firstVertex;
+		}
+	}
+	return true;
+}
+
+// Triangles stay in object space, instances place them in the world
+int addMesh(const std::vector<vec3>& vertices, const std::vector<vec3>& normals, const std::vector<int>& indices, bool quantize)
+{
+	gMeshes.push_back(mesh());
+	mesh& m = gMeshes.back();
+	m.box = emptyBox();
+
+	for (const auto& v : vertices)
+	{
+		m.box = growBox(m.box, v);
+	}
+
+	int triangleCount = (int)indices.size() / 3;
+	std::vector<aabb> boxes(triangleCount);
+	for (int i = 0; i < triangleCount; ++i)
+	{
+		boxes[i] = growBox(growBox(growBox(emptyBox(), vertices[indices[i*3 + 0]]), vertices[indices[i*3 + 1]]), vertices[indices[i*3 + 2]]);
+	}
+
+	// Bottom level hierarchy, the triangles are stored in leaf order so a leaf reads one contiguous run
+	bvhBuild(m.tree, boxes);
+	std::vector<int> order = m.tree.indices;
+	if (quantize && packMesh(m, vertices, normals, indices))
+	{
+		m.quantized = true;
+		return (int)gMeshes.size() - 1;
+	}
+
+	m.packed = packedTriangleSet();
+	for (int i : order)
+	{
+		int index0 = indices[i*3 + 0];
+		int index1 = indices[i*3 + 1];
+		int index2 = indices[i*3 + 2];
+		m.triangles.v0.push_back(vertices[index0]);
+		m.triangles.e1.push_back(vertices[index1] - vertices[index0]);
+		m.triangles.e2.push_back(vertices[index2] - vertices[index0]);
+		m.triangles.n0.push_back(normals[index0]);
+		m.triangles.n1.push_back(normals[index1]);
+		m.triangles.n2.push_back(normals[index2]);
+	}
+	for (int i = 0; i < triangleCount; ++i)
+	{
+		m.tree.indices[i] = i;
+	}
+
+	return (int)gMeshes.size() - 1;
+}
+
+int addInstance(int mesh, const transform& toWorld, int material)
+{
+	gInstances.push_back(instance());
+	instance& i = gInstances.back();
+	i.mesh = mesh;
+	i.material = material;
+	placeInstance(i, toWorld);
+	return (int)gInstances.size() - 1;
+}
+
+// Emissive spheres are sampled directly by the integrator
+void collectLights()
+{
+	gLights.clear();
+	for (int i = 0; i < gSpheres.size(); ++i)
+	{
+		const material& m = gMaterials[gSpheres.material[i]];
+		if (m.emit.x + m.emit.y + m.emit.z <= 0.0f)
+		{
+			gSpheres.light[i] = -1;
+			continue;
+		}
+
+		gSpheres.light[i] = (int)gLights.size();
+		gLights.push_back(light{ gSpheres.center(i), gSpheres.radius[i], m.emit });
+	}
+}
+
+// Whitespace separated tokens of one line
+struct lineCursor
+{
+	const char* p{};
+
+	// -- Explicit basic constructors --
+	explicit lineCursor(const char* text) : p(text) {}
+
+	inline void skipSpace()
+	{
+		while (*p == ' ' || *p == '\t' || *p == '\r') ++p;
+	}
+
+	inline bool end()
+	{
+		skipSpace();
+		return *p == '\0' || *p == '#';
 	}
-};
 
-bool hitLambertianMesh(const ray3& r, const lambertianMesh& mesh, float minT, float maxT, hit& hit, vec3& scatterDirection)
-{
-	bool isHit = false;
-	float closestSoFar = maxT;
+	std::string word()
+	{
+		skipSpace();
+		const char* start = p;
+		while (*p != '\0' && *p != ' ' && *p != '\t' && *p != '\r') ++p;
+		return std::string(start, p);
+	}
 
-	for(const auto& triangle : mesh.triangles)
+	bool number(float& value)
 	{
-		if (hitTriangle(r, triangle, minT, closestSoFar, hit, scatterDirection) == true)
-		{
-			isHit = true;
-			closestSoFar = hit.t;
-		}
+		skipSpace();
+		char* next;
+		value = strtof(p, &next);
+		if (next == p) return false;
+		p = next;
+		return true;
 	}
 
-	if (isHit == true)
+	bool number(int& value)
 	{
-		hit.color = mesh.color;
-		hit.emit = mesh.emit;
+		skipSpace();
+		char* next;
+		value = (int)strtol(p, &next, 10);
+		if (next == p) return false;
+		p = next;
 		return true;
 	}
 
-	return false;
-}
+	bool vector(vec3& v)
+	{
+		return number(v.x) && number(v.y) && number(v.z);
+	}
+};
 
-bool nodeHit(node* pNode, const ray3& r, float minT, float maxT, hit& hit, vec3& scatterDirection)
+// Positions and normals share one index, corners whose normal differs from the first one seen on their position get their own vertex
+bool loadObj(const std::string& path, std::vector<vec3>& vertices, std::vector<vec3>& normals, std::vector<int>& indices)
 {
-	if (hitAABB(r, pNode->box, minT, maxT) == false) return false;
-	if (pNode->pObject != nullptr)
+	std::ifstream file(path);
+	if (file.good() == false) return false;
+
+	std::vector<vec3> positions;
+	std::vector<vec3> fileNormals;
+	std::vector<int> normalOf; // per position, -1 until a corner uses it
+	std::vector<vec3> splitPositions;
+	std::vector<int> splitNormals;
+
+	std::string line;
+	std::vector<int> face;
+	while (std::getline(file, line))
 	{
-		if (pNode->pObject->id == 1)
+		lineCursor cursor(line.c_str());
+		if (cursor.end()) continue;
+
+		std::string type = cursor.word();
+		if (type == "v")
 		{
-			if (hitLambertianSphere(r, *(lambertianSphere*)(pNode->pObject), minT, maxT, hit, scatterDirection) == true)
-			{
-				return true;
-			}
+			vec3 v;
+			if (cursor.vector(v) == false) return false;
+			positions.push_back(v);
+			normalOf.push_back(-1);
 		}
-		else if (pNode->pObject->id == 2)
+		else if (type == "vn")
 		{
-			if (hitMetalSphere(r, *(metalSphere*)(pNode->pObject), minT, maxT, hit, scatterDirection) == true)
-			{
-				return true;
-			}
+			vec3 n;
+			if (cursor.vector(n) == false) return false;
+			fileNormals.push_back(n);
 		}
-		else if (pNode->pObject->id == 3)
+		else if (type == "f")
 		{
-			if (hitLambertianMesh(r, *(lambertianMesh*)(pNode->pObject), minT, maxT, hit, scatterDirection) == true)
+			face.clear();
+			while (cursor.end() == false)
 			{
-				return true;
+				// v, v/vt, v//vn or v/vt/vn, negative indices count back from the end
+				int v, vt, vn = 0;
+				if (cursor.number(v) == false) return false;
+				if (*cursor.p == '/')
+				{
+					++cursor.p;
+					if (*cursor.p != '/') cursor.number(vt);
+					if (*cursor.p == '/')
+					{
+						++cursor.p;
+						if (cursor.number(vn) == false) return false;
+					}
+				}
+				v = v < 0 ? (int)positions.size() + v : v - 1;
+				vn = vn < 0 ? (int)fileNormals.size() + vn : vn - 1;
+				if (v < 0 || v >= (int)positions.size() || vn >= (int)fileNormals.size()) return false;
+
+				if (vn < 0 || normalOf[v] < 0 || normalOf[v] == vn)
+				{
+					if (vn >= 0) normalOf[v] = vn;
+					face.push_back(v);
+				}
+				else
+				{
+					// Resolved once all positions are known
+					splitPositions.push_back(positions[v]);
+					splitNormals.push_back(vn);
+					face.push_back(-(int)splitPositions.size());
+				}
+			}
+
+			// Fan triangulation for polygons
+			for (size_t i = 2; i < face.size(); ++i)
+			{
+				indices.push_back(face[0]);
+				indices.push_back(face[i - 1]);
+				indices.push_back(face[i]);
 			}
 		}
-		return false;
 	}
 
-	bool hitLeft = nodeHit(pNode->pLeft, r, minT, maxT, hit, scatterDirection);
-	bool hitRight = nodeHit(pNode->pRight, r, minT, hitLeft == true ? hit.t : maxT, hit, scatterDirection);
-
-	return hitLeft || hitRight;
-}
-
-#define USE_NODE 1
-vec3 rayColor(const ray3& r, int depth)
-{
-	if (depth <= 0) return vec3();
-
-	hit hit;
-	vec3 scatterDirection;
-
-	bool isHit = false;
-	float closestSoFar = 1000.0f;
+	int positionCount = (int)positions.size();
+	vertices.swap(positions);
+	vertices.insert(vertices.end(), splitPositions.begin(), splitPositions.end());
+	for (int& i : indices)
+	{
+		if (i < 0) i = positionCount - i - 1;
+	}
 
-	if (hitLambertianSphere(r, gFloor, 0.001f, closestSoFar, hit, scatterDirection) == true)
+	normals.assign(vertices.size(), vec3(0.0f, 0.0f, 0.0f));
+	bool missing = false;
+	for (int i = 0; i < positionCount; ++i)
+	{
+		if (normalOf[i] >= 0) normals[i] = fileNormals[normalOf[i]];
+		else missing = true;
+	}
+	for (size_t i = 0; i < splitNormals.size(); ++i)
 	{
-		isHit = true;
-		closestSoFar = hit.t;
+		normals[positionCount + i] = fileNormals[splitNormals[i]];
 	}
 
-#if USE_NODE
-if (nodeHit(gWorld, r, 0.001f, closestSoFar, hit, scatterDirection) == true)
+	// No normals in the file, average the area weighted face normals
+	if (missing)
 	{
-		isHit = true;
-		closestSoFar = hit.t;
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			int a = indices[i + 0];
+			int b = indices[i + 1];
+			int c = indices[i + 2];
+			vec3 n = vec3::cross(vertices[b] - vertices[a], vertices[c] - vertices[a]);
+			if (a < positionCount && normalOf[a] < 0) normals[a] = normals[a] + n;
+			if (b < positionCount && normalOf[b] < 0) normals[b] = normals[b] + n;
+			if (c < positionCount && normalOf[c] < 0) normals[c] = normals[c] + n;
+		}
+		for (int i = 0; i < positionCount; ++i)
+		{
+			if (normalOf[i] < 0 && vec3::dot(normals[i], normals[i]) > 0.0f) normals[i] = normals[i].normalize();
+		}
 	}
-#else
-	for (const auto& o : gObjects)
+	return true;
+}
+
+// "lambertian r g b [emit r g b]" or "metal r g b [fuzz f]"
+bool parseMaterial(lineCursor& cursor, const std::string& type, material& m)
+{
+	if (type == "lambertian") m.type = MATERIAL_LAMBERTIAN;
+	else if (type == "metal") m.type = MATERIAL_METAL;
+	else return false;
+
+	if (cursor.vector(m.color) == false) return false;
+	while (cursor.end() == false)
 	{
-		if (o->id == 1)
+		// Anything else belongs to the statement the material is part of
+		lineCursor next = cursor;
+		std::string key = next.word();
+		if (key == "emit" && m.type == MATERIAL_LAMBERTIAN)
 		{
-			if (hitLambertianSphere(r, *(lambertianSphere*)(o), 0.001f, closestSoFar, hit, scatterDirection) == true)
-			{
-				isHit = true;
-				closestSoFar = hit.t;
-			}
+			if (next.vector(m.emit) == false) return false;
 		}
-		else if (o->id == 2)
+		else if (key == "fuzz" && m.type == MATERIAL_METAL)
 		{
-			if (hitMetalSphere(r, *(metalSphere*)(o), 0.001f, closestSoFar, hit, scatterDirection) == true)
-			{
-				isHit = true;
-				closestSoFar = hit.t;
-			}
+			if (next.number(m.fuzz) == false) return false;
 		}
-		else if (o->id == 3)
+		else
 		{
-			if (hitLambertianTriangle(r, *(lambertianTriangle*)(o), 0.001f, closestSoFar, hit, scatterDirection) == true)
-			{
-				isHit = true;
-				closestSoFar = hit.t;
-			}
+			break;
 		}
+		cursor = next;
 	}
-#endif
+	return true;
+}
 
-	if (isHit)
+// Streams the scene straight into gMaterials, gSpheres, gMeshes and gInstances, render and camera statements go to the settings
+bool loadScene(const std::string& path, renderSettings& settings)
+{
+	std::ifstream file(path);
+	if (file.good() == false)
 	{
-		vec3 target = hit.point + scatterDirection;
-		return hit.emit + rayColor(ray3(hit.point, target - hit.point), depth - 1)*hit.color;
-		// return vec3(hit.normal.x + 1.0f, hit.normal.y + 1.0f, hit.normal.z + 1.0f)*0.5f;
+		std::cout << "ERROR: could not open " << path << std::endl;
+		return false;
 	}
 
-	return vec3(0.5f, 0.7f, 1.0f);
-	// return vec3(0.0f, 0.0f, 0.0f);
-}
+	size_t slash = path.find_last_of("/\\");
+	std::string directory = slash == std::string::npos ? "" : path.substr(0, slash + 1);
 
-void render(int start, int stop, const vec3& origin, const vec3& horizontal, const vec3& vertical, const vec3& lowerLeftCorner)
-{
-	for (int j = start; j < stop; ++j)
+	std::unordered_map<std::string, int> materials;
+	std::unordered_map<std::string, int> meshes;
+	std::string line;
+	int lineNumber = 0;
+	while (std::getline(file, line))
 	{
-		for (int i = 0; i < gRenderWidth; ++i)
-		{
-			float u = (i + real_dist(re)) / (gRenderWidth - 1);
-			float v = (j + real_dist(re)) / (gRenderHeight - 1);
-			ray3 r(origin, lowerLeftCorner + horizontal*u + vertical*v - origin);
+		++lineNumber;
+		lineCursor cursor(line.c_str());
+		if (cursor.end()) continue;
 
-			int storageIndex = (i + j*gRenderWidth);
-			vec3 pixelColor(gStoragePixels[storageIndex]);
-			pixelColor = pixelColor + rayColor(r, RAY_DEPTH);
-
-			int index = (i + j*gRenderWidth)*4;
-			gPixels[index + 0] = (int)(256*clampf(sqrtf(pixelColor.x/gSamples), 0.0f, 0.999f));
-			gPixels[index + 1] = (int)(256*clampf(sqrtf(pixelColor.y/gSamples), 0.0f, 0.999f));
-			gPixels[index + 2] = (int)(256*clampf(sqrtf(pixelColor.z/gSamples), 0.0f, 0.999f));
-			gPixels[index + 3] = 255;
+		// A named material or an inline description, the latter always makes a new one
+		auto materialOf = [&](lineCursor& cursor, int& index)
+		{
+			std::string name = cursor.word();
+			auto found = materials.find(name);
+			if (found != materials.end())
+			{
+				index = found->second;
+				return true;
+			}
 
-			gStoragePixels[storageIndex] = pixelColor;
-		}
-	}
-}
+			material m{};
+			if (parseMaterial(cursor, name, m) == false) return false;
+			index = addMaterial(m.type, m.color, m.emit, m.fuzz);
+			return true;
+		};
 
-auto init() -> bool
-{
-	{
-		auto vertexShader = glCreateShader(GL_VERTEX_SHADER);
-		glShaderSource(vertexShader, 1, &renderVertexShaderSource, nullptr);
-		GL_CHECK(glCompileShader(vertexShader));
+		bool valid = true;
+		std::string type = cursor.word();
+		if (type == "render" || type == "camera")
 		{
-			GLint success;
-			GL_CHECK(glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success));
-			if (!success)
+			while (valid && cursor.end() == false)
 			{
-				GLint infoLength = 0;
-				glGetShaderiv(vertexShader, GL_INFO_LOG_LENGTH, &infoLength);
-				char* infoLog = new char[infoLength];
-				GL_CHECK(glGetShaderInfoLog(vertexShader, infoLength, &infoLength, infoLog));
-				std::cout << "ERROR::SHADER_COMPILATION_ERROR of type: " << "VERTEX_SHADER" << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
-				delete[] infoLog;
-				GL_CHECK(glDeleteShader(vertexShader));
+				std::string key = cursor.word();
+				if (key == "width") valid = cursor.number(settings.width) && settings.width > 0;
+				else if (key == "height") valid = cursor.number(settings.height) && settings.height > 0;
+				else if (key == "spp") valid = cursor.number(settings.spp) && settings.spp > 0;
+				else if (key == "depth") valid = cursor.number(settings.depth) && settings.depth > 0;
+				else if (key == "noise") valid = cursor.number(settings.noise);
+				else if (key == "exposure") valid = cursor.number(settings.exposure);
+				else if (key == "tonemap") valid = parseTonemap(cursor.word(), settings.tonemap);
+				else if (key == "srgb") settings.srgb = true;
+				else if (key == "dither") settings.dither = true;
+				else if (key == "rotx") valid = cursor.number(settings.rotX);
+				else if (key == "roty") valid = cursor.number(settings.rotY);
+				else if (key == "distance") valid = cursor.number(settings.distance);
+				else if (key == "fov") valid = cursor.number(settings.fov);
+				else if (key == "target") valid = cursor.vector(settings.target);
+				else valid = false;
 			}
 		}
-
-		auto fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-		glShaderSource(fragmentShader, 1, &renderFragmentShaderSource, nullptr);
-		GL_CHECK(glCompileShader(fragmentShader));
+		else if (type == "material")
 		{
-			GLint success;
-			GL_CHECK(glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success));
-			if(!success)
+			std::string name = cursor.word();
+			std::string kind = cursor.word();
+			material m{};
+			valid = name.empty() == false && parseMaterial(cursor, kind, m) && cursor.end();
+			if (valid) materials[name] = addMaterial(m.type, m.color, m.emit, m.fuzz);
+		}
+		else if (type == "sphere")
+		{
+			vec3 center;
+			float radius;
+			int index;
+			animation a{};
+			valid = cursor.vector(center) && cursor.number(radius) && materialOf(cursor, index);
+			while (valid && cursor.end() == false)
 			{
-				GLint infoLength = 0;
-				glGetShaderiv(fragmentShader, GL_INFO_LOG_LENGTH, &infoLength);
-				char* infoLog = new char[infoLength];
-				GL_CHECK(glGetShaderInfoLog(fragmentShader, infoLength, &infoLength, infoLog));
-				std::cout << "ERROR::SHADER_COMPILATION_ERROR of type: " << "FRAGMENT_SHADER" << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
-				delete [] infoLog;
-				GL_CHECK(glDeleteShader(fragmentShader));
+				std::string key = cursor.word();
+				if (key == "motion") valid = cursor.vector(a.amplitude) && cursor.number(a.frequency);
+				else valid = false;
+			}
+			if (valid)
+			{
+				a.sphere = addSphere(center, radius, index);
+				a.origin = center;
+				if (a.frequency != 0.0f) gAnimations.push_back(a);
 			}
 		}
+		else if (type == "mesh")
+		{
+			std::string meshPath = directory + cursor.word();
+			int index;
+			vec3 scale(1.0f, 1.0f, 1.0f);
+			vec3 axis(0.0f, 1.0f, 0.0f);
+			float angle = 0.0f;
+			vec3 position;
+			bool quantize = settings.quantize;
+			animation a{};
+			valid = materialOf(cursor, index);
+			while (valid && cursor.end() == false)
+			{
+				std::string key = cursor.word();
+				if (key == "quantized") quantize = true;
+				else if (key == "scale") valid = cursor.vector(scale);
+				else if (key == "rotate") valid = cursor.vector(axis) && cursor.number(angle);
+				else if (key == "position") valid = cursor.vector(position);
+				else if (key == "motion") valid = cursor.vector(a.amplitude) && cursor.number(a.frequency);
+				else valid = false;
+			}
 
-		gProgram = glCreateProgram();
-		glAttachShader(gProgram, vertexShader);
-		glAttachShader(gProgram, fragmentShader);
-		glLinkProgram(gProgram);
-
-		glDeleteShader(vertexShader);
-		glDeleteShader(fragmentShader);
-	}
-
-	glGenVertexArrays(1, &gVAO);
-
-	glGenTextures(1, &gTexture);
-	glBindTexture(GL_TEXTURE_2D, gTexture);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
-		// glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, gRenderWidth, gRenderHeight);
+			// Every mesh statement naming the same file places one more instance of the same triangles
+			auto found = meshes.find(quantize ? meshPath + "#quantized" : meshPath);
+			if (valid && found == meshes.end())
+			{
+				std::vector<vec3> vertices;
+				std::vector<vec3> normals;
+				std::vector<int> indices;
+				auto start = high_resolution_clock::now();
+				if (loadObj(meshPath, vertices, normals, indices) == false)
+				{
+					std::cout << "ERROR: could not load " << meshPath << std::endl;
+					valid = false;
+				}
+				auto loaded = high_resolution_clock::now();
+
+				if (valid)
+				{
+					int mesh = addMesh(vertices, normals, indices, quantize);
+					found = meshes.emplace(quantize ? meshPath + "#quantized" : meshPath, mesh).first;
+					auto stop = high_resolution_clock::now();
+					const auto& m = gMeshes[mesh];
+					std::cout << "Mesh: " << meshPath << ", " << m.size() << " triangles loaded in "
+							  << duration_cast<microseconds>(loaded - start).count() / 1000.0f << " ms, BVH " << m.tree.nodes.size() << " nodes built in "
+							  << duration_cast<microseconds>(stop - loaded).count() / 1000.0f << " ms, " << (m.quantized ? "quantized " : "") << m.bytes() / 1024 << " KB" << std::endl;
+					if (quantize && m.quantized == false)
+					{
+						std::cout << "Mesh: " << meshPath << " has a leaf with more than " << UINT8_MAX + 1 << " vertices, kept unquantized" << std::endl;
+					}
+				}
+			}
 
-	on_size();
+			if (valid)
+			{
+				a.instance = addInstance(found->second, transform::compose(scale, axis, angle*M_PI/180.0f, position), index);
+				a.origin = position;
+				if (a.frequency != 0.0f) gAnimations.push_back(a);
+			}
+		}
+		else
+		{
+			valid = false;
+		}
 
+		if (valid == false)
+		{
+			std::cout << "ERROR: " << path << ":" << lineNumber << ": " << line << std::endl;
+			return false;
+		}
+	}
 	return true;
 }
 
-void resetRenderer(int level)
-{
-	int sub = powf(2, level - 1);
+#ifdef TRACER_BENCHMARK
+#define BENCHMARK_MESH_RINGS 500 // 2 x 500 x 1000 = 1M triangles
+#define BENCHMARK_MESH_SEGMENTS 1000
 
-	gSamples = 0;
-	gRenderWidth = gWidth / sub;
-	gRenderHeight = gHeight / sub;
+struct benchmarkResult
+{
+	std::string name;
+	int primitives{};
+	int triangles{};
+	float loadMs{};
+	float bvhBuildMs{};
+	int nodes{};
+	float renderMs{};
+	uint64_t rays{};
+	uint64_t nodeTests{};
+	uint64_t primitiveTests{};
+	uint32_t checksum{};
+	size_t sceneKB{};
+};
 
-	if (gStoragePixels != nullptr)
-	{
-		delete [] gStoragePixels;
-	}
-	if (gPixels != nullptr)
+// What this scene holds: geometry, both hierarchy levels and the frame buffers resizeBuffers() allocated.
+// Counted from the containers rather than the process, so each case reports its own footprint.
+size_t sceneMemoryKB()
+{
+	size_t bytes = gSpheres.size()*(4*sizeof(float) + 2*sizeof(int)) + gInstances.size()*sizeof(instance) + gMaterials.size()*sizeof(material) + gWorld.bytes();
+	for (const auto& m : gMeshes)
 	{
-		delete [] gPixels;
+		bytes += m.bytes();
 	}
 
-	gStoragePixels = new vec3[gRenderWidth*gRenderHeight];
-	memset(gStoragePixels, 0, gRenderWidth*gRenderHeight*sizeof(vec3));
-
-	gPixels = new unsigned char[gRenderWidth*gRenderHeight*4];
-	memset(gPixels, 0, gRenderWidth*gRenderHeight*4);
-
-	glDeleteTextures(1, &gTexture);
-	glGenTextures(1, &gTexture);
-	glBindTexture(GL_TEXTURE_2D, gTexture);
-		glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, gRenderWidth, gRenderHeight);
+	size_t pixelBytes = 4*sizeof(vec3) + 4*sizeof(float) + 2*sizeof(int) + 2*sizeof(firstHit) + 2*4;
+	bytes += (size_t)gRenderWidth*gRenderHeight*pixelBytes;
+	return bytes / 1024;
 }
 
-void on_size()
+void clearScene()
 {
-	gLevel = MAX_LEVEL;
-	resetRenderer(gLevel);
-
-	glViewport(0, 0, gWidth, gHeight);
+	gMaterials.clear();
+	gSpheres = sphereSet();
+	gMeshes.clear();
+	gInstances.clear();
+	gLights.clear();
+	gAnimations.clear();
+	gWorld = bvh();
 }
 
-void on_key(int key, int action)
+void benchmarkGround()
 {
-
+	addSphere(vec3(0.0f, -100.0f, 0.0f), 100.0f, addMaterial(MATERIAL_LAMBERTIAN, vec3(0.5f, 0.5f, 0.5f), vec3(), 0.0f));
+	addSphere(vec3(0.0f, 6.0f, 0.0f), 1.5f, addMaterial(MATERIAL_LAMBERTIAN, vec3(0.6f, 0.6f, 0.6f), vec3(4.0f, 4.0f, 4.0f), 0.0f));
 }
 
-void on_mouse(double xpos, double ypos)
+// 32 x 32 small spheres with materials drawn from the fixed seed
+void benchmarkSpheres()
 {
-	int state = glfwGetMouseButton(g_pWindow, GLFW_MOUSE_BUTTON_LEFT);
-	if (state == GLFW_PRESS)
+	benchmarkGround();
+	for (int i = 0; i < 32*32; ++i)
 	{
-		gTargetRotX += (xpos - gPrevPosX)*0.01f;
-		gTargetRotY += (ypos - gPrevPosY)*0.01f;
-
-		if (gTargetRotY <= -M_PI / 2.0f) gTargetRotY = -M_PI / 2.0f + 0.01f;
-		if (gTargetRotY >= M_PI / 2.0f)  gTargetRotY = M_PI / 2.0f - 0.01f;
+		rng random(gSeed, i, 0, 0);
+		vec3 center((i % 32 - 15.5f)*0.5f + (random.nextFloat() - 0.5f)*0.2f, 0.2f, (i / 32 - 15.5f)*0.5f + (random.nextFloat() - 0.5f)*0.2f);
+		vec3 color(random.nextFloat(), random.nextFloat(), random.nextFloat());
+		bool metal = random.nextFloat() < 0.25f;
+		addSphere(center, 0.2f, addMaterial(metal ? MATERIAL_METAL : MATERIAL_LAMBERTIAN, color, vec3(), metal ? random.nextFloat()*0.3f : 0.0f));
 	}
-	gPrevPosX = xpos;
-	gPrevPosY = ypos;
 }
 
-auto update() -> void
+bool benchmarkTeapot(bool quantize)
 {
-	if (fabs(gTargetRotX - gRotX) < 0.01f)
-	{
-		gRotX = gTargetRotX;
-	}
-	else
+	std::vector<vec3> vertices;
+	std::vector<vec3> normals;
+	std::vector<int> indices;
+	if (loadObj("scenes/teapot.obj", vertices, normals, indices) == false)
 	{
-		gRotX += 0.05f * (gTargetRotX - gRotX);
+		std::cout << "ERROR: could not load scenes/teapot.obj" << std::endl;
+		return false;
 	}
 
-	if (fabs(gTargetRotY - gRotY) < 0.01f)
-	{
-		gRotY = gTargetRotY;
-	}
-	else
-	{
-		gRotY += 0.05f * (gTargetRotY - gRotY);
-	}
+	benchmarkGround();
+	int mesh = addMesh(vertices, normals, indices, quantize);
+	addInstance(mesh, transform::compose(vec3(2.0f, 2.0f, 2.0f), vec3(0.0f, 1.0f, 0.0f), 0.5f, vec3(0.0f, 1.0f, 0.0f)), addMaterial(MATERIAL_LAMBERTIAN, vec3(0.8f, 1.0f, 0.2f), vec3(), 0.0f));
+	return true;
+}
 
-	vec4 eyePos = mat4::rotate(0.0f, 1.0f, 0.0f, -gRotX) * mat4::rotate(1.0f, 0.0f, 0.0f, -gRotY) * vec4(0.0f, 0.0f, 7.0f, 0.0f);
-	gEyePos = vec3(eyePos.x, eyePos.y, eyePos.z);
-	if (gEyePos != gPrevEyePos)
+// Bumpy sphere tessellated into 1M triangles, generated instead of shipped
+void benchmarkMesh(bool quantize)
+{
+	std::vector<vec3> vertices;
+	std::vector<vec3> normals;
+	std::vector<int> indices;
+	for (int i = 0; i <= BENCHMARK_MESH_RINGS; ++i)
 	{
-		if (gLevel < MAX_LEVEL)
+		float theta = M_PI*i / BENCHMARK_MESH_RINGS;
+		for (int j = 0; j < BENCHMARK_MESH_SEGMENTS; ++j)
 		{
-			gLevel = MAX_LEVEL;
-			resetRenderer(gLevel);
+			float phi = M_2PI*j / BENCHMARK_MESH_SEGMENTS;
+			vec3 n(sinf(theta)*cosf(phi), cosf(theta), sinf(theta)*sinf(phi));
+			vertices.push_back(n*(1.0f + 0.05f*sinf(7.0f*theta)*sinf(9.0f*phi)));
+			normals.push_back(n);
 		}
-		else
+	}
+	for (int i = 0; i < BENCHMARK_MESH_RINGS; ++i)
+	{
+		for (int j = 0; j < BENCHMARK_MESH_SEGMENTS; ++j)
 		{
-			gSamples = 0;
-			memset(gStoragePixels, 0, gRenderWidth*gRenderHeight*sizeof(vec3));
-			memset(gPixels, 0, gRenderWidth*gRenderHeight*4);
+			int a = i*BENCHMARK_MESH_SEGMENTS + j;
+			int b = i*BENCHMARK_MESH_SEGMENTS + (j + 1) % BENCHMARK_MESH_SEGMENTS;
+			int c = a + BENCHMARK_MESH_SEGMENTS;
+			int d = b + BENCHMARK_MESH_SEGMENTS;
+			indices.insert(indices.end(), { a, c, b, b, c, d });
 		}
 	}
-	gPrevEyePos = gEyePos;
 
-	if (gSamples > MAX_SAMPLES_PER_PIXEL) return;
+	benchmarkGround();
+	int mesh = addMesh(vertices, normals, indices, quantize);
+	addInstance(mesh, transform::compose(vec3(1.0f, 1.0f, 1.0f), vec3(0.0f, 1.0f, 0.0f), 0.0f, vec3(0.0f, 1.0f, 0.0f)), addMaterial(MATERIAL_LAMBERTIAN, vec3(0.8f, 0.6f, 0.3f), vec3(), 0.0f));
+}
 
-	if (gLevel > 2 && gSamples > SAMPLES_PER_PIXEL_NEXT_LEVEL)
-	{
-		--gLevel;
-		resetRenderer(gLevel);
-	}
-	++gSamples;
+// Renders one canonical scene at the fixed seed and sample count, adaptive sampling is off so every run traces the same rays
+bool runBenchmarkCase(const std::string& name, const renderSettings& settings, benchmarkResult& result)
+{
+	clearScene();
+	result = benchmarkResult();
+	result.name = name;
 
+	// Scene setup minus the hierarchies, i.e. loading or tessellating, packing and the top level's boxes and leaf sort
+	gBvhBuildMs = 0.0f;
 	auto start = high_resolution_clock::now();
+	if (name == "spheres") benchmarkSpheres();
+	else if (name == "teapot" && benchmarkTeapot(settings.quantize) == false) return false;
+	else if (name == "mesh") benchmarkMesh(settings.quantize);
+	collectLights();
+	buildWorld();
+	auto stop = high_resolution_clock::now();
+	result.bvhBuildMs = gBvhBuildMs;
+	result.loadMs = duration_cast<microseconds>(stop - start).count() / 1000.0f - gBvhBuildMs;
 
-	// Camera
-	float aspect = (float)gRenderWidth / gRenderHeight;
-	float h = tanf(0.7853f/2.0f);
-	float viewportHeight = 2.0f*h;
-	float viewportWidth = aspect*viewportHeight;
-	float focalLength = 1.0f;
-	//vec3 origin = vec3(0.0f, 0.0f, -5.0f);
-	vec3 origin = gEyePos;
-	vec3 lookAt = vec3(0.0f, 0.0f, 0.0f);
-	vec3 w = (origin - lookAt).normalize();
-	vec3 u = vec3::cross(vec3(0.0f, 1.0f, 0.0f), w).normalize();
-	vec3 v = vec3::cross(w, u);
-
-	vec3 horizontal = u*viewportWidth;
-	vec3 vertical = v*viewportHeight;
-	vec3 lowerLeftCorner = origin - horizontal/2.0f - vertical/2.0f - w;
+	result.primitives = gSpheres.size() + (int)gInstances.size();
+	result.nodes = (int)gWorld.nodes.size();
+	for (const auto& m : gMeshes)
+	{
+		result.triangles += m.size();
+		result.nodes += (int)m.tree.nodes.size();
+	}
 
-	// Thread rendering
-	int step = gCores*2 > gRenderHeight ? gRenderHeight : gCores*2;
-	int tasksPerThread = (gRenderHeight + step - 1)/step;
-	for (int i = 0; i < step; ++i)
+	gCameraTarget = vec3(0.0f, 0.5f, 0.0f);
+	gCameraDistance = name == "spheres" ? 10.0f : 5.0f;
+	gCameraFov = 45.0f*M_PI/180.0f;
+	gMaxSamples = settings.spp;
+	gNoiseThreshold = 0.0f;
+	resizeBuffers(settings.width, settings.height);
+	camera cam = makeCamera(orbitEye(0.4f, 0.35f));
+
+	gRayCount = 0;
+	gNodeTests = 0;
+	gPrimitiveTests = 0;
+	start = high_resolution_clock::now();
+	while (renderPass(cam) > 0)
 	{
-		int start = i*tasksPerThread;
-		int stop = (i+1)*tasksPerThread;
-		if (stop > gRenderHeight)
-		{
-			stop = gRenderHeight;
-		}
-		gThreads[i] = std::thread(render, start, stop, origin, horizontal, vertical, lowerLeftCorner);
+		++gSamples;
 	}
+	stop = high_resolution_clock::now();
+	result.renderMs = duration_cast<microseconds>(stop - start).count() / 1000.0f;
+	result.rays = gRayCount;
+	result.nodeTests = gNodeTests;
+	result.primitiveTests = gPrimitiveTests;
+	resolvePass(false);
+	result.checksum = crc32(gPixels, gRenderWidth*gRenderHeight*4, 0);
+	result.sceneKB = sceneMemoryKB();
+	return true;
+}
 
-	for (int i = 0; i < step; ++i)
+void writeBenchmarkJson(std::ostream& out, const renderSettings& settings, const std::vector<benchmarkResult>& results)
+{
+	out << "{\n"
+		<< "  \"threads\": " << gCores << ",\n"
+		<< "  \"simd\": \"" << (gSimdLevel == SIMD_AVX2 ? "avx2" : (gSimdLevel == SIMD_SSE ? "sse" : "scalar")) << "\",\n"
+		<< "  \"width\": " << settings.width << ",\n"
+		<< "  \"height\": " << settings.height << ",\n"
+		<< "  \"spp\": " << settings.spp << ",\n"
+		<< "  \"depth\": " << gRayDepth << ",\n"
+		<< "  \"seed\": " << gSeed << ",\n"
+		<< "  \"quantized\": " << (settings.quantize ? "true" : "false") << ",\n"
+		<< "  \"pixel_order\": \"" << (settings.pixelOrder == PIXEL_ORDER_HILBERT ? "hilbert" : (settings.pixelOrder == PIXEL_ORDER_MORTON ? "morton" : "rows")) << "\",\n"
+		<< "  \"sort_rays\": " << (settings.sortRays ? "true" : "false") << ",\n"
+		<< "  \"scenes\": [\n";
+	for (size_t i = 0; i < results.size(); ++i)
 	{
-		gThreads[i].join();
+		const benchmarkResult& r = results[i];
+		double rays = (double)std::max<uint64_t>(r.rays, 1);
+		char checksum[16];
+		snprintf(checksum, sizeof(checksum), "%08x", r.checksum);
+		out << "    {\n"
+			<< "      \"name\": \"" << r.name << "\",\n"
+			<< "      \"primitives\": " << r.primitives << ",\n"
+			<< "      \"triangles\": " << r.triangles << ",\n"
+			<< "      \"bvh_nodes\": " << r.nodes << ",\n"
+			<< "      \"load_ms\": " << r.loadMs << ",\n"
+			<< "      \"bvh_build_ms\": " << r.bvhBuildMs << ",\n"
+			<< "      \"render_ms\": " << r.renderMs << ",\n"
+			<< "      \"rays\": " << r.rays << ",\n"
+			<< "      \"mrays_per_s\": " << r.rays / (r.renderMs*1000.0) << ",\n"
+			<< "      \"node_tests_per_ray\": " << r.nodeTests / rays << ",\n"
+			<< "      \"primitive_tests_per_ray\": " << r.primitiveTests / rays << ",\n"
+			<< "      \"scene_memory_kb\": " << r.sceneKB << ",\n"
+			<< "      \"image_crc32\": \"" << checksum << "\"\n"
+			<< "    }" << (i + 1 < results.size() ? "," : "") << "\n";
 	}
+	out << "  ]\n"
+		<< "}\n";
+}
 
-	auto stop = high_resolution_clock::now();
-	auto duration = duration_cast<microseconds>(stop - start);
+int runBenchmark(const renderSettings& settings)
+{
+	gSeed = settings.seed;
+	gRayDepth = settings.depth;
+	gSortRays = settings.sortRays;
+	buildTileOrder(settings.pixelOrder);
 
-	gFpsTime += duration.count() / 1000000.0f;
-	++gFpsCount;
-	if (gFpsCount > 10 || gSamples == MAX_SAMPLES_PER_PIXEL)
+	std::vector<benchmarkResult> results;
+	for (const char* name : { "spheres", "teapot", "mesh" })
 	{
-		std::cout << "FPS: " << gFpsCount / gFpsTime << " - " << gSamples << std::endl;
-		gFpsTime = 0;
-		gFpsCount = 0;
+		benchmarkResult result;
+		if (runBenchmarkCase(name, settings, result) == false) return EXIT_FAILURE;
+
+		std::cout << "Benchmark: " << name << ", " << result.rays / (result.renderMs*1000.0) << " Mrays/s, load " << result.loadMs << " ms, BVH build " << result.bvhBuildMs << " ms" << std::endl;
+		results.push_back(result);
 	}
 
-	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, gRenderWidth, gRenderHeight, GL_RGBA, GL_UNSIGNED_BYTE, gPixels);
+	writeBenchmarkJson(std::cout, settings, results);
+	std::ofstream file(settings.output);
+	writeBenchmarkJson(file, settings, results);
+	if (file.good() == false)
+	{
+		std::cout << "ERROR: could not write " << settings.output << std::endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
 }
+#endif
 
-auto draw() -> void
+auto main(int argc, char** argv) -> int
 {
-	glUseProgram(gProgram);
-	glBindVertexArray(gVAO);
-	glDrawArrays(GL_TRIANGLES, 0, 3);
-}
+	renderSettings settings;
+#ifdef TRACER_BENCHMARK
+	// Small enough for the 1M triangle scene to finish quickly, every value can still be overridden
+	settings.width = 320;
+	settings.height = 240;
+	settings.spp = 16;
+	settings.output = "example_23_benchmark.json";
+#endif
+	if (parseArguments(argc, argv, settings) == false) return EXIT_FAILURE;
 
-auto main() -> int
-{
-	gCores = std::thread::hardware_concurrency();
+	gCores = std::max(std::thread::hardware_concurrency(), 1u);
 	std::cout << gCores << " concurrent threads are supported" << std::endl;
 
-	gObjects.push_back((baseObject*)new lambertianSphere(vec3(-1.0f, 0.5f, 0.0f), 0.5f, vec3(1.0f, 0.5f, 0.5f), vec3(0.0f, 0.0f, 0.0f)));
-	gObjects.push_back((baseObject*)new lambertianSphere(vec3(0.0f, 0.5f, 0.0f), 0.5f, vec3(0.6f, 0.6f, 0.6f), vec3(1.2f, 1.2f, 1.2f)));
-	gObjects.push_back((baseObject*)new lambertianSphere(vec3(1.0f, 0.5f, 0.0f), 0.5f, vec3(0.5f, 0.5f, 1.0f), vec3(0.0f, 0.0f, 0.0f)));
-	gObjects.push_back((baseObject*)new lambertianSphere(vec3(1.0f, 1.0f, 2.0f), 1.0f, vec3(0.5f, 1.0f, 0.5f), vec3(0.0f, 0.0f, 0.0f)));
-
-	gObjects.push_back((baseObject*)new metalSphere(vec3(-2.0f, 0.5f, 0.0f), 0.5f, vec3(0.8f, 0.8f, 0.8f), 0.1f));
-	gObjects.push_back((baseObject*)new metalSphere(vec3(2.0f, 0.5f, 0.0f), 0.5f, vec3(0.8f, 0.8f, 0.8f), 0.1f));
-	gObjects.push_back((baseObject*)new metalSphere(vec3(-1.0f, 1.0f, 2.0f), 1.0f, vec3(0.8f, 0.8f, 0.8f), 0.1f));
-
-	gObjects.push_back((baseObject*)new lambertianMesh
-	(
-		teapotVertices, teapotNormals, teapotIndices,
-		vec3(1.2f, 1.2f, 1.2f), vec3(0.0f, 0.5f, -1.6f),
-		vec3(0.8f, 1.0f, 0.2f), vec3(0.0f, 0.0f, 0.0f)
-	));
+	gSimdLevel = detectSimdLevel();
+	std::cout << "BVH traversal: " << (gSimdLevel == SIMD_AVX2 ? "AVX2 8-wide" : (gSimdLevel == SIMD_SSE ? "SSE 4-wide" : "scalar binary")) << std::endl;
 
-	for (int i = -4; i < 4; ++i)
+#ifdef TRACER_BENCHMARK
+	// Canonical scenes built in code, no scene file is read
+	startWorkers();
+	int result = runBenchmark(settings);
+#else
+	auto sceneStart = high_resolution_clock::now();
+	if (loadScene(settings.scene, settings) == false) return EXIT_FAILURE;
+
+	// The command line wins over the scene file
+	parseArguments(argc, argv, settings);
+	gSeed = settings.seed;
+	gRayDepth = settings.depth;
+	gNoiseThreshold = settings.noise;
+	gExposure = powf(2.0f, settings.exposure);
+	gTonemap = settings.tonemap;
+	gSrgb = settings.srgb;
+	gDither = settings.dither;
+	gSortRays = settings.sortRays;
+	buildTileOrder(settings.pixelOrder);
+	gCameraTarget = settings.target;
+	gCameraDistance = settings.distance;
+	gCameraFov = settings.fov*M_PI/180.0f;
+	gTargetRotX = gRotX = settings.rotX;
+	gTargetRotY = gRotY = settings.rotY;
+
+	collectLights();
+
+	auto sceneStop = high_resolution_clock::now();
+	std::cout << "Scene: " << gSpheres.size() << " spheres, " << gMeshes.size() << " meshes, " << gInstances.size() << " instances, " << gMaterials.size() << " materials, "
+			  << gAnimations.size() << " animated in " << duration_cast<microseconds>(sceneStop - sceneStart).count() / 1000.0f << " ms" << std::endl;
+
+	// Instances only add their transforms, the triangles and their trees exist once per mesh
+	size_t meshBytes = 0;
+	for (const auto& m : gMeshes)
 	{
-		for (int j = -4; j < 4; j++)
-		{
-			if (i*i + j*j <= 8) continue;
-			vec3 center = vec3(i + 0.9f*real_dist(re), 0.2f + 0.3*real_dist(re), j + 0.9f*real_dist(re));
-			int metal = metal_int_dist(re);
-			if (metal == 0)
-			{
-				gObjects.push_back((baseObject*)new lambertianSphere(center, 0.2f, vec3(real_dist(re), real_dist(re), real_dist(re)), vec3(0.0f, 0.0f, 0.0f)));
-			}
-			else
-			{
-				gObjects.push_back((baseObject*)new metalSphere(center, 0.2f, vec3(real_dist(re), real_dist(re), real_dist(re)), real_dist(re)));
-			}
-		}
+		meshBytes += m.bytes();
 	}
+	std::cout << "Geometry: " << meshBytes / 1024 << " KB of meshes, " << gInstances.size()*sizeof(instance) / 1024.0f << " KB of instances" << std::endl;
 
-	gWorld = new node();
-	nodeContructor(gWorld, gObjects, 0, gObjects.size());
+	{
+		auto start = high_resolution_clock::now();
+		buildWorld();
+		auto stop = high_resolution_clock::now();
+		std::cout << "BVH: " << gWorld.nodes.size() << " nodes over " << gSpheres.size() + gInstances.size() << " primitives, built in "
+				  << duration_cast<microseconds>(stop - start).count() / 1000.0f << " ms" << std::endl;
+	}
 
-	gThreads = new std::thread[gCores*2];
+	startWorkers();
 
-	int result = run();
+	int result = settings.headless ? renderHeadless(settings) : run();
+	stopTracer();
+#endif
 
 	if (gStoragePixels != nullptr)
 	{
 		delete [] gStoragePixels;
+		delete [] gStorageSquares;
+		delete [] gPixelSamples;
+		delete [] gFirstHits;
+		delete [] gPrevStoragePixels;
+		delete [] gPrevStorageSquares;
+		delete [] gPrevPixelSamples;
+		delete [] gPrevFirstHits;
+		delete [] gDenoiseColors[0];
+		delete [] gDenoiseColors[1];
+		delete [] gDenoiseLuminances[0];
+		delete [] gDenoiseLuminances[1];
+		delete [] gDenoiseGuides;
+		delete [] gDenoiseVariances[0];
+		delete [] gDenoiseVariances[1];
+		delete [] gDenoisedPixels;
 	}
 	if (gPixels != nullptr)
 	{
 		delete [] gPixels;
 	}
-	delete [] gThreads;
-
-	for (size_t i = 0; i<gObjects.size(); ++i)
-	{
-		delete gObjects[i];
-	}
-
-	nodeDestructor(gWorld);
-	delete gWorld;
+	stopWorkers();
 
 	return result;
 }
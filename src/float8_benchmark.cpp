@@ -0,0 +1,285 @@
+// float8 and vec3x8 checks against the scalar float and vec3 code, then nanoseconds per vector of normalize.
+// Exits with failure on a mismatch. The float8_benchmark_scalar target builds the same file with FLOAT8_NO_SIMD and
+// float8_benchmark_avx with AVX enabled, so every backend the build can produce is covered.
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+
+#include "vec3.h"
+#include "float8.h"
+#include "vec3x8.h"
+
+using namespace std::chrono;
+
+const size_t VECTOR_COUNT = 16384; // 192 KB of vec3, stays in cache
+const int REPEATS = 200;
+
+std::vector<vec3> gVectors;
+std::vector<vec3> gResults;
+float gSink = 0.0f; // keeps the results alive
+bool gOk = true;
+
+void check(bool condition, const char* what)
+{
+	if (condition == false && gOk) std::cout << "mismatch: " << what << std::endl;
+	gOk = gOk && condition;
+}
+
+bool closeTo(float a, float b, float tolerance)
+{
+	return fabsf(a - b) <= tolerance*std::max(1.0f, fabsf(b));
+}
+
+bool closeTo(vec3 const& a, vec3 const& b, float tolerance)
+{
+	return closeTo(a.x, b.x, tolerance) && closeTo(a.y, b.y, tolerance) && closeTo(a.z, b.z, tolerance);
+}
+
+// Every lane wise operation must give the scalar result bit for bit, comparisons the scalar mask
+void checkFloat8(std::default_random_engine& re)
+{
+	std::uniform_real_distribution<float> unit(-10.0f, 10.0f);
+	for (int round = 0; round < 100; ++round)
+	{
+		float a[8];
+		float b[8];
+		for (int i = 0; i < 8; ++i)
+		{
+			a[i] = unit(re);
+			b[i] = i == round % 8 ? a[i] : unit(re); // one equal lane for == and the ordered compares
+		}
+		if (round == 0) a[3] = NAN; // != must stay true and the ordered compares false on NaN
+
+		float8 fa = float8::load(a);
+		float8 fb = float8::load(b);
+		float8 sum = fa + fb;
+		float8 difference = fa - fb;
+		float8 product = fa*fb;
+		float8 quotient = fa/fb;
+		float8 minimum = min(fa, fb);
+		float8 maximum = max(fa, fb);
+		float8 absolute = abs(fa);
+		float8 root = sqrt(abs(fa));
+		float8 negated = -fa;
+		mask8 less = fa < fb;
+		mask8 lessEqual = fa <= fb;
+		mask8 greater = fa > fb;
+		mask8 greaterEqual = fa >= fb;
+		mask8 equal = fa == fb;
+		mask8 notEqual = fa != fb;
+		float8 selected = select(less, fa, fb);
+
+		for (int i = 0; i < 8; ++i)
+		{
+			if (std::isnan(a[i])) continue;
+			check(sum[i] == a[i] + b[i], "float8 +");
+			check(difference[i] == a[i] - b[i], "float8 -");
+			check(product[i] == a[i]*b[i], "float8 *");
+			check(quotient[i] == a[i]/b[i], "float8 /");
+			check(minimum[i] == std::min(a[i], b[i]), "float8 min");
+			check(maximum[i] == std::max(a[i], b[i]), "float8 max");
+			check(absolute[i] == fabsf(a[i]), "float8 abs");
+			check(root[i] == sqrtf(fabsf(a[i])), "float8 sqrt");
+			check(negated[i] == -a[i], "float8 negate");
+			check(selected[i] == (a[i] < b[i] ? a[i] : b[i]), "float8 select");
+		}
+		for (int i = 0; i < 8; ++i)
+		{
+			check(less[i] == (a[i] < b[i]), "float8 <");
+			check(lessEqual[i] == (a[i] <= b[i]), "float8 <=");
+			check(greater[i] == (a[i] > b[i]), "float8 >");
+			check(greaterEqual[i] == (a[i] >= b[i]), "float8 >=");
+			check(equal[i] == (a[i] == b[i]), "float8 ==");
+			check(notEqual[i] == (a[i] != b[i]), "float8 !=");
+			check((less & greater)[i] == false, "mask8 &");
+			check((less | equal)[i] == lessEqual[i], "mask8 |");
+			check((less ^ lessEqual)[i] == equal[i], "mask8 ^");
+			check((~less)[i] == !(a[i] < b[i]), "mask8 ~");
+		}
+		check(mask8(true).all() && mask8(false).none() && (less | ~less).all() && (less & ~less).none(), "mask8 all, none");
+		check(less.any() == (less.bits() != 0), "mask8 any");
+
+		// Masked store leaves the other lanes alone
+		float stored[8];
+		std::copy(b, b + 8, stored);
+		fa.store(stored, greater);
+		for (int i = 0; i < 8; ++i)
+		{
+			if (std::isnan(a[i])) continue;
+			check(stored[i] == (a[i] > b[i] ? a[i] : b[i]), "float8 masked store");
+		}
+	}
+}
+
+// Reductions over full and partial loads, the partial ones through the mask8::first(count) overloads.
+// All positive and all negative data catch a reduction that lets the zero filled lanes in.
+void checkReductions(std::default_random_engine& re)
+{
+	std::uniform_real_distribution<float> positive(1.0f, 100.0f);
+	for (float sign : { 1.0f, -1.0f })
+	{
+		for (int count = 1; count <= 8; ++count)
+		{
+			float values[8];
+			for (int i = 0; i < 8; ++i) values[i] = sign*positive(re);
+
+			float8 f = float8::load(values, count);
+			mask8 m = mask8::first(count);
+			float sum = 0.0f;
+			float minimum = INFINITY;
+			float maximum = -INFINITY;
+			for (int i = 0; i < count; ++i)
+			{
+				sum += values[i];
+				minimum = std::min(minimum, values[i]);
+				maximum = std::max(maximum, values[i]);
+			}
+
+			check(m.bits() == (1 << count) - 1, "mask8::first");
+			for (int i = count; i < 8; ++i) check(f[i] == 0.0f, "float8 partial load zero fill");
+			check(closeTo(hsum(f, m), sum, 1e-6f), "float8 masked hsum");
+			check(hmin(f, m) == minimum, "float8 masked hmin");
+			check(hmax(f, m) == maximum, "float8 masked hmax");
+
+			float stored[8] = { -1.0f, -1.0f, -1.0f, -1.0f, -1.0f, -1.0f, -1.0f, -1.0f };
+			f.store(stored, count);
+			for (int i = 0; i < 8; ++i) check(stored[i] == (i < count ? values[i] : -1.0f), "float8 partial store");
+
+			if (count == 8)
+			{
+				check(closeTo(hsum(f), sum, 1e-6f), "float8 hsum");
+				check(hmin(f) == minimum && hmax(f) == maximum, "float8 hmin, hmax");
+			}
+		}
+	}
+	check(hmin(float8(1.0f), mask8(false)) == INFINITY && hmax(float8(1.0f), mask8(false)) == -INFINITY, "float8 empty mask");
+}
+
+// vec3x8 against vec3 lane by lane, normalize within the rsqrt precision
+void checkVec3x8()
+{
+	for (size_t first = 0; first + 16 <= gVectors.size() && first < 800; first += 8)
+	{
+		vec3x8 a = vec3x8::load(&gVectors[first]);
+		vec3x8 b = vec3x8::load(gVectors, first + 8);
+		vec3x8 sum = a + b;
+		vec3x8 difference = a - b;
+		vec3x8 product = a*b;
+		vec3x8 cross = vec3x8::cross(a, b);
+		float8 dot = vec3x8::dot(a, b);
+		float8 length = a.length();
+		vec3x8 normalized = a.normalize();
+		vec3x8 minimum = min(a, b);
+		vec3x8 maximum = max(a, b);
+
+		for (int i = 0; i < 8; ++i)
+		{
+			const vec3& u = gVectors[first + i];
+			const vec3& v = gVectors[first + 8 + i];
+			check(a[i] == u && b[i] == v, "vec3x8 load");
+			check(sum[i] == u + v && difference[i] == u - v && product[i] == u*v, "vec3x8 + - *");
+			float scale = vec3::dot(u, u) + vec3::dot(v, v); // cancellation, FMA contraction may round either way
+			check(closeTo(cross[i], vec3::cross(u, v), 1e-6f*scale), "vec3x8 cross");
+			check(closeTo(dot[i], vec3::dot(u, v), 1e-6f*scale), "vec3x8 dot");
+			check(closeTo(length[i], sqrtf(vec3::dot(u, u)), 1e-6f), "vec3x8 length");
+			check(closeTo(normalized[i], u.normalize(), 4e-6f), "vec3x8 normalize");
+			check(minimum[i] == vec3(std::min(u.x, v.x), std::min(u.y, v.y), std::min(u.z, v.z)), "vec3x8 min");
+			check(maximum[i] == vec3(std::max(u.x, v.x), std::max(u.y, v.y), std::max(u.z, v.z)), "vec3x8 max");
+		}
+
+		vec3 lowest = gVectors[first];
+		vec3 highest = gVectors[first];
+		for (int i = 1; i < 8; ++i)
+		{
+			const vec3& u = gVectors[first + i];
+			lowest = vec3(std::min(lowest.x, u.x), std::min(lowest.y, u.y), std::min(lowest.z, u.z));
+			highest = vec3(std::max(highest.x, u.x), std::max(highest.y, u.y), std::max(highest.z, u.z));
+		}
+		check(hmin(a) == lowest && hmax(a) == highest, "vec3x8 hmin, hmax");
+	}
+
+	// Partial loads and stores at the end of an array that is no multiple of eight
+	std::vector<vec3> tail(gVectors.begin(), gVectors.begin() + 13);
+	std::vector<vec3> stored(13);
+	for (size_t first = 0; first < tail.size(); first += 8)
+	{
+		vec3x8 v = vec3x8::load(tail, first);
+		int count = (int)std::min<size_t>(8, tail.size() - first);
+		vec3 lowest = tail[first];
+		for (int i = 1; i < count; ++i)
+		{
+			lowest = vec3(std::min(lowest.x, tail[first + i].x), std::min(lowest.y, tail[first + i].y), std::min(lowest.z, tail[first + i].z));
+		}
+		check(hmin(v, mask8::first(count)) == lowest, "vec3x8 masked hmin");
+		v.store(stored, first);
+	}
+	check(stored == tail, "vec3x8 partial store");
+}
+
+// Normalizing an array eight at a time against vec3::normalize() one at a time
+void measureNormalize()
+{
+	auto start = high_resolution_clock::now();
+	for (int r = 0; r < REPEATS; ++r)
+	{
+		for (size_t i = 0; i < VECTOR_COUNT; i += 8)
+		{
+			vec3x8::load(gVectors, i).normalize().store(gResults, i);
+		}
+		gSink += gResults[r % VECTOR_COUNT].x;
+	}
+	auto stop = high_resolution_clock::now();
+	double ns = duration_cast<nanoseconds>(stop - start).count() / double(VECTOR_COUNT*REPEATS);
+	std::cout << std::left << std::setw(16) << "normalize x8" << std::right << std::fixed << std::setprecision(2) << std::setw(8) << ns << " ns" << std::endl;
+
+	start = high_resolution_clock::now();
+	for (int r = 0; r < REPEATS; ++r)
+	{
+		for (size_t i = 0; i < VECTOR_COUNT; ++i)
+		{
+			gResults[i] = gVectors[i].normalize();
+		}
+		gSink += gResults[r % VECTOR_COUNT].x;
+	}
+	stop = high_resolution_clock::now();
+	ns = duration_cast<nanoseconds>(stop - start).count() / double(VECTOR_COUNT*REPEATS);
+	std::cout << std::left << std::setw(16) << "normalize" << std::right << std::fixed << std::setprecision(2) << std::setw(8) << ns << " ns" << std::endl;
+}
+
+auto main() -> int
+{
+#if defined(FLOAT8_AVX)
+	std::cout << "float8: AVX" << std::endl;
+#elif defined(FLOAT8_SSE)
+	std::cout << "float8: SSE" << std::endl;
+#elif defined(FLOAT8_NEON)
+	std::cout << "float8: NEON" << std::endl;
+#else
+	std::cout << "float8: scalar" << std::endl;
+#endif
+
+	std::default_random_engine re(1);
+	std::uniform_real_distribution<float> unit(-10.0f, 10.0f);
+	for (size_t i = 0; i < VECTOR_COUNT; ++i)
+	{
+		gVectors.push_back(vec3(unit(re), unit(re), unit(re)));
+	}
+	gResults.resize(VECTOR_COUNT);
+
+	checkFloat8(re);
+	checkReductions(re);
+	checkVec3x8();
+	std::cout << "float8 and vec3x8 match the scalar code: " << (gOk ? "yes" : "NO") << std::endl;
+	if (gOk == false) return EXIT_FAILURE;
+
+	measureNormalize();
+	std::cout << "checksum " << gSink << std::endl;
+
+	return 0;
+}
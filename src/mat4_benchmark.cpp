@@ -0,0 +1,448 @@
+// mat4 micro-benchmark, nanoseconds per call of the products, inverses, decomposition, quat composition and batched
+// point transforms. It also checks transform_points against the shader's result and the constexpr builders against
+// the runtime ones, and exits with failure on a mismatch.
+// The mat4_benchmark_scalar target builds the same file with MAT4_NO_SIMD for comparison.
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+
+#include "vec3.h"
+#include "mat4.h"
+#include "quat.h"
+
+using namespace std::chrono;
+
+const size_t MATRIX_COUNT = 4096; // 256 KB of matrices, stays in cache
+const int REPEATS = 200;
+const size_t POINT_COUNT = 16384;
+
+std::vector<mat4> gMatrices;
+std::vector<mat4> gResults;
+std::vector<vec3> gTranslations;
+std::vector<quat> gRotations;
+std::vector<vec3> gScales;
+std::vector<vec3> gPoints;
+std::vector<vec3> gPointResults;
+float gSink = 0.0f; // keeps the results alive
+
+// Random rotation, non-uniform scale and translation, like an object's world matrix
+void makeMatrices()
+{
+	std::default_random_engine re(1);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	std::uniform_real_distribution<float> scale(0.5f, 2.0f);
+
+	gMatrices.clear();
+	gTranslations.clear();
+	gRotations.clear();
+	gScales.clear();
+	for (size_t i = 0; i < MATRIX_COUNT; ++i)
+	{
+		vec3 axis = vec3(unit(re), unit(re), unit(re) + 2.0f).normalize();
+		gScales.push_back(vec3(scale(re), scale(re), scale(re)));
+		gRotations.push_back(quat::rotate(axis.x, axis.y, axis.z, unit(re)*3.14159265f));
+		gTranslations.push_back(vec3(unit(re)*10.0f, unit(re)*10.0f, unit(re)*10.0f));
+		gMatrices.push_back(compose_transform(gTranslations.back(), gRotations.back(), gScales.back()));
+	}
+	gResults.resize(MATRIX_COUNT);
+
+	gPoints.clear();
+	for (size_t i = 0; i < POINT_COUNT; ++i)
+	{
+		gPoints.push_back(vec3(unit(re)*10.0f, unit(re)*10.0f, unit(re)*10.0f));
+	}
+	gPointResults.resize(POINT_COUNT);
+}
+
+template <typename F>
+void measure(const char* name, F op)
+{
+	auto start = high_resolution_clock::now();
+	for (int r = 0; r < REPEATS; ++r)
+	{
+		for (size_t i = 0; i < MATRIX_COUNT; ++i)
+		{
+			gResults[i] = op(gMatrices[i], gMatrices[(i + 1) % MATRIX_COUNT]);
+		}
+		gSink += gResults[r % MATRIX_COUNT].m[r % 16];
+	}
+	auto stop = high_resolution_clock::now();
+
+	double ns = duration_cast<nanoseconds>(stop - start).count() / double(MATRIX_COUNT*REPEATS);
+	std::cout << std::left << std::setw(16) << name << std::right << std::fixed << std::setprecision(2) << std::setw(8) << ns << " ns" << std::endl;
+}
+
+// The batch against one compose_transform call per object and against the three matrix product
+void measureCompose()
+{
+	measure("compose", [](mat4 const&, mat4 const&)
+	{
+		static size_t i = 0;
+		i = (i + 1) % MATRIX_COUNT;
+		return compose_transform(gTranslations[i], gRotations[i], gScales[i]);
+	});
+	measure("scale*rot*trans", [](mat4 const&, mat4 const&)
+	{
+		static size_t i = 0;
+		i = (i + 1) % MATRIX_COUNT;
+		return mat4::scale(gScales[i].x, gScales[i].y, gScales[i].z) * to_mat4(gRotations[i])
+			   * mat4::translate(gTranslations[i].x, gTranslations[i].y, gTranslations[i].z);
+	});
+
+	auto start = high_resolution_clock::now();
+	for (int r = 0; r < REPEATS; ++r)
+	{
+		compose_transforms(gTranslations.data(), gRotations.data(), gScales.data(), gResults.data(), MATRIX_COUNT);
+		gSink += gResults[r % MATRIX_COUNT].m[r % 16];
+	}
+	auto stop = high_resolution_clock::now();
+
+	double ns = duration_cast<nanoseconds>(stop - start).count() / double(MATRIX_COUNT*REPEATS);
+	std::cout << std::left << std::setw(16) << "compose batch" << std::right << std::fixed << std::setprecision(2) << std::setw(8) << ns << " ns" << std::endl;
+}
+
+// With FMA the compiler may fuse multiply-adds in the scalar code here and in the builders at runtime, the SIMD
+// paths and constant evaluation never do, so bit for bit comparisons become closeness checks
+#if defined(__FMA__) || defined(__ARM_FEATURE_FMA)
+const bool FUSED_MULTIPLY_ADD = true;
+#else
+const bool FUSED_MULTIPLY_ADD = false;
+#endif
+
+// What a vertex shader computes for m * vec4(p, w) after glUniformMatrix4fv(loc, 1, false, m.m), column c is m[4c..4c+3]
+vec3 shaderTransform(const mat4& m, const vec3& p, float w)
+{
+	return vec3(m.m[0]*p.x + m.m[4]*p.y + m.m[8]*p.z + m.m[12]*w,
+				m.m[1]*p.x + m.m[5]*p.y + m.m[9]*p.z + m.m[13]*w,
+				m.m[2]*p.x + m.m[6]*p.y + m.m[10]*p.z + m.m[14]*w);
+}
+
+// Batched points against the same points one at a time with the shader's expression
+void measureTransform()
+{
+	auto start = high_resolution_clock::now();
+	for (int r = 0; r < REPEATS; ++r)
+	{
+		transform_points(gMatrices[r % MATRIX_COUNT], gPoints.data(), gPointResults.data(), POINT_COUNT);
+		gSink += gPointResults[r % POINT_COUNT].x;
+	}
+	auto stop = high_resolution_clock::now();
+	double ns = duration_cast<nanoseconds>(stop - start).count() / double(POINT_COUNT*REPEATS);
+	std::cout << std::left << std::setw(16) << "points batch" << std::right << std::fixed << std::setprecision(2) << std::setw(8) << ns << " ns" << std::endl;
+
+	start = high_resolution_clock::now();
+	for (int r = 0; r < REPEATS; ++r)
+	{
+		const mat4& m = gMatrices[r % MATRIX_COUNT];
+		for (size_t i = 0; i < POINT_COUNT; ++i)
+		{
+			gPointResults[i] = shaderTransform(m, gPoints[i], 1.0f);
+		}
+		gSink += gPointResults[r % POINT_COUNT].x;
+	}
+	stop = high_resolution_clock::now();
+	ns = duration_cast<nanoseconds>(stop - start).count() / double(POINT_COUNT*REPEATS);
+	std::cout << std::left << std::setw(16) << "points single" << std::right << std::fixed << std::setprecision(2) << std::setw(8) << ns << " ns" << std::endl;
+}
+
+// transform_points and transform_vectors must give the shader's result and the operators their scalar expressions
+// bit for bit, or within rounding with FMA
+bool checkTransforms()
+{
+	const mat4 matrices[] =
+	{
+		mat4::translate(10.0f, 20.0f, 30.0f),
+		mat4::rotate(0.6f, 0.8f, 0.0f, 1.1f),
+		mat4::lookAt(vec3(0.0f, 3.0f, 3.0f), vec3(0.0f, 0.0f, 0.0f), vec3(0.0f, 1.0f, 0.0f)),
+		mat4::rotate(0.0f, 1.0f, 0.0f, 0.4f) * mat4::translate(1.0f, 2.0f, 3.0f)
+			* mat4::lookAt(vec3(4.0f, 5.0f, 6.0f), vec3(0.0f, 1.0f, 0.0f), vec3(0.0f, 1.0f, 0.0f))
+	};
+
+	bool ok = true;
+	std::vector<vec3> points(gPoints.begin(), gPoints.begin() + 37); // odd count, no multiple of any width
+	std::vector<vec3> result(points.size());
+	for (const mat4& m : matrices)
+	{
+		for (float w : { 1.0f, 0.0f })
+		{
+			if (w == 1.0f) transform_points(m, points.data(), result.data(), points.size());
+			else transform_vectors(m, points.data(), result.data(), points.size());
+			for (size_t i = 0; i < points.size(); ++i)
+			{
+				vec3 expected = shaderTransform(m, points[i], w);
+				float tolerance = FUSED_MULTIPLY_ADD ? 1e-5f*(1.0f + fabsf(expected.x) + fabsf(expected.y) + fabsf(expected.z)) : 0.0f;
+				ok = ok && fabsf(result[i].x - expected.x) <= tolerance && fabsf(result[i].y - expected.y) <= tolerance && fabsf(result[i].z - expected.z) <= tolerance;
+			}
+		}
+	}
+
+	// The operators against their scalar expressions
+	auto same = [](float a, float b) { return FUSED_MULTIPLY_ADD ? fabsf(a - b) <= 1e-5f*(1.0f + fabsf(b)) : a == b; };
+	for (const mat4& m : matrices)
+	{
+		for (const vec3& q : points)
+		{
+			vec4 v = m * vec4(q.x, q.y, q.z, 1.0f);
+			const float* r = m.m;
+			ok = ok && same(v.x, r[0]*q.x + r[1]*q.y + r[2]*q.z + r[3]) && same(v.y, r[4]*q.x + r[5]*q.y + r[6]*q.z + r[7])
+				 && same(v.z, r[8]*q.x + r[9]*q.y + r[10]*q.z + r[11]) && same(v.w, r[12]*q.x + r[13]*q.y + r[14]*q.z + r[15]);
+		}
+		for (const mat4& n : matrices)
+		{
+			mat4 product = m * n;
+			for (int i = 0; i < 16; ++i)
+			{
+				int row = i & ~3;
+				int column = i & 3;
+				ok = ok && same(product.m[i], m.m[row]*n.m[column] + m.m[row + 1]*n.m[column + 4] + m.m[row + 2]*n.m[column + 8] + m.m[row + 3]*n.m[column + 12]);
+			}
+		}
+	}
+
+	vec3 p(1.0f, 1.0f, 1.0f);
+	transform_points(mat4::translate(10.0f, 20.0f, 30.0f), &p, &p, 1);
+	ok = ok && p.x == 11.0f && p.y == 21.0f && p.z == 31.0f;
+
+	std::cout << "transform_points and the operators match the scalar code: " << (ok ? "yes" : "NO") << std::endl;
+	return ok;
+}
+
+// Hides a value from the optimizer so the builders below take their runtime sinf/tanf/sqrtf path
+float opaque(float x)
+{
+	volatile float v = x;
+	return v;
+}
+
+vec3 opaque(vec3 const& v)
+{
+	return vec3(opaque(v.x), opaque(v.y), opaque(v.z));
+}
+
+int ulpDistance(float a, float b)
+{
+	int32_t ia;
+	int32_t ib;
+	memcpy(&ia, &a, sizeof(float));
+	memcpy(&ib, &b, sizeof(float));
+	if (ia < 0) ia = INT32_MIN - ia;
+	if (ib < 0) ib = INT32_MIN - ib;
+	return ia > ib ? ia - ib : ib - ia;
+}
+
+bool sameBits(mat4 const& a, mat4 const& b)
+{
+	return memcmp(a.m, b.m, sizeof(a.m)) == 0;
+}
+
+bool closeTo(mat4 const& a, mat4 const& b)
+{
+	bool close = true;
+	for (int i = 0; i < 16; ++i)
+	{
+		close = close && fabsf(a.m[i] - b.m[i]) <= 1e-6f*std::max(1.0f, fabsf(b.m[i]));
+	}
+	return close;
+}
+
+bool sameBuild(mat4 const& a, mat4 const& b)
+{
+	return FUSED_MULTIPLY_ADD ? closeTo(a, b) : sameBits(a, b);
+}
+
+// example_16's cubemap capture matrices, the same expressions it bakes at compile time
+constexpr float PI = 3.14159265358979f;
+const vec3 CAPTURE_TARGETS[6] = { vec3(1.0f, 0.0f, 0.0f), vec3(-1.0f, 0.0f, 0.0f), vec3(0.0f, 1.0f, 0.0f), vec3(0.0f, -1.0f, 0.0f), vec3(0.0f, 0.0f, 1.0f), vec3(0.0f, 0.0f, -1.0f) };
+const vec3 CAPTURE_UPS[6] = { vec3(0.0f, -1.0f, 0.0f), vec3(0.0f, -1.0f, 0.0f), vec3(0.0f, 0.0f, 1.0f), vec3(0.0f, 0.0f, -1.0f), vec3(0.0f, -1.0f, 0.0f), vec3(0.0f, -1.0f, 0.0f) };
+constexpr mat4 gCaptureProj = mat4::perspective(90.0f * (PI/180.0f), 1.0f, 0.1f, 10.0f);
+constexpr mat4 gCaptureViews[] =
+{
+	mat4::lookAt(vec3(0.0f, 0.0f, 0.0f), vec3(1.0f, 0.0f, 0.0f), vec3(0.0f, -1.0f,  0.0f)),
+	mat4::lookAt(vec3(0.0f, 0.0f, 0.0f), vec3(-1.0f,  0.0f,  0.0f), vec3(0.0f, -1.0f,  0.0f)),
+	mat4::lookAt(vec3(0.0f, 0.0f, 0.0f), vec3(0.0f,  1.0f,  0.0f), vec3(0.0f,  0.0f,  1.0f)),
+	mat4::lookAt(vec3(0.0f, 0.0f, 0.0f), vec3(0.0f, -1.0f,  0.0f), vec3(0.0f,  0.0f, -1.0f)),
+	mat4::lookAt(vec3(0.0f, 0.0f, 0.0f), vec3(0.0f,  0.0f,  1.0f), vec3(0.0f, -1.0f,  0.0f)),
+	mat4::lookAt(vec3(0.0f, 0.0f, 0.0f), vec3(0.0f,  0.0f, -1.0f), vec3(0.0f, -1.0f,  0.0f))
+};
+
+// Builders over a sweep of angles, evaluated by the compiler
+const int SWEEP_COUNT = 64;
+
+struct builderSweep
+{
+	float angles[SWEEP_COUNT];
+	float fovs[SWEEP_COUNT];
+	mat4 rotations[SWEEP_COUNT];
+	mat4 projections[SWEEP_COUNT];
+	mat4 views[SWEEP_COUNT];
+};
+
+constexpr builderSweep makeSweep()
+{
+	builderSweep sweep{};
+	for (int i = 0; i < SWEEP_COUNT; ++i)
+	{
+		float t = i / float(SWEEP_COUNT - 1);
+		sweep.angles[i] = -4.0f*PI + 8.0f*PI*t;
+		sweep.fovs[i] = 0.05f + 3.0f*t;
+		sweep.rotations[i] = mat4::rotate(0.6f, 0.8f, 0.0f, sweep.angles[i]);
+		sweep.projections[i] = mat4::perspective(sweep.fovs[i], 16.0f/9.0f, 0.1f, 100.0f);
+		sweep.views[i] = mat4::lookAt(vec3(3.0f*t - 1.0f, 2.0f, 5.0f - 7.0f*t), vec3(0.0f, 0.5f, 0.0f), vec3(0.0f, 1.0f, 0.0f));
+	}
+	return sweep;
+}
+
+constexpr builderSweep gSweep = makeSweep();
+
+// constexpr_math.h against sqrtf, sinf, cosf and tanf, and the builders in constant expressions against the runtime ones.
+// sqrt and whatever only takes square roots (lookAt) must match bit for bit. The trig functions may differ from libm by
+// one ulp, where they do the builder results only have to be close, everywhere else they must be identical too.
+// FMA targets only get the closeness check for the builders.
+bool checkConstexpr()
+{
+	bool ok = true;
+
+	// example_16's capture matrices
+	ok = ok && sameBuild(gCaptureProj, mat4::perspective(opaque(90.0f * (PI/180.0f)), opaque(1.0f), opaque(0.1f), opaque(10.0f)));
+	for (int i = 0; i < 6; ++i)
+	{
+		ok = ok && sameBuild(gCaptureViews[i], mat4::lookAt(opaque(vec3(0.0f, 0.0f, 0.0f)), opaque(CAPTURE_TARGETS[i]), opaque(CAPTURE_UPS[i])));
+	}
+	std::cout << "example_16 capture matrices match: " << (ok ? "yes" : "NO") << std::endl;
+
+	// Square roots over the whole float range, random bit patterns and the small integers
+	std::default_random_engine re(2);
+	std::uniform_int_distribution<uint32_t> bits(0, 0x7f7fffff);
+	bool sqrtOk = true;
+	for (int i = 0; i < 200000; ++i)
+	{
+		uint32_t b = bits(re);
+		float x;
+		memcpy(&x, &b, sizeof(float));
+		if (i < 1000) x = float(i);
+		sqrtOk = sqrtOk && constexprSqrt(x) == sqrtf(opaque(x));
+	}
+	std::cout << "constexprSqrt matches sqrtf: " << (sqrtOk ? "yes" : "NO") << std::endl;
+	ok = ok && sqrtOk;
+
+	// Trig over a few turns either way
+	const int ANGLE_COUNT = 200000;
+	int sinDiffer = 0;
+	int cosDiffer = 0;
+	int tanDiffer = 0;
+	int worst = 0;
+	for (int i = 0; i < ANGLE_COUNT; ++i)
+	{
+		float x = -4.0f*PI + 8.0f*PI*(i / float(ANGLE_COUNT - 1));
+		int sinUlps = ulpDistance(constexprSin(x), sinf(opaque(x)));
+		int cosUlps = ulpDistance(constexprCos(x), cosf(opaque(x)));
+		int tanUlps = ulpDistance(constexprTan(x), tanf(opaque(x)));
+		sinDiffer += sinUlps != 0;
+		cosDiffer += cosUlps != 0;
+		tanDiffer += tanUlps != 0;
+		worst = std::max(worst, std::max(sinUlps, std::max(cosUlps, tanUlps)));
+	}
+	std::cout << "constexpr trig differs from libm: sin " << sinDiffer << ", cos " << cosDiffer << ", tan " << tanDiffer
+			  << " of " << ANGLE_COUNT << " angles, at most " << worst << " ulp" << std::endl;
+	ok = ok && worst <= 1;
+
+	// The builders over the sweep
+	int trigDiffer = 0;
+	bool sweepOk = true;
+	for (int i = 0; i < SWEEP_COUNT; ++i)
+	{
+		float angle = gSweep.angles[i];
+		float fov = gSweep.fovs[i];
+		float t = i / float(SWEEP_COUNT - 1);
+		mat4 rotation = mat4::rotate(opaque(0.6f), opaque(0.8f), opaque(0.0f), opaque(angle));
+		mat4 projection = mat4::perspective(opaque(fov), opaque(16.0f/9.0f), opaque(0.1f), opaque(100.0f));
+		mat4 view = mat4::lookAt(opaque(vec3(3.0f*t - 1.0f, 2.0f, 5.0f - 7.0f*t)), opaque(vec3(0.0f, 0.5f, 0.0f)), opaque(vec3(0.0f, 1.0f, 0.0f)));
+
+		bool sinCosSame = constexprSin(angle / 2.0f) == sinf(opaque(angle / 2.0f)) && constexprCos(angle / 2.0f) == cosf(opaque(angle / 2.0f));
+		bool tanSame = constexprTan(fov / 2.0f) == tanf(opaque(fov / 2.0f));
+		trigDiffer += !sinCosSame + !tanSame;
+		sweepOk = sweepOk && (sinCosSame ? sameBuild(gSweep.rotations[i], rotation) : closeTo(gSweep.rotations[i], rotation));
+		sweepOk = sweepOk && (tanSame ? sameBuild(gSweep.projections[i], projection) : closeTo(gSweep.projections[i], projection));
+		sweepOk = sweepOk && sameBuild(gSweep.views[i], view);
+	}
+	std::cout << "constexpr rotate, perspective and lookAt match over " << SWEEP_COUNT << " angles: " << (sweepOk ? "yes" : "NO")
+			  << ", " << trigDiffer << " through a one ulp trig difference" << std::endl;
+	ok = ok && sweepOk;
+
+	return ok;
+}
+
+// Largest distance of m * m^-1 from the identity over all matrices
+float inverseError(mat4 (*invert)(mat4 const&))
+{
+	float error = 0.0f;
+	for (const mat4& m : gMatrices)
+	{
+		mat4 p = m * invert(m);
+		for (int i = 0; i < 16; ++i)
+		{
+			error = std::max(error, fabsf(p.m[i] - mat4::identity.m[i]));
+		}
+	}
+	return error;
+}
+
+auto main() -> int
+{
+#if defined(MAT4_SIMD_AVX)
+	std::cout << "mat4: AVX" << std::endl;
+#elif defined(MAT4_SIMD_SSE)
+	std::cout << "mat4: SSE" << std::endl;
+#elif defined(MAT4_SIMD_NEON64)
+	std::cout << "mat4: NEON" << std::endl;
+#elif defined(MAT4_SIMD_NEON)
+	std::cout << "mat4: NEON, scalar inverses" << std::endl;
+#else
+	std::cout << "mat4: scalar" << std::endl;
+#endif
+
+	makeMatrices();
+	if (checkTransforms() == false) return EXIT_FAILURE;
+	if (checkConstexpr() == false) return EXIT_FAILURE;
+
+	measure("multiply", [](mat4 const& a, mat4 const& b) { return a * b; });
+	measure("mat*vec4", [](mat4 const& a, mat4 const& b)
+	{
+		vec4 v = a * vec4(b.m[12], b.m[13], b.m[14], 1.0f);
+		mat4 result = b;
+		result.m[12] = v.x;
+		result.m[13] = v.y;
+		result.m[14] = v.z;
+		result.m[15] = v.w;
+		return result;
+	});
+	measure("transpose", [](mat4 const& a, mat4 const&) { return a.transpose(); });
+	measure("inverse", [](mat4 const& a, mat4 const&) { return a.inverse(); });
+	measure("inverseAffine", [](mat4 const& a, mat4 const&) { return a.inverseAffine(); });
+	measure("inverseRigid", [](mat4 const& a, mat4 const&) { return a.inverseRigid(); });
+	measure("normalMatrix", [](mat4 const& a, mat4 const&) { return a.normalMatrix(); });
+	measure("decompose", [](mat4 const& a, mat4 const&)
+	{
+		vec3 translation;
+		vec3 scale;
+		mat4 rotation = mat4::identity;
+		a.decompose(translation, rotation, scale);
+		rotation.m[15] = scale.x + translation.x;
+		return rotation;
+	});
+	measureCompose();
+	measureTransform();
+
+	std::cout << "inverse error " << std::scientific << std::setprecision(2) << inverseError([](mat4 const& m) { return m.inverse(); })
+			  << ", inverseAffine error " << inverseError([](mat4 const& m) { return m.inverseAffine(); }) << std::endl;
+	std::cout << "checksum " << gSink << std::endl;
+
+	return 0;
+}